@@ -219,6 +219,100 @@ class AppState {
         this.isDefault = true;
     }
 
+    // Fetches the data of every series in one request. The response body holds
+    // the series back to back; X-Series-Lengths gives each one's float64 count.
+    // With onPreview, the response is streamed instead and onPreview receives
+    // coarse versions of a series, by index, before its full data arrives.
+    async fetchSeriesData(seriesConfig: any[], storage: string, onPreview?: (index: number, data: Float64Array) => void) {
+        const params = new URLSearchParams({ storage });
+        seriesConfig.forEach((series: any) => params.append("series", series.id));
+        if (onPreview) {
+            params.set("progressive", "1");
+        }
+        const res = await fetch(`/api/series_data_batch?${params}`);
+        if (!res.ok) {
+            throw new Error(await res.text());
+        }
+        if (onPreview) {
+            return this.readSeriesFrames(res, seriesConfig, onPreview);
+        }
+
+        const buffer = await res.arrayBuffer();
+        const lengths = (res.headers.get("X-Series-Lengths") ?? "").split(",").map(Number);
+        let offset = 0;
+        return seriesConfig.map((series: any, i: number) => {
+            const length = lengths[i] || 0;
+            const data = new Float64Array(buffer, offset * 8, length);
+            offset += length;
+            return { ...series, data };
+        });
+    }
+
+    // Reads a progressive batch response: a sequence of frames, each a 16-byte
+    // little-endian header (u32 series index, u32 kind, u64 payload bytes) and
+    // its payload. Kind 0 is a preview, 1 a series' full data and 2 an error
+    // message. Payloads are copied into their own buffers as chunks arrive.
+    async readSeriesFrames(res: Response, seriesConfig: any[], onPreview: (index: number, data: Float64Array) => void) {
+        const reader = res.body!.getReader();
+        const header = new Uint8Array(16);
+        const view = new DataView(header.buffer);
+        const results: Float64Array[] = [];
+        let headerFill = 0;
+        let payload: Uint8Array | null = null;
+        let payloadFill = 0;
+
+        try {
+            for (;;) {
+                const { done, value } = await reader.read();
+                if (done) break;
+
+                let pos = 0;
+                while (pos < value.length) {
+                    if (payload === null) {
+                        const n = Math.min(16 - headerFill, value.length - pos);
+                        header.set(value.subarray(pos, pos + n), headerFill);
+                        headerFill += n;
+                        pos += n;
+                        if (headerFill < 16) break;
+                        payload = new Uint8Array(Number(view.getBigUint64(8, true)));
+                        payloadFill = 0;
+                    } else {
+                        const n = Math.min(payload.length - payloadFill, value.length - pos);
+                        payload.set(value.subarray(pos, pos + n), payloadFill);
+                        payloadFill += n;
+                        pos += n;
+                    }
+                    if (payloadFill < payload.length) continue;
+
+                    // A whole frame, possibly with an empty payload
+                    const index = view.getUint32(0, true);
+                    const kind = view.getUint32(4, true);
+                    if (kind === 2) {
+                        throw new Error(new TextDecoder().decode(payload));
+                    }
+                    const data = new Float64Array(payload.buffer, 0, payload.length / 8);
+                    if (kind === 0) {
+                        onPreview(index, data);
+                    } else {
+                        results[index] = data;
+                    }
+                    payload = null;
+                    headerFill = 0;
+                }
+            }
+        } catch (e) {
+            reader.cancel();
+            throw e;
+        }
+
+        return seriesConfig.map((series: any, i: number) => {
+            if (!results[i]) {
+                throw new Error(`No data received for series ${series.id}`);
+            }
+            return { ...series, data: results[i] };
+        });
+    }
+
     async addDataToChart(pluginName: string, initStr = "", targetCell: { row: number, col: number } = { row: 0, col: 0 }) {
         this.loading = true;
         try {
@@ -228,14 +322,7 @@ class AppState {
             const seriesConfig = await seriesResponse.json();
             const storage = this.chartLibrary === "plotly" ? "arrays" : "interleaved";
 
-            const dataPromises = seriesConfig.map(async (series: any) => {
-                const res = await fetch(`/api/series_data?series=${series.id}&storage=${storage}`);
-                const buffer = await res.arrayBuffer();
-                const data = new Float64Array(buffer);
-                return { ...series, data };
-            });
-
-            const newSeriesData: SeriesConfig[] = await Promise.all(dataPromises);
+            const newSeriesData: SeriesConfig[] = await this.fetchSeriesData(seriesConfig, storage);
 
             const colors = ["#636EFA", "#EF553B", "#00CC96", "#AB63FA", "#FFA15A", "#19D3F3", "#FF6692", "#B6E880", "#FF97FF", "#FECB52"];
             newSeriesData.forEach((s, i) => {
@@ -330,7 +417,6 @@ class AppState {
         }
     }
 
-
     async handlePluginSelection(pluginName: string) {
         this.pluginSelectionVisible = false;
         if (this.pendingAddMode) {
@@ -354,32 +440,33 @@ class AppState {
             const seriesConfig = await seriesResponse.json();
             const storage = this.chartLibrary === "plotly" ? "arrays" : "interleaved";
 
-            const dataPromises = seriesConfig.map(async (series: any) => {
-                const res = await fetch(`/api/series_data?series=${series.id}&storage=${storage}`);
-                const buffer = await res.arrayBuffer();
-                const data = new Float64Array(buffer);
-                return { ...series, data };
-            });
-
-            const seriesData: SeriesConfig[] = await Promise.all(dataPromises);
             const defaultColors = ["#636EFA", "#EF553B", "#00CC96", "#AB63FA", "#FFA15A", "#19D3F3", "#FF6692", "#B6E880", "#FF97FF", "#FECB52"];
-
-            seriesData.forEach((s: any, i) => {
+            const decorate = (s: any, i: number) => {
                 if (!s.subplot) {
                     s.subplot = { row: 0, col: 0 };
                 }
                 if (!s.color) {
                     s.color = defaultColors[i % defaultColors.length];
                 }
+                return s;
+            };
+
+            this.axes = [];
+            this.currentTitle = "";
+
+            // Draw coarse previews while the full series are still loading
+            const previews: SeriesConfig[] = [];
+            const seriesData: SeriesConfig[] = await this.fetchSeriesData(seriesConfig, storage, (i, data) => {
+                previews[i] = decorate({ ...seriesConfig[i], data }, i);
+                this.currentSeriesData = previews.filter(Boolean);
+                this.updateChart();
             });
+            seriesData.forEach(decorate);
 
             this.currentSeriesData = seriesData;
             this.dataSource = source;
-            this.axes = [];
             this.isDefault = false; // Reset to false whenever any data is loaded
 
-            this.currentTitle = "";
-
             await this.fetchPluginConfig();
             this.updateChart();
         } catch (e: any) {
@@ -2,9 +2,14 @@
 package data
 
 import (
+	"encoding/binary"
 	"encoding/json"
 	"fmt"
 	"net/http"
+	"slices"
+	"strconv"
+	"strings"
+	"sync"
 	"unsafe"
 
 	"olicanaplot/internal/logging"
@@ -28,6 +33,18 @@ func Middleware(manager *plugins.Manager, logger logging.Logger) func(http.Handl
 				handleSeriesData(w, r, manager, logger)
 				return
 
+			case "/api/series_data_batch":
+				handleSeriesDataBatch(w, r, manager, logger)
+				return
+
+			case "/api/series_live":
+				handleSeriesLive(w, r, manager, logger)
+				return
+
+			case "/api/series_summary":
+				handleSeriesSummary(w, r, manager, logger)
+				return
+
 			case "/api/plugins":
 				handlePluginList(w, r, manager)
 				return
@@ -119,7 +136,20 @@ func handleSeriesData(w http.ResponseWriter, r *http.Request, manager *plugins.M
 		return
 	}
 
-	data, actualStorage, err := plugin.GetSeriesData(seriesID, storage)
+	var data []float64
+	var actualStorage string
+	var err error
+	hints, hasHints := parseViewHints(r)
+	rangePlugin, isRange := plugin.(plugins.RangePlugin)
+	viewAware, isViewAware := plugin.(plugins.ViewAwarePlugin)
+	switch {
+	case isRange && hints.PixelWidth > 0 && hints.XMin != nil:
+		data, actualStorage, err = rangePlugin.GetSeriesRange(seriesID, storage, *hints.XMin, *hints.XMax, hints.PixelWidth)
+	case isViewAware && hasHints:
+		data, actualStorage, err = viewAware.GetSeriesDataForView(seriesID, storage, hints)
+	default:
+		data, actualStorage, err = plugin.GetSeriesData(seriesID, storage)
+	}
 	if err != nil {
 		logger.Error("Error getting series data", "series", seriesID, "error", err)
 		http.Error(w, err.Error(), http.StatusInternalServerError)
@@ -148,6 +178,269 @@ func handleSeriesData(w http.ResponseWriter, r *http.Request, manager *plugins.M
 	}
 }
 
+// handleSeriesDataBatch serves several series (repeated "series" parameters)
+// in one response. The body holds each series' float64 data back to back, and
+// the X-Series-Lengths header lists how many values belong to each, in order.
+func handleSeriesDataBatch(w http.ResponseWriter, r *http.Request, manager *plugins.Manager, logger logging.Logger) {
+	seriesIDs := r.URL.Query()["series"]
+	storage := r.URL.Query().Get("storage") // interleaved or arrays
+
+	plugin := manager.GetActive()
+	if plugin == nil {
+		http.Error(w, "No active plugin", http.StatusNotFound)
+		return
+	}
+
+	if r.URL.Query().Get("progressive") == "1" {
+		streamSeriesDataBatch(w, plugin, seriesIDs, storage, logger)
+		return
+	}
+
+	results, err := getSeriesDataBatch(plugin, seriesIDs, storage, nil)
+	if err != nil {
+		logger.Error("Error getting series data batch", "series", seriesIDs, "error", err)
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+
+	lengths := make([]string, len(results))
+	totalFloats := 0
+	for i := range results {
+		if storage != "" && results[i].Storage != storage {
+			results[i].Data = convertStorage(results[i].Data, results[i].Storage, storage)
+			results[i].Storage = storage
+		}
+		lengths[i] = strconv.Itoa(len(results[i].Data))
+		totalFloats += len(results[i].Data)
+	}
+
+	logger.Info("Serving series data batch", "series", len(results), "points", totalFloats/2)
+
+	if storage != "" {
+		w.Header().Set("X-Data-Storage", storage)
+	}
+	w.Header().Set("X-Series-Lengths", strings.Join(lengths, ","))
+	w.Header().Set("Content-Type", "application/octet-stream")
+	w.Header().Set("Content-Length", fmt.Sprintf("%d", totalFloats*8))
+
+	for _, result := range results {
+		if len(result.Data) > 0 {
+			byteData := unsafe.Slice((*byte)(unsafe.Pointer(&result.Data[0])), len(result.Data)*8)
+			w.Write(byteData)
+		}
+	}
+}
+
+// getSeriesDataBatch fetches the series in one request when the plugin
+// supports batches, and one concurrent request per series otherwise.
+// preview, if not nil, receives the coarse previews of batch plugins that
+// send them; per-series requests have none.
+func getSeriesDataBatch(plugin plugins.Plugin, seriesIDs []string, storage string, preview func(plugins.SeriesData)) ([]plugins.SeriesData, error) {
+	if batchPlugin, ok := plugin.(plugins.BatchPlugin); ok && batchPlugin.SupportsBatch() {
+		if progressive, ok := plugin.(plugins.ProgressivePlugin); ok && preview != nil {
+			return progressive.GetSeriesDataBatchProgressive(seriesIDs, storage, preview)
+		}
+		return batchPlugin.GetSeriesDataBatch(seriesIDs, storage)
+	}
+
+	// As many requests in flight as the frontend sent before batching
+	results := make([]plugins.SeriesData, len(seriesIDs))
+	errs := make([]error, len(seriesIDs))
+	var wg sync.WaitGroup
+	for i, id := range seriesIDs {
+		wg.Add(1)
+		go func(i int, id string) {
+			defer wg.Done()
+			data, actualStorage, err := plugin.GetSeriesData(id, storage)
+			if err != nil {
+				errs[i] = fmt.Errorf("series %s: %w", id, err)
+				return
+			}
+			results[i] = plugins.SeriesData{ID: id, Data: data, Storage: actualStorage}
+		}(i, id)
+	}
+	wg.Wait()
+	for _, err := range errs {
+		if err != nil {
+			return nil, err
+		}
+	}
+	return results, nil
+}
+
+// Frame kinds of a progressive batch stream
+const (
+	frameKindPreview uint32 = 0
+	frameKindFinal   uint32 = 1
+	frameKindError   uint32 = 2
+	frameKindAppend  uint32 = 3
+)
+
+// streamSeriesDataBatch answers a progressive batch request with a stream of
+// frames, each a 16-byte little-endian header (u32 series index, u32 kind,
+// u64 payload length in bytes) followed by its payload: float64 samples in
+// the requested storage, or a UTF-8 message for an error frame. Previews
+// are flushed as they arrive and may be followed by further previews of the
+// same series; each series then ends with one final frame, unless the
+// stream ends early with an error frame.
+func streamSeriesDataBatch(w http.ResponseWriter, plugin plugins.Plugin, seriesIDs []string, storage string, logger logging.Logger) {
+	if storage != "" {
+		w.Header().Set("X-Data-Storage", storage)
+	}
+	w.Header().Set("Content-Type", "application/octet-stream")
+	flusher, _ := w.(http.Flusher)
+
+	previews := 0
+	preview := func(series plugins.SeriesData) {
+		index := slices.Index(seriesIDs, series.ID)
+		if index < 0 {
+			return
+		}
+		writeSeriesFrame(w, index, frameKindPreview, convertStorage(series.Data, series.Storage, storage))
+		previews++
+		if flusher != nil {
+			flusher.Flush()
+		}
+	}
+
+	results, err := getSeriesDataBatch(plugin, seriesIDs, storage, preview)
+	if err != nil {
+		logger.Error("Error getting series data batch", "series", seriesIDs, "error", err)
+		writeFrame(w, 0, frameKindError, []byte(err.Error()))
+		return
+	}
+
+	totalFloats := 0
+	for i, result := range results {
+		data := convertStorage(result.Data, result.Storage, storage)
+		writeSeriesFrame(w, i, frameKindFinal, data)
+		totalFloats += len(data)
+	}
+
+	logger.Info("Serving progressive series data batch", "series", len(results), "previews", previews, "points", totalFloats/2)
+}
+
+// handleSeriesLive streams the points a live series grows by, for plugins
+// that can extend their series. The response is a stream of frames as for a
+// progressive batch, each an append frame (kind 3) holding the points added
+// since the last, in the requested storage. It ends when the plugin stops
+// the series or with an error frame; closing the request unsubscribes. The
+// optional "rate" parameter asks for that many points per second.
+func handleSeriesLive(w http.ResponseWriter, r *http.Request, manager *plugins.Manager, logger logging.Logger) {
+	seriesID := r.URL.Query().Get("series")
+	if seriesID == "" {
+		http.Error(w, "Missing series parameter", http.StatusBadRequest)
+		return
+	}
+	storage := r.URL.Query().Get("storage") // interleaved or arrays
+	rate, _ := strconv.ParseFloat(r.URL.Query().Get("rate"), 64)
+
+	live, ok := manager.GetActive().(plugins.LivePlugin)
+	if !ok {
+		http.Error(w, "Active plugin has no live series", http.StatusNotFound)
+		return
+	}
+	frames, err := live.SubscribeSeries(seriesID, storage, rate)
+	if err != nil {
+		logger.Error("Error subscribing to series", "series", seriesID, "error", err)
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+
+	if storage != "" {
+		w.Header().Set("X-Data-Storage", storage)
+	}
+	w.Header().Set("Content-Type", "application/octet-stream")
+	flusher, _ := w.(http.Flusher)
+
+	points := 0
+	defer func() {
+		logger.Info("Live series ended", "series", seriesID, "points", points)
+	}()
+	for {
+		select {
+		case frame, ok := <-frames:
+			if !ok {
+				return
+			}
+			data := convertStorage(frame.Data, frame.Storage, storage)
+			writeSeriesFrame(w, 0, frameKindAppend, data)
+			points += len(data) / 2
+			if flusher != nil {
+				flusher.Flush()
+			}
+		case <-r.Context().Done():
+			if err := live.UnsubscribeSeries(seriesID); err != nil {
+				logger.Error("Error unsubscribing from series", "series", seriesID, "error", err)
+			}
+			return
+		}
+	}
+}
+
+// handleSeriesSummary returns the count, x and y extents, mean and variance
+// of a series as JSON, for plugins that can summarise their series, so the
+// frontend can scale its axes before fetching the data.
+func handleSeriesSummary(w http.ResponseWriter, r *http.Request, manager *plugins.Manager, logger logging.Logger) {
+	seriesID := r.URL.Query().Get("series")
+	if seriesID == "" {
+		http.Error(w, "Missing series parameter", http.StatusBadRequest)
+		return
+	}
+
+	summarizer, ok := manager.GetActive().(plugins.SummaryPlugin)
+	if !ok {
+		http.Error(w, "Active plugin has no series summaries", http.StatusNotFound)
+		return
+	}
+	summary, err := summarizer.GetSeriesSummary(seriesID)
+	if err != nil {
+		logger.Error("Error getting series summary", "series", seriesID, "error", err)
+		http.Error(w, err.Error(), http.StatusInternalServerError)
+		return
+	}
+
+	w.Header().Set("Content-Type", "application/json")
+	json.NewEncoder(w).Encode(summary)
+}
+
+func writeSeriesFrame(w http.ResponseWriter, index int, kind uint32, data []float64) {
+	var payload []byte
+	if len(data) > 0 {
+		payload = unsafe.Slice((*byte)(unsafe.Pointer(&data[0])), len(data)*8)
+	}
+	writeFrame(w, index, kind, payload)
+}
+
+func writeFrame(w http.ResponseWriter, index int, kind uint32, payload []byte) {
+	var header [16]byte
+	binary.LittleEndian.PutUint32(header[0:], uint32(index))
+	binary.LittleEndian.PutUint32(header[4:], kind)
+	binary.LittleEndian.PutUint64(header[8:], uint64(len(payload)))
+	w.Write(header[:])
+	w.Write(payload)
+}
+
+// parseViewHints reads the optional width, x_min and x_max query parameters.
+// It reports false when no usable hint is present.
+func parseViewHints(r *http.Request) (plugins.ViewHints, bool) {
+	var hints plugins.ViewHints
+	query := r.URL.Query()
+
+	if width, err := strconv.Atoi(query.Get("width")); err == nil && width > 0 {
+		hints.PixelWidth = width
+	}
+
+	xMin, errMin := strconv.ParseFloat(query.Get("x_min"), 64)
+	xMax, errMax := strconv.ParseFloat(query.Get("x_max"), 64)
+	if errMin == nil && errMax == nil && xMax > xMin {
+		hints.XMin = &xMin
+		hints.XMax = &xMax
+	}
+
+	return hints, hints.PixelWidth > 0 || hints.XMin != nil
+}
+
 // handlePluginList returns the list of available plugins
 func handlePluginList(w http.ResponseWriter, r *http.Request, manager *plugins.Manager) {
 	response := map[string]interface{}{
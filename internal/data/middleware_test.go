@@ -0,0 +1,116 @@
+package data
+
+import (
+	"encoding/binary"
+	"errors"
+	"math"
+	"net/http/httptest"
+	"reflect"
+	"testing"
+	"time"
+
+	"olicanaplot/internal/logging"
+	"olicanaplot/internal/plugins"
+)
+
+// perSeriesPlugin is a plugin process without get_series_data_batch: it
+// implements BatchPlugin and ProgressivePlugin, as every IPC plugin does, but
+// answers a batch with "Unknown method". Each GetSeriesData call is reported
+// on calls and waits for release before returning the series' single point.
+type perSeriesPlugin struct {
+	calls   chan string
+	release chan struct{}
+}
+
+func (p *perSeriesPlugin) Name() string                           { return "per-series" }
+func (p *perSeriesPlugin) Version() uint32                        { return plugins.PluginAPIVersion }
+func (p *perSeriesPlugin) Path() string                           { return "" }
+func (p *perSeriesPlugin) GetFilePatterns() []plugins.FilePattern { return nil }
+func (p *perSeriesPlugin) Initialize(interface{}, string, logging.Logger) (string, error) {
+	return "", nil
+}
+func (p *perSeriesPlugin) GetChartConfig(string) (*plugins.ChartConfig, error) { return nil, nil }
+func (p *perSeriesPlugin) GetSeriesConfig() ([]plugins.SeriesConfig, error)    { return nil, nil }
+func (p *perSeriesPlugin) GetSeriesData(seriesID string, storage string) ([]float64, string, error) {
+	p.calls <- seriesID
+	<-p.release
+	return []float64{float64(len(seriesID)), 1}, "interleaved", nil
+}
+func (p *perSeriesPlugin) Close() error        { return nil }
+func (p *perSeriesPlugin) SupportsBatch() bool { return false }
+func (p *perSeriesPlugin) GetSeriesDataBatch([]string, string) ([]plugins.SeriesData, error) {
+	return nil, errors.New("Unknown method: get_series_data_batch")
+}
+func (p *perSeriesPlugin) GetSeriesDataBatchProgressive([]string, string, func(plugins.SeriesData)) ([]plugins.SeriesData, error) {
+	return nil, errors.New("Unknown method: get_series_data_batch")
+}
+
+func TestSeriesDataBatchFetchesEachSeriesWithoutBatchSupport(t *testing.T) {
+	seriesIDs := []string{"a", "bb", "ccc"}
+	plugin := &perSeriesPlugin{calls: make(chan string, len(seriesIDs)), release: make(chan struct{})}
+	manager := plugins.NewManager(logging.NewLogger("test"))
+	manager.Register(plugin, true)
+	manager.SetActive(plugin.Name())
+
+	rec := httptest.NewRecorder()
+	done := make(chan struct{})
+	go func() {
+		defer close(done)
+		req := httptest.NewRequest("GET", "/api/series_data_batch?storage=interleaved&series=a&series=bb&series=ccc", nil)
+		handleSeriesDataBatch(rec, req, manager, logging.NewLogger("test"))
+	}()
+
+	// Every series is requested before any of them returns
+	for range seriesIDs {
+		select {
+		case <-plugin.calls:
+		case <-time.After(time.Second):
+			close(plugin.release)
+			t.Fatal("series were not fetched concurrently")
+		}
+	}
+	close(plugin.release)
+	<-done
+
+	if rec.Code != 200 {
+		t.Fatalf("status %d: %s", rec.Code, rec.Body)
+	}
+	if got := rec.Header().Get("X-Series-Lengths"); got != "2,2,2" {
+		t.Errorf("X-Series-Lengths: got %q, want 2,2,2", got)
+	}
+	body := rec.Body.Bytes()
+	got := make([]float64, len(body)/8)
+	for i := range got {
+		got[i] = math.Float64frombits(binary.LittleEndian.Uint64(body[i*8:]))
+	}
+	if want := []float64{1, 1, 2, 1, 3, 1}; !reflect.DeepEqual(got, want) {
+		t.Errorf("got %v, want %v", got, want)
+	}
+}
+
+func TestProgressiveSeriesDataBatchWithoutBatchSupport(t *testing.T) {
+	plugin := &perSeriesPlugin{calls: make(chan string, 2), release: make(chan struct{})}
+	close(plugin.release)
+	manager := plugins.NewManager(logging.NewLogger("test"))
+	manager.Register(plugin, true)
+	manager.SetActive(plugin.Name())
+
+	rec := httptest.NewRecorder()
+	req := httptest.NewRequest("GET", "/api/series_data_batch?storage=interleaved&series=a&series=bb&progressive=1", nil)
+	handleSeriesDataBatch(rec, req, manager, logging.NewLogger("test"))
+
+	// One final frame per series, in order, and no previews
+	body := rec.Body.Bytes()
+	var kinds, indexes []uint32
+	for len(body) >= 16 {
+		indexes = append(indexes, binary.LittleEndian.Uint32(body))
+		kinds = append(kinds, binary.LittleEndian.Uint32(body[4:]))
+		body = body[16+binary.LittleEndian.Uint64(body[8:]):]
+	}
+	if want := []uint32{frameKindFinal, frameKindFinal}; !reflect.DeepEqual(kinds, want) {
+		t.Errorf("frame kinds: got %v, want %v", kinds, want)
+	}
+	if want := []uint32{0, 1}; !reflect.DeepEqual(indexes, want) {
+		t.Errorf("frame indexes: got %v, want %v", indexes, want)
+	}
+}
@@ -62,6 +62,13 @@ func SetLevel(level string) {
 	}
 }
 
+// LevelName returns the global log level as accepted by SetLevel.
+func LevelName() string {
+	writerMu.RLock()
+	defer writerMu.RUnlock()
+	return strings.ToLower(logLevel.String())
+}
+
 // Logger is the interface for structured logging.
 type Logger interface {
 	Debug(msg string, args ...any)
@@ -0,0 +1,183 @@
+package ipc
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"slices"
+	"unsafe"
+)
+
+// acceptedCompressions lists the payload compressions the host can inflate.
+// Like acceptedDTypes it is sent with every data request; plugins compress
+// only when configured to.
+var acceptedCompressions = []string{"shuffle-lz4"}
+
+var errCorruptBlock = errors.New("corrupt lz4 block")
+
+// checkCompression rejects responses compressed in a way the host did not
+// offer.
+func checkCompression(header *Response) error {
+	if header.Compression != "" && !slices.Contains(acceptedCompressions, header.Compression) {
+		return fmt.Errorf("unsupported compression: %s", header.Compression)
+	}
+	return nil
+}
+
+// inflater reads "shuffle-lz4" frames: an LZ4 block that inflates to the
+// payload with its values byte-shuffled, byte 0 of every value first, then
+// byte 1 and so on. Its buffers are reused across the chunks of a response.
+type inflater struct {
+	packed   []byte
+	shuffled []byte
+	raw      []byte
+}
+
+// read reads a compressed frame of length bytes and returns its rawLength
+// inflated bytes, still shuffled.
+func (f *inflater) read(r io.Reader, length, rawLength int) ([]byte, error) {
+	f.packed = slices.Grow(f.packed[:0], length)[:length]
+	if _, err := io.ReadFull(r, f.packed); err != nil {
+		return nil, fmt.Errorf("failed to read compressed data: %w", err)
+	}
+	f.shuffled = slices.Grow(f.shuffled[:0], rawLength)[:rawLength]
+	if err := lz4Decompress(f.shuffled, f.packed); err != nil {
+		return nil, err
+	}
+	return f.shuffled, nil
+}
+
+// readRaw reads a frame's payload as the plugin encoded it, inflating and
+// unshuffling it if it carries a raw_length. The result is only valid until
+// the next call.
+func (f *inflater) readRaw(r io.Reader, frame *Response, width int) ([]byte, error) {
+	if frame.RawLength == 0 {
+		f.raw = slices.Grow(f.raw[:0], frame.Length)[:frame.Length]
+		if _, err := io.ReadFull(r, f.raw); err != nil {
+			return nil, fmt.Errorf("failed to read binary data: %w", err)
+		}
+		return f.raw, nil
+	}
+	shuffled, err := f.read(r, frame.Length, frame.RawLength)
+	if err != nil {
+		return nil, err
+	}
+	f.raw = slices.Grow(f.raw[:0], len(shuffled))[:len(shuffled)]
+	unshuffle(f.raw, shuffled, width, 0, len(shuffled)/width)
+	return f.raw, nil
+}
+
+// inflateBinary reads and decodes a compressed "binary" payload. float64
+// values are unshuffled straight into the result.
+func inflateBinary(r io.Reader, header *Response, width int) ([]float64, error) {
+	var f inflater
+	if width == 8 {
+		shuffled, err := f.read(r, header.Length, header.RawLength)
+		if err != nil {
+			return nil, err
+		}
+		return appendUnshuffled(nil, shuffled, 0, len(shuffled)/8), nil
+	}
+	raw, err := f.readRaw(r, header, width)
+	if err != nil {
+		return nil, err
+	}
+	return decodeSamples(make([]float64, 0, len(raw)/width), raw, header), nil
+}
+
+// appendUnshuffled appends float64 values [lo, hi) of a shuffled payload to
+// dst, unshuffling them in place in its backing array.
+func appendUnshuffled(dst []float64, shuffled []byte, lo, hi int) []float64 {
+	start := len(dst)
+	dst = slices.Grow(dst, hi-lo)[:start+hi-lo]
+	if hi > lo {
+		out := unsafe.Slice((*byte)(unsafe.Pointer(&dst[start])), (hi-lo)*8)
+		unshuffle(out, shuffled, 8, lo, hi)
+	}
+	return dst
+}
+
+// unshuffle writes values [lo, hi) of a shuffled payload of width-byte
+// values to dst.
+func unshuffle(dst, shuffled []byte, width, lo, hi int) {
+	count := len(shuffled) / width
+	for b := 0; b < width; b++ {
+		plane := shuffled[b*count+lo : b*count+hi]
+		for i, v := range plane {
+			dst[i*width+b] = v
+		}
+	}
+}
+
+// lz4Decompress inflates one LZ4 block into dst, which must be exactly the
+// block's inflated size.
+func lz4Decompress(dst, src []byte) error {
+	s, d := 0, 0
+	for s < len(src) {
+		token := src[s]
+		s++
+
+		literals := int(token >> 4)
+		if literals == 15 {
+			n, next, err := lz4Length(src, s)
+			if err != nil {
+				return err
+			}
+			literals += n
+			s = next
+		}
+		if literals > len(src)-s || literals > len(dst)-d {
+			return errCorruptBlock
+		}
+		d += copy(dst[d:], src[s:s+literals])
+		s += literals
+		if s == len(src) {
+			break // The last sequence has no match
+		}
+
+		if len(src)-s < 2 {
+			return errCorruptBlock
+		}
+		offset := int(src[s]) | int(src[s+1])<<8
+		s += 2
+		length := int(token&15) + 4
+		if token&15 == 15 {
+			n, next, err := lz4Length(src, s)
+			if err != nil {
+				return err
+			}
+			length += n
+			s = next
+		}
+		if offset == 0 || offset > d || length > len(dst)-d {
+			return errCorruptBlock
+		}
+		// Overlapping matches repeat the last offset bytes, copied in
+		// doubling runs
+		start, end := d-offset, d+length
+		for d < end {
+			d += copy(dst[d:end], dst[start:d])
+		}
+	}
+	if d != len(dst) {
+		return errCorruptBlock
+	}
+	return nil
+}
+
+// lz4Length reads the 255-terminated continuation of a literal or match
+// length starting at src[s], returning it and the offset after it.
+func lz4Length(src []byte, s int) (int, int, error) {
+	n := 0
+	for {
+		if s >= len(src) {
+			return 0, 0, errCorruptBlock
+		}
+		b := src[s]
+		s++
+		n += int(b)
+		if b != 255 {
+			return n, s, nil
+		}
+	}
+}
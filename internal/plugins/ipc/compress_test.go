@@ -0,0 +1,174 @@
+package ipc
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"math"
+	"reflect"
+	"testing"
+)
+
+// float64Bytes encodes values as little-endian float64.
+func float64Bytes(values ...float64) []byte {
+	out := make([]byte, 0, len(values)*8)
+	for _, v := range values {
+		out = binary.LittleEndian.AppendUint64(out, math.Float64bits(v))
+	}
+	return out
+}
+
+// shuffle byte-shuffles a payload of width-byte values the way plugins do
+// before compressing it: byte 0 of every value, then byte 1 and so on.
+func shuffle(raw []byte, width int) []byte {
+	count := len(raw) / width
+	out := make([]byte, len(raw))
+	for i := 0; i < count; i++ {
+		for b := 0; b < width; b++ {
+			out[b*count+i] = raw[i*width+b]
+		}
+	}
+	return out
+}
+
+// literalBlock encodes data as an LZ4 block of a single literal run.
+func literalBlock(data []byte) []byte {
+	n := len(data)
+	if n < 15 {
+		return append([]byte{byte(n << 4)}, data...)
+	}
+	block := []byte{0xF0}
+	for n -= 15; n >= 255; n -= 255 {
+		block = append(block, 255)
+	}
+	return append(append(block, byte(n)), data...)
+}
+
+func TestLZ4Decompress(t *testing.T) {
+	long := bytes.Repeat([]byte("0123456789"), 3)
+	tests := []struct {
+		name  string
+		block []byte
+		size  int
+		want  []byte
+		err   error
+	}{
+		{"literals", literalBlock([]byte("hello")), 5, []byte("hello"), nil},
+		{"long literals", literalBlock(long), len(long), long, nil},
+		{"empty", nil, 0, []byte{}, nil},
+		{"match", []byte{0x34, 'a', 'b', 'c', 3, 0}, 11, []byte("abcabcabcab"), nil},
+		{"overlapping match", []byte{0x13, 'a', 1, 0}, 8, []byte("aaaaaaaa"), nil},
+		{"long match", []byte{0x1F, 'x', 1, 0, 255, 26}, 301, bytes.Repeat([]byte("x"), 301), nil},
+		{"match then literals", []byte{0x10, 'a', 1, 0, 0x20, 'b', 'c'}, 7, []byte("aaaaabc"), nil},
+		{"zero offset", []byte{0x10, 'a', 0, 0}, 5, nil, errCorruptBlock},
+		{"offset past output", []byte{0x10, 'a', 2, 0}, 5, nil, errCorruptBlock},
+		{"truncated literals", []byte{0x50, 'a', 'b'}, 5, nil, errCorruptBlock},
+		{"truncated offset", []byte{0x10, 'a', 1}, 5, nil, errCorruptBlock},
+		{"truncated length", []byte{0xF0, 255}, 300, nil, errCorruptBlock},
+		{"output too short", literalBlock([]byte("hello")), 4, nil, errCorruptBlock},
+		{"output too long", literalBlock([]byte("hello")), 6, nil, errCorruptBlock},
+		{"match past output", []byte{0x13, 'a', 1, 0}, 6, nil, errCorruptBlock},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			dst := make([]byte, tt.size)
+			err := lz4Decompress(dst, tt.block)
+			if !errors.Is(err, tt.err) {
+				t.Fatalf("got error %v, want %v", err, tt.err)
+			}
+			if err == nil && !bytes.Equal(dst, tt.want) {
+				t.Errorf("got %q, want %q", dst, tt.want)
+			}
+		})
+	}
+}
+
+func TestUnshuffle(t *testing.T) {
+	raw := []byte{
+		0x10, 0x11, 0x12, 0x13,
+		0x20, 0x21, 0x22, 0x23,
+		0x30, 0x31, 0x32, 0x33,
+	}
+	shuffled := shuffle(raw, 4)
+	tests := []struct {
+		name   string
+		lo, hi int
+	}{
+		{"all", 0, 3},
+		{"first", 0, 1},
+		{"middle", 1, 2},
+		{"tail", 1, 3},
+		{"none", 2, 2},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			dst := make([]byte, (tt.hi-tt.lo)*4)
+			unshuffle(dst, shuffled, 4, tt.lo, tt.hi)
+			if want := raw[tt.lo*4 : tt.hi*4]; !bytes.Equal(dst, want) {
+				t.Errorf("got %x, want %x", dst, want)
+			}
+		})
+	}
+}
+
+func TestAppendUnshuffled(t *testing.T) {
+	values := []float64{1.5, -2.25, 3e100, 0, -0.125, 7}
+	shuffled := shuffle(float64Bytes(values...), 8)
+	tests := []struct {
+		name   string
+		dst    []float64
+		lo, hi int
+		want   []float64
+	}{
+		{"all", nil, 0, 6, values},
+		{"x block", nil, 0, 3, values[:3]},
+		{"y block after x", []float64{1.5, -2.25, 3e100}, 3, 6, values},
+		{"empty range", []float64{9}, 4, 4, []float64{9}},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			got := appendUnshuffled(tt.dst, shuffled, tt.lo, tt.hi)
+			if !reflect.DeepEqual(got, tt.want) {
+				t.Errorf("got %v, want %v", got, tt.want)
+			}
+		})
+	}
+}
+
+func TestInflateBinary(t *testing.T) {
+	values := []float64{1, 2, 3, 4}
+	raw := float64Bytes(values...)
+	block := literalBlock(shuffle(raw, 8))
+	header := &Response{Type: "binary", Length: len(block), RawLength: len(raw), Compression: "shuffle-lz4"}
+
+	got, err := inflateBinary(bytes.NewReader(block), header, 8)
+	if err != nil {
+		t.Fatalf("inflateBinary: %v", err)
+	}
+	if !reflect.DeepEqual(got, values) {
+		t.Errorf("got %v, want %v", got, values)
+	}
+
+	// A raw_length that disagrees with the block is rejected
+	header.RawLength += 8
+	if _, err := inflateBinary(bytes.NewReader(block), header, 8); !errors.Is(err, errCorruptBlock) {
+		t.Errorf("got error %v, want errCorruptBlock", err)
+	}
+}
+
+func TestCheckCompression(t *testing.T) {
+	tests := []struct {
+		compression string
+		ok          bool
+	}{
+		{"", true},
+		{"shuffle-lz4", true},
+		{"zstd", false},
+	}
+	for _, tt := range tests {
+		err := checkCompression(&Response{Compression: tt.compression})
+		if (err == nil) != tt.ok {
+			t.Errorf("%q: got error %v", tt.compression, err)
+		}
+	}
+}
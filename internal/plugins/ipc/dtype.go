@@ -0,0 +1,95 @@
+package ipc
+
+import (
+	"encoding/binary"
+	"fmt"
+	"math"
+)
+
+// acceptedDTypes lists the compact sample formats the host can decode. Both
+// lose precision, so they are only offered with requests for a view decimated
+// to a pixel width, where the error is far below a pixel; full-resolution
+// fetches and live appends stay float64. Plugins that ignore the offer keep
+// sending float64.
+var acceptedDTypes = []string{"f32", "i32-delta"}
+
+// offeredDTypes returns the compact formats to offer with a request.
+func offeredDTypes(req *Request) []string {
+	if req.PixelWidth > 0 {
+		return acceptedDTypes
+	}
+	return nil
+}
+
+// valueBytes returns the size of one encoded value in a response's format.
+func valueBytes(header *Response) (int, error) {
+	switch header.DType {
+	case "", "f64":
+		return 8, nil
+	case "f32", "i32-delta":
+		return 4, nil
+	default:
+		return 0, fmt.Errorf("unsupported dtype: %s", header.DType)
+	}
+}
+
+// decodeSamples widens a payload of encoded points to float64 and appends it
+// to dst in the payload's own layout. For "arrays" the payload holds its x
+// block then its y block.
+func decodeSamples(dst []float64, raw []byte, header *Response) []float64 {
+	if header.Storage == "arrays" {
+		half := len(raw) / 8 * 4
+		dst = decodeColumn(dst, raw[:half], header, 0)
+		return decodeColumn(dst, raw[half:], header, 1)
+	}
+	if header.DType == "f32" {
+		return decodeColumn(dst, raw, header, 0)
+	}
+
+	// Interleaved i32-delta columns each keep their own running level
+	cols := columnQuantization(header)
+	var levels [2]int64
+	for i := 0; i+4 <= len(raw); i += 4 {
+		col := i / 4 % 2
+		levels[col] += int64(int32(binary.LittleEndian.Uint32(raw[i:])))
+		dst = append(dst, cols[col].value(levels[col]))
+	}
+	return dst
+}
+
+// decodeColumn appends one block of encoded values of column col (0 for x,
+// 1 for y). i32-delta deltas accumulate from zero at the start of the block.
+func decodeColumn(dst []float64, raw []byte, header *Response, col int) []float64 {
+	if header.DType == "f32" {
+		for i := 0; i+4 <= len(raw); i += 4 {
+			bits := binary.LittleEndian.Uint32(raw[i:])
+			dst = append(dst, float64(math.Float32frombits(bits)))
+		}
+		return dst
+	}
+
+	q := columnQuantization(header)[col]
+	var level int64
+	for i := 0; i+4 <= len(raw); i += 4 {
+		level += int64(int32(binary.LittleEndian.Uint32(raw[i:])))
+		dst = append(dst, q.value(level))
+	}
+	return dst
+}
+
+// quantization maps i32-delta levels back to values as offset + scale*level.
+type quantization struct {
+	scale  float64
+	offset float64
+}
+
+func columnQuantization(header *Response) [2]quantization {
+	return [2]quantization{
+		{header.XScale, header.XOffset},
+		{header.YScale, header.YOffset},
+	}
+}
+
+func (q quantization) value(level int64) float64 {
+	return q.offset + q.scale*float64(level)
+}
@@ -0,0 +1,139 @@
+package ipc
+
+import (
+	"encoding/binary"
+	"math"
+	"reflect"
+	"testing"
+)
+
+// float32Bytes encodes values as little-endian float32.
+func float32Bytes(values ...float32) []byte {
+	out := make([]byte, 0, len(values)*4)
+	for _, v := range values {
+		out = binary.LittleEndian.AppendUint32(out, math.Float32bits(v))
+	}
+	return out
+}
+
+// int32Bytes encodes i32-delta deltas.
+func int32Bytes(deltas ...int32) []byte {
+	out := make([]byte, 0, len(deltas)*4)
+	for _, d := range deltas {
+		out = binary.LittleEndian.AppendUint32(out, uint32(d))
+	}
+	return out
+}
+
+func TestDecodeColumn(t *testing.T) {
+	quantized := &Response{DType: "i32-delta", XScale: 0.5, XOffset: 10, YScale: 2, YOffset: -1}
+	tests := []struct {
+		name   string
+		header *Response
+		raw    []byte
+		col    int
+		dst    []float64
+		want   []float64
+	}{
+		{"f32", &Response{DType: "f32"}, float32Bytes(1.5, -2, 0.25), 0, nil, []float64{1.5, -2, 0.25}},
+		{"f32 appends", &Response{DType: "f32"}, float32Bytes(3), 1, []float64{1}, []float64{1, 3}},
+		{"i32-delta x", quantized, int32Bytes(0, 2, -1, 4), 0, nil, []float64{10, 11, 10.5, 12.5}},
+		{"i32-delta y", quantized, int32Bytes(1, 1, -3), 1, nil, []float64{1, 3, -3}},
+		{"i32-delta restarts per block", quantized, int32Bytes(4), 0, []float64{99}, []float64{99, 12}},
+		{"i32-delta extreme deltas", quantized, int32Bytes(math.MaxInt32, math.MinInt32), 0, nil,
+			[]float64{10 + 0.5*math.MaxInt32, 10 - 0.5}},
+		{"partial value ignored", &Response{DType: "f32"}, append(float32Bytes(1), 0, 0), 0, nil, []float64{1}},
+		{"empty", quantized, nil, 0, nil, nil},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			got := decodeColumn(tt.dst, tt.raw, tt.header, tt.col)
+			if !reflect.DeepEqual(got, tt.want) {
+				t.Errorf("got %v, want %v", got, tt.want)
+			}
+		})
+	}
+}
+
+func TestDecodeSamples(t *testing.T) {
+	tests := []struct {
+		name   string
+		header *Response
+		raw    []byte
+		want   []float64
+	}{
+		{
+			"f32 interleaved",
+			&Response{DType: "f32", Storage: "interleaved"},
+			float32Bytes(1, 10, 2, 20),
+			[]float64{1, 10, 2, 20},
+		},
+		{
+			"f32 arrays",
+			&Response{DType: "f32", Storage: "arrays"},
+			float32Bytes(1, 2, 10, 20),
+			[]float64{1, 2, 10, 20},
+		},
+		{
+			// Each column keeps its own running level and quantisation
+			"i32-delta interleaved",
+			&Response{DType: "i32-delta", Storage: "interleaved", XScale: 1, XOffset: 100, YScale: 0.25},
+			int32Bytes(0, 4, 1, -8, 1, 2),
+			[]float64{100, 1, 101, -1, 102, -0.5},
+		},
+		{
+			// Blocks accumulate separately, each from zero
+			"i32-delta arrays",
+			&Response{DType: "i32-delta", Storage: "arrays", XScale: 1, YScale: 1, YOffset: 5},
+			int32Bytes(3, 1, 1, -2),
+			[]float64{3, 4, 6, 4},
+		},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			got := decodeSamples(nil, tt.raw, tt.header)
+			if !reflect.DeepEqual(got, tt.want) {
+				t.Errorf("got %v, want %v", got, tt.want)
+			}
+		})
+	}
+}
+
+func TestValueBytes(t *testing.T) {
+	tests := []struct {
+		dtype string
+		want  int
+		ok    bool
+	}{
+		{"", 8, true},
+		{"f64", 8, true},
+		{"f32", 4, true},
+		{"i32-delta", 4, true},
+		{"f16", 0, false},
+	}
+	for _, tt := range tests {
+		got, err := valueBytes(&Response{DType: tt.dtype})
+		if got != tt.want || (err == nil) != tt.ok {
+			t.Errorf("%q: got %d, %v", tt.dtype, got, err)
+		}
+	}
+}
+
+func TestOfferedDTypes(t *testing.T) {
+	// Lossy formats are only offered where the result is decimated to pixels
+	tests := []struct {
+		name string
+		req  Request
+		want []string
+	}{
+		{"full resolution", Request{Method: "get_series_data"}, nil},
+		{"batch", Request{Method: "get_series_data_batch"}, nil},
+		{"view", Request{Method: "get_series_data", PixelWidth: 800}, acceptedDTypes},
+		{"range", Request{Method: "get_series_range", PixelWidth: 800}, acceptedDTypes},
+	}
+	for _, tt := range tests {
+		if got := offeredDTypes(&tt.req); !reflect.DeepEqual(got, tt.want) {
+			t.Errorf("%s: got %v, want %v", tt.name, got, tt.want)
+		}
+	}
+}
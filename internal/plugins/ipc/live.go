@@ -0,0 +1,224 @@
+package ipc
+
+import (
+	"fmt"
+	"io"
+	"slices"
+
+	"olicanaplot/internal/plugins"
+)
+
+// liveBacklog is how many append frames of a live series may wait for the
+// subscriber before later ones are joined into one held back for it.
+const liveBacklog = 64
+
+// liveHoldLimit is how many values may be held back for a subscriber that
+// has fallen liveBacklog frames behind before they are dropped.
+const liveHoldLimit = 1 << 22
+
+// liveSeries is a series the plugin appends to between requests.
+type liveSeries struct {
+	frames  chan plugins.SeriesData // Closed once the series ends
+	stopped chan struct{}           // Closed by UnsubscribeSeries
+	held    plugins.SeriesData      // Points with no room in frames yet, only touched by the reader of the plugin's output
+}
+
+// SubscribeSeries asks the plugin to keep extending a series, rate points a
+// second (0 leaves it to the plugin). Each append frame arrives on the
+// returned channel with the points added since the last, and the channel
+// closes once the plugin ends the series: after UnsubscribeSeries, when the
+// plugin stops it itself, e.g. on a configuration change, or if the plugin
+// exits. The plugin's output is shared with every other request, so a
+// subscriber that falls behind never holds it up: once liveBacklog frames
+// wait, later ones are joined into a single frame sent when there is room,
+// and dropped past liveHoldLimit values.
+//
+// While any series is live, a goroutine reads the plugin's output between
+// requests, so a request may wait for the next append frame before it is
+// sent. Plugins keep that short by sending a frame, empty if need be, every
+// few tens of milliseconds.
+func (p *Plugin) SubscribeSeries(seriesID string, preferredStorage string, rate float64) (<-chan plugins.SeriesData, error) {
+	if !slices.Contains(p.capabilities, "live") {
+		return nil, fmt.Errorf("plugin %s has no live series", p.name)
+	}
+
+	series := &liveSeries{
+		frames:  make(chan plugins.SeriesData, liveBacklog),
+		stopped: make(chan struct{}),
+	}
+	p.liveMu.Lock()
+	if _, ok := p.live[seriesID]; ok {
+		p.liveMu.Unlock()
+		return nil, fmt.Errorf("series %s is already live", seriesID)
+	}
+	if p.live == nil {
+		p.live = make(map[string]*liveSeries)
+	}
+	// Registered first, as appends may arrive ahead of the reply
+	p.live[seriesID] = series
+	p.liveMu.Unlock()
+
+	_, err := p.sendRequest(Request{
+		Method:           "subscribe_series",
+		SeriesID:         seriesID,
+		PreferredStorage: preferredStorage,
+		Rate:             rate,
+	})
+	if err != nil {
+		p.endLive(seriesID, series)
+		return nil, err
+	}
+
+	// Multiplexing plugins have their output read by demux throughout
+	p.liveMu.Lock()
+	if !p.pumping && len(p.live) > 0 && !p.multiplexed() {
+		p.pumping = true
+		go p.pumpLive()
+	}
+	p.liveMu.Unlock()
+	return series.frames, nil
+}
+
+// UnsubscribeSeries asks the plugin to stop extending a series. Frames
+// still on their way are dropped, and the subscriber's channel closes once
+// the plugin has sent the series' last.
+func (p *Plugin) UnsubscribeSeries(seriesID string) error {
+	p.liveMu.Lock()
+	series, ok := p.live[seriesID]
+	if ok {
+		select {
+		case <-series.stopped:
+		default:
+			close(series.stopped)
+		}
+	}
+	p.liveMu.Unlock()
+	if !ok {
+		return nil
+	}
+
+	_, err := p.sendRequest(Request{Method: "unsubscribe_series", SeriesID: seriesID})
+	return err
+}
+
+// handleAppend reads the payload of an append frame and hands it to the
+// series' subscriber, or ends the series for {"type":"end"}. Frames of
+// series no longer subscribed to are read and dropped. The payload is read
+// from r, where the header came from. It never waits for the subscriber:
+// points it has no room for are held back and sent with the next frame.
+func (p *Plugin) handleAppend(header *Response, r io.Reader) error {
+	p.liveMu.Lock()
+	series := p.live[header.SeriesID]
+	p.liveMu.Unlock()
+
+	if header.Type == "end" {
+		if series != nil {
+			if series.held.Data != nil {
+				select {
+				case series.frames <- series.held:
+				default:
+				}
+			}
+			p.endLive(header.SeriesID, series)
+		}
+		return nil
+	}
+
+	pipe := &dataStream{p: p, r: r}
+	data, err := pipe.readSeriesPayload(header)
+	if err != nil || series == nil {
+		return err
+	}
+
+	frame := plugins.SeriesData{ID: header.SeriesID, Data: data, Storage: header.Storage}
+	if series.held.Data != nil {
+		frame = joinAppends(series.held, frame)
+		series.held = plugins.SeriesData{}
+	}
+	select {
+	case series.frames <- frame:
+	case <-series.stopped:
+	default:
+		if len(frame.Data) > liveHoldLimit {
+			if p.logger != nil {
+				p.logger.Warn("Live subscriber fell behind, dropped points", "component", p.name, "series", header.SeriesID, "points", len(frame.Data)/2)
+			}
+			return nil
+		}
+		series.held = frame
+	}
+	return nil
+}
+
+// joinAppends joins the points of two append frames of a series, next after
+// held. An "arrays" frame holds its x block then its y block, so the blocks
+// are joined separately.
+func joinAppends(held, next plugins.SeriesData) plugins.SeriesData {
+	if held.Storage != next.Storage {
+		return next // Plugins keep one layout per series; never expected
+	}
+	data := make([]float64, 0, len(held.Data)+len(next.Data))
+	if next.Storage == "arrays" {
+		hx, hy := held.Data[:len(held.Data)/2], held.Data[len(held.Data)/2:]
+		nx, ny := next.Data[:len(next.Data)/2], next.Data[len(next.Data)/2:]
+		data = append(append(append(append(data, hx...), nx...), hy...), ny...)
+	} else {
+		data = append(append(data, held.Data...), next.Data...)
+	}
+	next.Data = data
+	return next
+}
+
+// endLive forgets a live series and closes its subscriber's channel.
+func (p *Plugin) endLive(seriesID string, series *liveSeries) {
+	p.liveMu.Lock()
+	defer p.liveMu.Unlock()
+	if p.live[seriesID] == series {
+		delete(p.live, seriesID)
+		close(series.frames)
+	}
+}
+
+// pumpLive reads the plugin's output while no request is, so append frames
+// reach their subscribers between requests. It holds p.commsMu for one
+// message at a time and stops once no series is live. If the plugin exits,
+// every live series ends.
+func (p *Plugin) pumpLive() {
+	for {
+		p.commsMu.Lock()
+		p.liveMu.Lock()
+		if len(p.live) == 0 || !p.running {
+			p.pumping = false
+			p.liveMu.Unlock()
+			p.commsMu.Unlock()
+			if !p.running {
+				p.endAllLive()
+			}
+			return
+		}
+		p.liveMu.Unlock()
+
+		resp, async, err := p.readMessage(0)
+		p.commsMu.Unlock()
+		if err != nil {
+			if p.logger != nil {
+				p.logger.Error("Lost live series", "component", p.name, "error", err)
+			}
+			if !p.running {
+				continue // Ends every series on the next pass
+			}
+		} else if !async && p.logger != nil {
+			p.logger.Warn("Dropped unexpected plugin message", "component", p.name, "type", resp.Type, "error", resp.Error)
+		}
+	}
+}
+
+// endAllLive ends every live series, e.g. once the plugin has exited.
+func (p *Plugin) endAllLive() {
+	p.liveMu.Lock()
+	defer p.liveMu.Unlock()
+	for id, series := range p.live {
+		delete(p.live, id)
+		close(series.frames)
+	}
+}
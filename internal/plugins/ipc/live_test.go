@@ -0,0 +1,95 @@
+package ipc
+
+import (
+	"bytes"
+	"reflect"
+	"testing"
+
+	"olicanaplot/internal/plugins"
+)
+
+// appendMessage encodes an append frame of float64 values for a series.
+func appendMessage(seriesID, storage string, values ...float64) (*Response, []byte) {
+	payload := float64Bytes(values...)
+	return &Response{Method: "append", SeriesID: seriesID, Type: "binary", Length: len(payload), Storage: storage}, payload
+}
+
+// newLivePlugin returns a plugin with one live series whose subscriber has
+// room for backlog frames.
+func newLivePlugin(seriesID string, backlog int) (*Plugin, *liveSeries) {
+	series := &liveSeries{
+		frames:  make(chan plugins.SeriesData, backlog),
+		stopped: make(chan struct{}),
+	}
+	return &Plugin{name: "fake", live: map[string]*liveSeries{seriesID: series}}, series
+}
+
+func TestHandleAppendHoldsPointsForSlowSubscriber(t *testing.T) {
+	tests := []struct {
+		name    string
+		storage string
+		frames  [][]float64
+		want    []float64
+	}{
+		{"interleaved", "interleaved", [][]float64{{1, 10}, {2, 20}, {3, 30, 4, 40}}, []float64{2, 20, 3, 30, 4, 40}},
+		{"arrays", "arrays", [][]float64{{1, 10}, {2, 20}, {3, 4, 30, 40}}, []float64{2, 3, 4, 20, 30, 40}},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			p, series := newLivePlugin("s1", 1)
+
+			// The first frame fills the backlog; the rest must not block
+			for _, values := range tt.frames {
+				header, payload := appendMessage("s1", tt.storage, values...)
+				if err := p.handleAppend(header, bytes.NewReader(payload)); err != nil {
+					t.Fatalf("handleAppend: %v", err)
+				}
+			}
+			if got := (<-series.frames).Data; !reflect.DeepEqual(got, tt.frames[0]) {
+				t.Fatalf("first frame: got %v, want %v", got, tt.frames[0])
+			}
+
+			// The held points go out joined with the next frame
+			header, payload := appendMessage("s1", tt.storage)
+			if err := p.handleAppend(header, bytes.NewReader(payload)); err != nil {
+				t.Fatalf("handleAppend: %v", err)
+			}
+			if got := (<-series.frames).Data; !reflect.DeepEqual(got, tt.want) {
+				t.Errorf("joined frame: got %v, want %v", got, tt.want)
+			}
+		})
+	}
+}
+
+func TestHandleAppendFlushesHeldPointsOnEnd(t *testing.T) {
+	p, series := newLivePlugin("s1", 2)
+	for _, values := range [][]float64{{1, 10}, {2, 20}, {3, 30}} {
+		header, payload := appendMessage("s1", "interleaved", values...)
+		p.handleAppend(header, bytes.NewReader(payload))
+	}
+	<-series.frames // Makes room for the held frame
+	if err := p.handleAppend(&Response{Method: "append", SeriesID: "s1", Type: "end"}, nil); err != nil {
+		t.Fatalf("handleAppend: %v", err)
+	}
+
+	var got [][]float64
+	for frame := range series.frames {
+		got = append(got, frame.Data)
+	}
+	want := [][]float64{{2, 20}, {3, 30}}
+	if !reflect.DeepEqual(got, want) {
+		t.Errorf("got %v, want %v", got, want)
+	}
+}
+
+func TestHandleAppendSkipsUnsubscribedSeries(t *testing.T) {
+	p, _ := newLivePlugin("s1", 1)
+	header, payload := appendMessage("other", "interleaved", 1, 2)
+	r := bytes.NewReader(append(payload, []byte("next")...))
+	if err := p.handleAppend(header, r); err != nil {
+		t.Fatalf("handleAppend: %v", err)
+	}
+	if r.Len() != len("next") {
+		t.Errorf("payload not consumed: %d bytes left", r.Len())
+	}
+}
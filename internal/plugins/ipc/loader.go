@@ -5,14 +5,17 @@ package ipc
 import (
 	"bufio"
 	"encoding/json"
+	"errors"
 	"fmt"
 	"io"
 	"os"
 	"os/exec"
 	"path/filepath"
 	"runtime"
+	"slices"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 	"unsafe"
 
@@ -104,7 +107,7 @@ func (l *Loader) Discover() ([]*Plugin, error) {
 
 // Plugin wraps an external process as a plugin.
 type Plugin struct {
-	mu           sync.Mutex
+	mu           sync.RWMutex // Held shared by multiplexed data requests, else exclusively
 	execPath     string
 	execArgs     []string
 	workDir      string
@@ -114,18 +117,48 @@ type Plugin struct {
 	name         string
 	version      uint32
 	filePatterns []plugins.FilePattern
+	capabilities []string // Optional protocol features, e.g. "cancel"
 	running      bool
 	logger       logging.Logger
 	app          *application.App
-	commsMu      sync.Mutex // For synchronizing stdin/stdout access
+	commsMu      sync.Mutex             // For synchronizing stdin/stdout access
+	stdinMu      sync.Mutex             // Held for each write to stdin
+	nextID       atomic.Uint64          // Source of data request ids
+	pendingMu    sync.Mutex             // Guards pending
+	pending      map[uint64]*dataStream // Data requests being answered, by id
+	demuxEnded   bool                   // The plugin's output has ended, guarded by pendingMu
+	replies      chan *Response         // Untagged replies read by demux, for plugins with "multiplex"
+	liveMu       sync.Mutex             // Guards live and pumping
+	live         map[string]*liveSeries
+	pumping      bool // A goroutine reads append frames between requests
 }
 
+// errPluginReply marks errors reported by the plugin itself, after which the
+// stream is still in sync.
+var errPluginReply = errors.New("plugin error")
+
+// errMalformedMessage marks a line of plugin output that is not a message,
+// after which the next line can still be read.
+var errMalformedMessage = errors.New("malformed plugin message")
+
 // Request represents an IPC request message sent from the host.
 type Request struct {
 	Method           string                 `json:"method"`
+	ID               uint64                 `json:"id,omitempty"` // Identifies a data request for "cancel" and tags its reply
 	Args             string                 `json:"args,omitempty"`
 	SeriesID         string                 `json:"series_id,omitempty"`
+	SeriesIDs        []string               `json:"series_ids,omitempty"` // For get_series_data_batch
 	PreferredStorage string                 `json:"preferred_storage,omitempty"`
+	Transport        string                 `json:"transport,omitempty"`   // "shm" to accept shared memory responses
+	Multiplex        bool                   `json:"multiplex,omitempty"`   // Shared memory is kept until "release"
+	DTypes           []string               `json:"dtypes,omitempty"`      // Compact sample formats the host decodes
+	Compression      []string               `json:"compression,omitempty"` // Payload compressions the host inflates
+	PixelWidth       int                    `json:"pixel_width,omitempty"` // View hints for series data
+	XMin             *float64               `json:"x_min,omitempty"`
+	XMax             *float64               `json:"x_max,omitempty"`
+	Progressive      bool                   `json:"progressive,omitempty"` // Ask for coarse previews first
+	LogLevel         string                 `json:"log_level,omitempty"`   // Least severe log level to send
+	Rate             float64                `json:"rate,omitempty"`        // Points per second for subscribe_series
 	Data             map[string]interface{} `json:"data,omitempty"`
 }
 
@@ -134,11 +167,25 @@ type Request struct {
 // to allow the host to unmarshal it into different concrete types.
 type Response struct {
 	Method           string          `json:"method,omitempty"` // For async messages like "log" or "show_form"
+	ID               uint64          `json:"id,omitempty"`     // The data request a reply belongs to
 	Result           json.RawMessage `json:"result,omitempty"`
 	Error            string          `json:"error,omitempty"`
 	Type             string          `json:"type,omitempty"`
 	Length           int             `json:"length,omitempty"`
 	Storage          string          `json:"storage,omitempty"`
+	Points           int             `json:"points,omitempty"`    // Optional total point count for "chunked" responses
+	SeriesID         string          `json:"series_id,omitempty"` // Tags each frame of a "batch" response
+	Count            int             `json:"count,omitempty"`     // Number of frames in a "batch" response
+	Handle           string          `json:"handle,omitempty"`    // Shared memory name for "shm" responses
+	Offset           int             `json:"offset,omitempty"`
+	DType            string          `json:"dtype,omitempty"`       // Sample format; float64 when empty
+	Compression      string          `json:"compression,omitempty"` // Payload compression; none when empty
+	RawLength        int             `json:"raw_length,omitempty"`  // Inflated size of a compressed frame
+	Preview          bool            `json:"preview,omitempty"`     // A coarse frame ahead of the series' final one
+	XScale           float64         `json:"x_scale,omitempty"`
+	XOffset          float64         `json:"x_offset,omitempty"`
+	YScale           float64         `json:"y_scale,omitempty"`
+	YOffset          float64         `json:"y_offset,omitempty"`
 	Name             string          `json:"name,omitempty"`
 	Version          uint32          `json:"version,omitempty"`
 	Title            string          `json:"title,omitempty"`
@@ -152,6 +199,7 @@ type Response struct {
 type PluginMetadata struct {
 	Name         string                `json:"name"`
 	FilePatterns []plugins.FilePattern `json:"patterns"`
+	Capabilities []string              `json:"capabilities,omitempty"`
 	Command      interface{}           `json:"command"` // string or []string
 	WorkDir      string                `json:"workDir"` // optional
 }
@@ -173,6 +221,7 @@ func (l *Loader) NewPluginFromManifest(manifestPath string) (*Plugin, error) {
 	p := &Plugin{
 		name:         meta.Name,
 		filePatterns: meta.FilePatterns,
+		capabilities: meta.Capabilities,
 		workDir:      pluginDir,
 		version:      1,
 	}
@@ -238,6 +287,7 @@ func NewPlugin(execPath string) (*Plugin, error) {
 				p.name = meta.Name
 			}
 			p.filePatterns = meta.FilePatterns
+			p.capabilities = meta.Capabilities
 		}
 	}
 
@@ -277,6 +327,13 @@ func (p *Plugin) start() error {
 	}
 
 	p.running = true
+	if p.multiplexed() {
+		p.replies = make(chan *Response, 1)
+		p.pendingMu.Lock()
+		p.demuxEnded = false
+		p.pendingMu.Unlock()
+		go p.demux(p.stdout, p.replies)
+	}
 	return nil
 }
 
@@ -332,55 +389,21 @@ func (p *Plugin) sendInternal(req Request) (*Response, error) {
 		p.logger.Debug("IPC -> PLUGIN", "json", strings.TrimSpace(string(reqBytes)))
 	}
 
-	if _, err := p.stdin.Write(reqBytes); err != nil {
+	if err := p.writeLine(reqBytes); err != nil {
 		return nil, fmt.Errorf("failed to write request: %w", err)
 	}
 
 	for {
-		// Read response line
-		respLine, err := p.stdout.ReadString('\n')
+		resp, err := p.nextReply()
 		if err != nil {
-			p.running = false
-			return nil, fmt.Errorf("failed to read response: %w", err)
-		}
-
-		if p.logger != nil {
-			p.logger.Debug("PLUGIN -> IPC", "json", strings.TrimSpace(respLine))
-		}
-
-		var resp Response
-		if err := json.Unmarshal([]byte(strings.TrimSpace(respLine)), &resp); err != nil {
-			return nil, fmt.Errorf("failed to parse response: %w", err)
-		}
-
-		// Handle asynchronous "log" method from plugin
-		if resp.Method == "log" {
-			if p.logger != nil {
-				var logData struct {
-					Level   string `json:"level"`
-					Message string `json:"message"`
-				}
-				json.Unmarshal([]byte(respLine), &logData)
-
-				switch strings.ToLower(logData.Level) {
-				case "error":
-					p.logger.Error(logData.Message, "component", p.name)
-				case "warn":
-					p.logger.Warn(logData.Message, "component", p.name)
-				case "debug":
-					p.logger.Debug(logData.Message, "component", p.name)
-				default:
-					p.logger.Info(logData.Message, "component", p.name)
-				}
-			}
-			continue // Keep waiting for the actual response
+			return nil, err
 		}
 
 		// Handle "show_form" request from plugin
 		if resp.Method == "show_form" {
 			// We MUST release commsMu while waiting for the form to allow form_change events
 			p.commsMu.Unlock()
-			err := p.handleShowForm(resp)
+			err := p.handleShowForm(*resp)
 			p.commsMu.Lock()
 			if err != nil {
 				return nil, err
@@ -392,7 +415,7 @@ func (p *Plugin) sendInternal(req Request) (*Response, error) {
 			return nil, fmt.Errorf("plugin error: %s", resp.Error)
 		}
 
-		return &resp, nil
+		return resp, nil
 	}
 }
 
@@ -577,7 +600,7 @@ func (p *Plugin) handleShowForm(formMsg Response) error {
 		p.logger.Debug("IPC -> PLUGIN (form-result)", "json", strings.TrimSpace(string(respBytes)))
 	}
 
-	if _, err := p.stdin.Write(respBytes); err != nil {
+	if err := p.writeLine(respBytes); err != nil {
 		return fmt.Errorf("failed to write form response to plugin: %w", err)
 	}
 
@@ -619,10 +642,14 @@ func (p *Plugin) Initialize(ctx interface{}, initStr string, logger logging.Logg
 		}
 	}
 
+	// Changing the configuration makes a series still being generated stale
+	p.CancelPending()
+
 	logger.Debug("Sending initialize request to IPC plugin")
 	resp, err := p.sendRequest(Request{
-		Method: "initialize",
-		Args:   initStr,
+		Method:   "initialize",
+		Args:     initStr,
+		LogLevel: logging.LevelName(),
 	})
 	if err != nil {
 		logger.Error("IPC plugin initialization failed", "error", err)
@@ -668,6 +695,12 @@ func (p *Plugin) GetSeriesConfig() ([]plugins.SeriesConfig, error) {
 
 // GetSeriesData returns binary float64 data for the specified series ID.
 func (p *Plugin) GetSeriesData(seriesID string, preferredStorage string) ([]float64, string, error) {
+	return p.GetSeriesDataForView(seriesID, preferredStorage, plugins.ViewHints{})
+}
+
+// GetSeriesDataForView requests series data with optional view hints, which the
+// plugin may use to decimate the series to the visible range and pixel width.
+func (p *Plugin) GetSeriesDataForView(seriesID string, preferredStorage string, hints plugins.ViewHints) ([]float64, string, error) {
 	// Re-check running status - sendRequest handles it too but GetSeriesData is custom
 	if !p.running {
 		if err := p.start(); err != nil {
@@ -675,21 +708,237 @@ func (p *Plugin) GetSeriesData(seriesID string, preferredStorage string) ([]floa
 		}
 	}
 
-	p.mu.Lock()
-	defer p.mu.Unlock()
-
-	p.commsMu.Lock()
-	defer p.commsMu.Unlock()
-
 	req := Request{
 		Method:           "get_series_data",
 		SeriesID:         seriesID,
 		PreferredStorage: preferredStorage,
+		PixelWidth:       hints.PixelWidth,
+	}
+	if hints.XMin != nil && hints.XMax != nil {
+		req.XMin = hints.XMin
+		req.XMax = hints.XMax
+	}
+	return p.requestSeriesData(req)
+}
+
+// GetSeriesRange returns the part of a series within [xMin, xMax], reduced by
+// the plugin to what is visible at pixelWidth.
+func (p *Plugin) GetSeriesRange(seriesID string, preferredStorage string, xMin, xMax float64, pixelWidth int) ([]float64, string, error) {
+	if !p.running {
+		if err := p.start(); err != nil {
+			return nil, "", err
+		}
+	}
+
+	return p.requestSeriesData(Request{
+		Method:           "get_series_range",
+		SeriesID:         seriesID,
+		PreferredStorage: preferredStorage,
+		PixelWidth:       pixelWidth,
+		XMin:             &xMin,
+		XMax:             &xMax,
+	})
+}
+
+// requestSeriesData sends a data request and reads the binary or chunked reply.
+func (p *Plugin) requestSeriesData(req Request) ([]float64, string, error) {
+	defer p.logElapsed(req.Method, time.Now())
+	s, err := p.openStream(req)
+	if err != nil {
+		return nil, "", err
+	}
+	defer s.close()
+
+	resp, err := s.next()
+	if err != nil {
+		return nil, "", err
+	}
+
+	// Single requests never ask for previews, but skip any that arrive
+	for resp.Preview {
+		if _, err := s.readSeriesPayload(resp); err != nil {
+			return nil, "", err
+		}
+		if resp, err = s.next(); err != nil {
+			return nil, "", err
+		}
+	}
+
+	if resp.Error != "" {
+		return nil, "", fmt.Errorf("plugin error: %s", resp.Error)
+	}
+
+	data, err := s.readSeriesPayload(resp)
+	if err != nil {
+		return nil, "", err
+	}
+	return data, resp.Storage, nil
+}
+
+// SupportsBatch reports whether the plugin lists the "batch" capability, so
+// it answers get_series_data_batch.
+func (p *Plugin) SupportsBatch() bool {
+	return slices.Contains(p.capabilities, "batch")
+}
+
+// GetSeriesDataBatch requests several series in one round trip. The plugin
+// streams them back as frames tagged with their series id, in whatever order
+// they finish; results are returned in the order of seriesIDs.
+func (p *Plugin) GetSeriesDataBatch(seriesIDs []string, preferredStorage string) ([]plugins.SeriesData, error) {
+	if !p.SupportsBatch() {
+		return nil, fmt.Errorf("plugin %s has no batch requests", p.name)
+	}
+	return p.requestSeriesBatch(seriesIDs, preferredStorage, nil)
+}
+
+// GetSeriesDataBatchProgressive is GetSeriesDataBatch with coarse previews:
+// plugins may send decimated versions of a series ahead of its full data,
+// and each is passed to preview as it arrives. Plugins that do not support
+// previews only send the final frames.
+func (p *Plugin) GetSeriesDataBatchProgressive(seriesIDs []string, preferredStorage string, preview func(plugins.SeriesData)) ([]plugins.SeriesData, error) {
+	if !p.SupportsBatch() {
+		return nil, fmt.Errorf("plugin %s has no batch requests", p.name)
+	}
+	return p.requestSeriesBatch(seriesIDs, preferredStorage, preview)
+}
+
+// requestSeriesBatch sends a get_series_data_batch request, asking for
+// previews when preview is not nil.
+func (p *Plugin) requestSeriesBatch(seriesIDs []string, preferredStorage string, preview func(plugins.SeriesData)) ([]plugins.SeriesData, error) {
+	if !p.running {
+		if err := p.start(); err != nil {
+			return nil, err
+		}
+	}
+
+	defer p.logElapsed("get_series_data_batch", time.Now())
+	s, err := p.openStream(Request{
+		Method:           "get_series_data_batch",
+		SeriesIDs:        seriesIDs,
+		PreferredStorage: preferredStorage,
+		Progressive:      preview != nil,
+	})
+	if err != nil {
+		return nil, err
 	}
+	defer s.close()
+
+	resp, err := s.next()
+	if err != nil {
+		return nil, err
+	}
+	if resp.Error != "" {
+		return nil, fmt.Errorf("plugin error: %s", resp.Error)
+	}
+	if resp.Type != "batch" {
+		return nil, fmt.Errorf("expected batch response, got: %s", resp.Type)
+	}
+
+	results := make([]plugins.SeriesData, len(seriesIDs))
+	for i, id := range seriesIDs {
+		results[i].ID = id
+	}
+
+	// Read every frame even after a failed series to keep the stream in sync.
+	// Previews come on top of the frames counted in the batch header.
+	var firstErr error
+	for i := 0; i < resp.Count; {
+		frame, err := s.next()
+		if err != nil {
+			return nil, err
+		}
+		if frame.Preview {
+			data, err := s.readSeriesPayload(frame)
+			if err != nil {
+				return nil, err
+			}
+			if preview != nil {
+				preview(plugins.SeriesData{ID: frame.SeriesID, Data: data, Storage: frame.Storage})
+			}
+			continue
+		}
+		i++
+		if frame.Error != "" {
+			if firstErr == nil {
+				firstErr = fmt.Errorf("plugin error for series %s: %s", frame.SeriesID, frame.Error)
+			}
+			continue
+		}
+
+		data, err := s.readSeriesPayload(frame)
+		if errors.Is(err, errPluginReply) {
+			// A stream that ended in an error frame, e.g. when cancelled
+			if firstErr == nil {
+				firstErr = fmt.Errorf("series %s: %w", frame.SeriesID, err)
+			}
+			continue
+		}
+		if err != nil {
+			return nil, err
+		}
+		for j := range results {
+			if results[j].ID == frame.SeriesID {
+				results[j].Data = data
+				results[j].Storage = frame.Storage
+			}
+		}
+	}
+
+	return results, firstErr
+}
+
+// logElapsed logs how long a data request took as seen by the host, to set
+// against the plugin's own timing from GetMetrics.
+func (p *Plugin) logElapsed(method string, start time.Time) {
+	if p.logger != nil {
+		p.logger.Debug("Plugin data request finished", "method", method, "elapsed", time.Since(start))
+	}
+}
+
+// GetMetrics returns the plugin's own metrics as reported by get_metrics: for
+// each method, the requests served, their wall time and the bytes and points
+// sent, plus the totals of the plugin's timing spans. The difference from
+// the host's elapsed time for the same requests is spent in the pipe. It
+// returns nil for plugins without the "metrics" capability.
+func (p *Plugin) GetMetrics() (json.RawMessage, error) {
+	if !slices.Contains(p.capabilities, "metrics") {
+		return nil, nil
+	}
+	resp, err := p.sendRequest(Request{Method: "get_metrics"})
+	if err != nil {
+		return nil, err
+	}
+	return resp.Result, nil
+}
+
+// GetSeriesSummary returns a series' count, extents, mean and variance as
+// computed by the plugin, which for plugins that generate their series is
+// far cheaper than fetching the data.
+func (p *Plugin) GetSeriesSummary(seriesID string) (*plugins.SeriesSummary, error) {
+	if !slices.Contains(p.capabilities, "summary") {
+		return nil, fmt.Errorf("plugin %s has no series summaries", p.name)
+	}
+	resp, err := p.sendRequest(Request{Method: "get_series_summary", SeriesID: seriesID})
+	if err != nil {
+		return nil, err
+	}
+
+	var summary plugins.SeriesSummary
+	if err := json.Unmarshal(resp.Result, &summary); err != nil {
+		return nil, fmt.Errorf("failed to parse series summary: %w", err)
+	}
+	return &summary, nil
+}
+
+// writeDataRequest sends a request whose reply is read from a dataStream,
+// offering the encodings the host decodes.
+func (p *Plugin) writeDataRequest(req Request) error {
+	req.DTypes = offeredDTypes(&req)
+	req.Compression = acceptedCompressions
 
 	reqBytes, err := json.Marshal(req)
 	if err != nil {
-		return nil, "", fmt.Errorf("failed to marshal request: %w", err)
+		return fmt.Errorf("failed to marshal request: %w", err)
 	}
 	reqBytes = append(reqBytes, '\n')
 
@@ -697,68 +946,295 @@ func (p *Plugin) GetSeriesData(seriesID string, preferredStorage string) ([]floa
 		p.logger.Debug("IPC -> PLUGIN", "json", strings.TrimSpace(string(reqBytes)))
 	}
 
-	if _, err := p.stdin.Write(reqBytes); err != nil {
-		return nil, "", fmt.Errorf("failed to write request: %w", err)
+	if err := p.writeLine(reqBytes); err != nil {
+		return fmt.Errorf("failed to write request: %w", err)
 	}
+	return nil
+}
 
-	for {
-		// Read header line
-		respLine, err := p.stdout.ReadString('\n')
+// writeLine writes one message line to the plugin's stdin.
+func (p *Plugin) writeLine(line []byte) error {
+	p.stdinMu.Lock()
+	defer p.stdinMu.Unlock()
+	_, err := p.stdin.Write(line)
+	return err
+}
+
+// CancelPending asks the plugin to abandon the series data requests it is
+// answering, if any. It does not wait: each pending call returns a
+// "cancelled" plugin error once the plugin stops. Plugins that do not list
+// the "cancel" capability are left alone, since they would answer the
+// unknown method and break the request/response pairing.
+func (p *Plugin) CancelPending() {
+	if !p.running || !slices.Contains(p.capabilities, "cancel") {
+		return
+	}
+
+	p.pendingMu.Lock()
+	ids := make([]uint64, 0, len(p.pending))
+	for id := range p.pending {
+		ids = append(ids, id)
+	}
+	p.pendingMu.Unlock()
+
+	for _, id := range ids {
+		msg, err := json.Marshal(Request{Method: "cancel", ID: id})
 		if err != nil {
-			p.running = false
-			return nil, "", fmt.Errorf("failed to read response header: %w", err)
+			return
 		}
-
 		if p.logger != nil {
-			p.logger.Debug("PLUGIN -> IPC", "json", strings.TrimSpace(respLine))
+			p.logger.Debug("IPC -> PLUGIN", "json", string(msg))
 		}
+		p.writeLine(append(msg, '\n'))
+	}
+}
 
-		var resp Response
-		if err := json.Unmarshal([]byte(strings.TrimSpace(respLine)), &resp); err != nil {
-			return nil, "", fmt.Errorf("failed to parse response header: %w", err)
+// readSeriesPayload reads the data that follows a "binary" or "chunked" header.
+func (s *dataStream) readSeriesPayload(header *Response) ([]float64, error) {
+	width, err := valueBytes(header)
+	if err != nil {
+		return nil, err
+	}
+	if err := checkCompression(header); err != nil {
+		return nil, err
+	}
+
+	switch header.Type {
+	case "binary":
+		if header.RawLength > 0 {
+			return inflateBinary(s.r, header, width)
 		}
 
-		// Handle intermediate "log" messages
-		if resp.Method == "log" {
-			if p.logger != nil {
-				var logData struct {
-					Level   string `json:"level"`
-					Message string `json:"message"`
-				}
-				json.Unmarshal([]byte(respLine), &logData)
-				switch strings.ToLower(logData.Level) {
-				case "error":
-					p.logger.Error(logData.Message, "component", p.name)
-				case "warn":
-					p.logger.Warn(logData.Message, "component", p.name)
-				case "debug":
-					p.logger.Debug(logData.Message, "component", p.name)
-				default:
-					p.logger.Info(logData.Message, "component", p.name)
-				}
-			}
-			continue
+		// Read binary data (header.Length bytes)
+		binaryData := make([]byte, header.Length)
+		if _, err := io.ReadFull(s.r, binaryData); err != nil {
+			return nil, fmt.Errorf("failed to read binary data: %w", err)
 		}
 
-		if resp.Error != "" {
-			return nil, "", fmt.Errorf("plugin error: %s", resp.Error)
+		// Convert bytes to float64 slice
+		if width != 8 {
+			return decodeSamples(make([]float64, 0, header.Length/width), binaryData, header), nil
 		}
+		return bytesToFloats(binaryData), nil
+
+	case "chunked":
+		return s.readChunkedData(header, width)
 
-		if resp.Type != "binary" {
-			return nil, "", fmt.Errorf("expected binary response, got: %s", resp.Type)
+	case "shm":
+		s.mapped = true
+		return readSharedMemory(header.Handle, header.Offset, header.Length)
+
+	default:
+		return nil, fmt.Errorf("expected binary response, got: %s", header.Type)
+	}
+}
+
+// nextReply returns the plugin's reply to a control request: handed over by
+// demux for multiplexing plugins, else read off the pipe, skipping messages
+// the plugin sends unprompted. The caller must hold p.commsMu.
+func (p *Plugin) nextReply() (*Response, error) {
+	if !p.multiplexed() {
+		return p.readDataMessage(0)
+	}
+	resp, ok := <-p.replies
+	if !ok {
+		return nil, fmt.Errorf("failed to read response: %w", errPluginExited)
+	}
+	return resp, nil
+}
+
+// readDataMessage reads the next JSON line from the plugin that is not a
+// "log" or "append" message or a frame of another request's reply, handling
+// those on the way.
+func (p *Plugin) readDataMessage(reader uint64) (*Response, error) {
+	for {
+		resp, async, err := p.readMessage(reader)
+		if err != nil || !async {
+			return resp, err
 		}
+	}
+}
+
+// readMessage reads the next JSON line from the plugin for the data request
+// with id reader, or for none if it is 0. Messages the plugin sends
+// unprompted, "log" lines and the "append" frames of live series, are
+// handled on the spot and reported as async, as are frames tagged with the
+// id of another data request, which are routed to it. The caller must hold
+// p.commsMu.
+func (p *Plugin) readMessage(reader uint64) (resp *Response, async bool, err error) {
+	return p.readFrom(p.stdout, reader)
+}
+
+// readFrom is readMessage reading from stdout, the output of one run of the
+// plugin.
+func (p *Plugin) readFrom(stdout *bufio.Reader, reader uint64) (resp *Response, async bool, err error) {
+	respLine, err := stdout.ReadString('\n')
+	if err != nil {
+		p.running = false
+		return nil, false, fmt.Errorf("failed to read response: %w", err)
+	}
+
+	if p.logger != nil {
+		p.logger.Debug("PLUGIN -> IPC", "json", strings.TrimSpace(respLine))
+	}
+
+	resp = &Response{}
+	if err := json.Unmarshal([]byte(strings.TrimSpace(respLine)), resp); err != nil {
+		return nil, false, fmt.Errorf("%w: %w", errMalformedMessage, err)
+	}
 
-		// Read binary data (resp.Length bytes)
-		binaryData := make([]byte, resp.Length)
-		if _, err := io.ReadFull(p.stdout, binaryData); err != nil {
-			return nil, "", fmt.Errorf("failed to read binary data: %w", err)
+	switch resp.Method {
+	case "log":
+		p.forwardLog(respLine)
+		return resp, true, nil
+	case "append":
+		return resp, true, p.handleAppend(resp, stdout)
+	}
+	if resp.ID != 0 && resp.ID != reader {
+		return resp, true, p.routeFrame(stdout, resp)
+	}
+	return resp, false, nil
+}
+
+// readChunkedData reads the frames of a "chunked" response: a sequence of
+// {"type":"chunk","length":N} headers each followed by N bytes, terminated by
+// {"type":"end"}. Chunks are read straight into the result slice. For
+// "arrays" storage each chunk holds its own x block followed by its y block,
+// so the blocks are gathered separately and joined at the end. Values are
+// width bytes each; anything but float64 is decoded per chunk. Chunks with a
+// raw_length are compressed and inflate to that many bytes; float64 values
+// are unshuffled from them straight into the result.
+func (s *dataStream) readChunkedData(header *Response, width int) ([]float64, error) {
+	arrays := header.Storage == "arrays"
+	var in inflater
+
+	var xs, ys []float64
+	if header.Points > 0 {
+		if arrays {
+			xs = make([]float64, 0, 2*header.Points)
+			ys = make([]float64, 0, header.Points)
+		} else {
+			xs = make([]float64, 0, 2*header.Points)
 		}
+	}
 
-		// Convert bytes to float64 slice
-		return bytesToFloats(binaryData), resp.Storage, nil
+	for {
+		frame, err := s.next()
+		if err != nil {
+			return nil, err
+		}
+
+		switch frame.Type {
+		case "end":
+			if arrays {
+				xs = append(xs, ys...)
+			}
+			return xs, nil
+		case "chunk":
+		default:
+			if frame.Error != "" {
+				return nil, fmt.Errorf("%w: %s", errPluginReply, frame.Error)
+			}
+			return nil, fmt.Errorf("expected chunk frame, got: %s", frame.Type)
+		}
+
+		rawLength := frame.Length
+		if frame.RawLength > 0 {
+			rawLength = frame.RawLength
+		}
+		if rawLength%(2*width) != 0 {
+			return nil, fmt.Errorf("invalid chunk length %d: not a whole number of points", rawLength)
+		}
+
+		if frame.RawLength > 0 && width == 8 {
+			shuffled, err := in.read(s.r, frame.Length, frame.RawLength)
+			if err != nil {
+				return nil, err
+			}
+			values := rawLength / 8
+			if arrays {
+				xs = appendUnshuffled(xs, shuffled, 0, values/2)
+				ys = appendUnshuffled(ys, shuffled, values/2, values)
+			} else {
+				xs = appendUnshuffled(xs, shuffled, 0, values)
+			}
+		} else if width != 8 {
+			raw, err := in.readRaw(s.r, frame, width)
+			if err != nil {
+				return nil, err
+			}
+			if arrays {
+				half := rawLength / 2
+				xs = decodeColumn(xs, raw[:half], header, 0)
+				ys = decodeColumn(ys, raw[half:], header, 1)
+			} else {
+				xs = decodeSamples(xs, raw, header)
+			}
+		} else if arrays {
+			half := frame.Length / 16
+			if xs, err = s.readFloats(xs, half); err != nil {
+				return nil, err
+			}
+			if ys, err = s.readFloats(ys, half); err != nil {
+				return nil, err
+			}
+		} else {
+			if xs, err = s.readFloats(xs, frame.Length/8); err != nil {
+				return nil, err
+			}
+		}
 	}
 }
 
+// readFloats appends n little-endian float64 values of the current frame's
+// payload directly into dst's backing array.
+func (s *dataStream) readFloats(dst []float64, n int) ([]float64, error) {
+	start := len(dst)
+	dst = slices.Grow(dst, n)[:start+n]
+	if n == 0 {
+		return dst, nil
+	}
+	buf := unsafe.Slice((*byte)(unsafe.Pointer(&dst[start])), n*8)
+	if _, err := io.ReadFull(s.r, buf); err != nil {
+		return nil, fmt.Errorf("failed to read chunk data: %w", err)
+	}
+	return dst, nil
+}
+
+// forwardLog relays a plugin "log" message line to the host logger.
+func (p *Plugin) forwardLog(respLine string) {
+	if p.logger == nil {
+		return
+	}
+
+	var logData struct {
+		Level   string `json:"level"`
+		Message string `json:"message"`
+	}
+	json.Unmarshal([]byte(respLine), &logData)
+
+	switch strings.ToLower(logData.Level) {
+	case "error":
+		p.logger.Error(logData.Message, "component", p.name)
+	case "warn":
+		p.logger.Warn(logData.Message, "component", p.name)
+	case "debug":
+		p.logger.Debug(logData.Message, "component", p.name)
+	default:
+		p.logger.Info(logData.Message, "component", p.name)
+	}
+}
+
+// copyFloats copies float64 data out of memory Go does not own, such as a
+// shared memory mapping that is about to be unmapped.
+func copyFloats(data []byte) []float64 {
+	floats := make([]float64, len(data)/8)
+	if len(floats) > 0 {
+		copy(unsafe.Slice((*byte)(unsafe.Pointer(&floats[0])), len(floats)*8), data)
+	}
+	return floats
+}
+
 // bytesToFloats converts little-endian bytes to float64 slice without copying.
 func bytesToFloats(data []byte) []float64 {
 	if len(data) == 0 {
@@ -783,6 +1259,33 @@ func displayNameFromPath(execPath string) string {
 	return displayName
 }
 
+// Reusable reports whether the plugin lists the "reset" capability, so its
+// process can be kept for the next document.
+func (p *Plugin) Reusable() bool {
+	return slices.Contains(p.capabilities, "reset")
+}
+
+// Warm starts the plugin process if it is not running yet, so the first
+// request does not wait for it.
+func (p *Plugin) Warm() error {
+	return p.start()
+}
+
+// Reset returns the running plugin process to its state at startup. The
+// plugin ends its live series first, so their subscribers' channels close.
+// Plugins without the "reset" capability are closed instead, to start afresh
+// on their next request.
+func (p *Plugin) Reset() error {
+	if !p.Reusable() {
+		return p.Close()
+	}
+	if !p.running {
+		return nil
+	}
+	_, err := p.sendRequest(Request{Method: "reset"})
+	return err
+}
+
 // Close stops the plugin process.
 func (p *Plugin) Close() error {
 	p.mu.Lock()
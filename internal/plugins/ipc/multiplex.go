@@ -0,0 +1,229 @@
+package ipc
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"slices"
+)
+
+// streamBacklog is how many frames the demultiplexer may hold for a
+// request that has not read them yet before it stops reading the pipe.
+const streamBacklog = 4
+
+var errPluginExited = errors.New("plugin exited")
+
+// frame is one message of a data reply that the demultiplexer read off the
+// pipe, held with its payload until its request gets to it.
+type frame struct {
+	header  *Response
+	payload []byte
+}
+
+// dataStream reads the reply to one data request. Plugins without the
+// "multiplex" capability answer one request at a time, so the request holds
+// p.mu and p.commsMu throughout and reads straight from the pipe. Plugins
+// with it tag every frame with the request's id and may interleave the
+// replies to several requests, so each request holds p.mu shared and is
+// handed its frames by demux, the only reader of such a plugin's output.
+type dataStream struct {
+	p      *Plugin
+	id     uint64
+	shared bool          // Multiplexed with other requests
+	mapped bool          // Read shared memory the plugin holds until released
+	frames chan frame    // Frames routed by demux; closed if the plugin exits
+	done   chan struct{} // Closed once the request ends
+	r      io.Reader     // Payload of the current frame
+}
+
+// openStream sends a data request, tagged with an id that CancelPending can
+// refer to, and returns the stream its reply is read from. The caller must
+// close it.
+func (p *Plugin) openStream(req Request) (*dataStream, error) {
+	s := &dataStream{p: p, shared: p.multiplexed()}
+	if s.shared {
+		p.mu.RLock()
+		// Plugins free the shared memory of earlier replies once a request
+		// finds them idle, unless told the host may still be mapping it
+		req.Multiplex = true
+		s.frames = make(chan frame, streamBacklog)
+		s.done = make(chan struct{})
+	} else {
+		p.mu.Lock()
+		p.commsMu.Lock()
+		s.r = p.stdout
+	}
+	req.Transport = sharedMemoryTransport
+
+	s.id = p.nextID.Add(1)
+	p.pendingMu.Lock()
+	if s.shared && p.demuxEnded {
+		p.pendingMu.Unlock()
+		p.mu.RUnlock()
+		return nil, errPluginExited
+	}
+	if p.pending == nil {
+		p.pending = make(map[uint64]*dataStream)
+	}
+	p.pending[s.id] = s
+	p.pendingMu.Unlock()
+
+	req.ID = s.id
+	if err := p.writeDataRequest(req); err != nil {
+		s.close()
+		return nil, err
+	}
+	return s, nil
+}
+
+// close ends the request. Frames of its reply still to come are dropped.
+func (s *dataStream) close() {
+	p := s.p
+	p.pendingMu.Lock()
+	delete(p.pending, s.id)
+	p.pendingMu.Unlock()
+
+	if !s.shared {
+		p.commsMu.Unlock()
+		p.mu.Unlock()
+		return
+	}
+	close(s.done)
+	if s.mapped {
+		p.release(s.id)
+	}
+	p.mu.RUnlock()
+}
+
+// next returns the next frame of the reply, whose payload is then read from
+// s.r.
+func (s *dataStream) next() (*Response, error) {
+	if !s.shared {
+		return s.p.readDataMessage(s.id)
+	}
+	f, ok := <-s.frames
+	if !ok {
+		return nil, fmt.Errorf("failed to read response: %w", errPluginExited)
+	}
+	s.r = bytes.NewReader(f.payload)
+	return f.header, nil
+}
+
+// multiplexed reports whether the plugin interleaves the replies to data
+// requests, so its output is read by demux.
+func (p *Plugin) multiplexed() bool {
+	return slices.Contains(p.capabilities, "multiplex")
+}
+
+// demux is the only reader of a multiplexing plugin's output, from its start
+// until it exits. Tagged frames are read payload and all and routed to their
+// requests, untagged replies go to the control request waiting on replies,
+// and "log" and "append" messages are handled on the spot. A request that
+// falls streamBacklog frames behind holds up the pipe until it catches up,
+// which bounds what is buffered, while the others keep receiving theirs as
+// they arrive. Once the plugin's output ends, so does every open request and
+// live series.
+func (p *Plugin) demux(stdout *bufio.Reader, replies chan<- *Response) {
+	for {
+		resp, async, err := p.readFrom(stdout, 0)
+		if errors.Is(err, errMalformedMessage) {
+			if p.logger != nil {
+				p.logger.Warn("Dropped malformed plugin message", "component", p.name, "error", err)
+			}
+			continue
+		}
+		if err != nil {
+			if p.logger != nil && p.running {
+				p.logger.Error("Lost plugin output", "component", p.name, "error", err)
+			}
+			p.running = false
+			break
+		}
+		if async {
+			continue
+		}
+		select {
+		case replies <- resp:
+		default:
+			if p.logger != nil {
+				p.logger.Warn("Dropped unexpected plugin message", "component", p.name, "type", resp.Type, "error", resp.Error)
+			}
+		}
+	}
+
+	p.pendingMu.Lock()
+	p.demuxEnded = true
+	for _, s := range p.pending {
+		if s.shared {
+			close(s.frames)
+		}
+	}
+	p.pendingMu.Unlock()
+	close(replies)
+	p.endAllLive()
+}
+
+// routeFrame reads a frame tagged with another request's id, payload and
+// all, and passes it to that request, waiting while the request has
+// streamBacklog frames still to read. Frames of requests that have ended
+// are read and dropped.
+func (p *Plugin) routeFrame(r io.Reader, header *Response) error {
+	p.pendingMu.Lock()
+	s := p.pending[header.ID]
+	p.pendingMu.Unlock()
+
+	n := payloadLength(header)
+	if s == nil || !s.shared {
+		p.dropFrame(header)
+		if _, err := io.CopyN(io.Discard, r, int64(n)); err != nil {
+			return fmt.Errorf("failed to skip frame data: %w", err)
+		}
+		return nil
+	}
+
+	payload := make([]byte, n)
+	if _, err := io.ReadFull(r, payload); err != nil {
+		return fmt.Errorf("failed to read frame data: %w", err)
+	}
+	select {
+	case s.frames <- frame{header: header, payload: payload}:
+	case <-s.done:
+		p.dropFrame(header)
+	}
+	return nil
+}
+
+// dropFrame frees what a frame that no request will read holds in the
+// plugin: the shared memory of a multiplexed "shm" frame.
+func (p *Plugin) dropFrame(header *Response) {
+	if header.Type == "shm" && p.multiplexed() {
+		p.release(header.ID)
+	}
+}
+
+// payloadLength returns how many bytes follow a frame's header on the pipe.
+func payloadLength(header *Response) int {
+	switch header.Type {
+	case "binary", "chunk":
+		return header.Length
+	}
+	return 0
+}
+
+// release tells the plugin the host is done with the shared memory it sent
+// to a multiplexed request.
+func (p *Plugin) release(id uint64) {
+	msg, err := json.Marshal(Request{Method: "release", ID: id})
+	if err != nil {
+		return
+	}
+	if p.logger != nil {
+		p.logger.Debug("IPC -> PLUGIN", "json", string(msg))
+	}
+	if err := p.writeLine(append(msg, '\n')); err != nil && p.logger != nil {
+		p.logger.Warn("Failed to release shared memory", "id", id, "error", err)
+	}
+}
@@ -0,0 +1,343 @@
+package ipc
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"errors"
+	"io"
+	"reflect"
+	"testing"
+	"time"
+)
+
+// nopCloser discards what the host writes to a fake plugin's stdin.
+type nopCloser struct{ io.Writer }
+
+func (nopCloser) Close() error { return nil }
+
+// newFakePlugin returns a running multiplexing plugin whose output is read
+// from stdout, with demux started on it.
+func newFakePlugin(stdout io.Reader) *Plugin {
+	p := &Plugin{
+		name:         "fake",
+		capabilities: []string{"multiplex"},
+		stdin:        nopCloser{io.Discard},
+		stdout:       bufio.NewReader(stdout),
+		running:      true,
+		replies:      make(chan *Response, 1),
+	}
+	go p.demux(p.stdout, p.replies)
+	return p
+}
+
+// message encodes a header line followed by its payload.
+func message(header Response, payload []byte) []byte {
+	line, _ := json.Marshal(header)
+	return append(append(line, '\n'), payload...)
+}
+
+// binaryFrame encodes a "binary" frame of interleaved float64 points tagged
+// with id.
+func binaryFrame(id uint64, values ...float64) []byte {
+	payload := float64Bytes(values...)
+	return message(Response{ID: id, Type: "binary", Length: len(payload), Storage: "interleaved"}, payload)
+}
+
+// openTestStream opens a data request on p, failing the test on error.
+func openTestStream(t *testing.T, p *Plugin) *dataStream {
+	t.Helper()
+	s, err := p.openStream(Request{Method: "get_series_data"})
+	if err != nil {
+		t.Fatalf("openStream: %v", err)
+	}
+	return s
+}
+
+// readValues reads the next frame of s and returns its values.
+func readValues(t *testing.T, s *dataStream) []float64 {
+	t.Helper()
+	header, err := s.next()
+	if err != nil {
+		t.Fatalf("next: %v", err)
+	}
+	data, err := s.readSeriesPayload(header)
+	if err != nil {
+		t.Fatalf("readSeriesPayload: %v", err)
+	}
+	return data
+}
+
+func TestDemuxRoutesInterleavedFrames(t *testing.T) {
+	r, w := io.Pipe()
+	defer w.Close()
+	p := newFakePlugin(r)
+	a := openTestStream(t, p)
+	defer a.close()
+	b := openTestStream(t, p)
+	defer b.close()
+
+	go func() {
+		for _, msg := range [][]byte{
+			binaryFrame(b.id, 1, 2),
+			binaryFrame(a.id, 3, 4),
+			message(Response{Method: "log"}, nil),
+			binaryFrame(99, 5, 6), // A request that has ended
+			binaryFrame(b.id, 7, 8),
+			binaryFrame(a.id, 9, 10),
+		} {
+			w.Write(msg)
+		}
+	}()
+
+	// b reads both its frames before a reads any of its own
+	tests := []struct {
+		name string
+		s    *dataStream
+		want []float64
+	}{
+		{"b first", b, []float64{1, 2}},
+		{"b second", b, []float64{7, 8}},
+		{"a first", a, []float64{3, 4}},
+		{"a second", a, []float64{9, 10}},
+	}
+	for _, tt := range tests {
+		got := readValues(t, tt.s)
+		if len(got) != len(tt.want) || got[0] != tt.want[0] || got[1] != tt.want[1] {
+			t.Errorf("%s: got %v, want %v", tt.name, got, tt.want)
+		}
+	}
+}
+
+func TestDemuxBoundsFramesHeldForSlowRequest(t *testing.T) {
+	r, w := io.Pipe()
+	defer w.Close()
+	p := newFakePlugin(r)
+	slow := openTestStream(t, p)
+	defer slow.close()
+	fast := openTestStream(t, p)
+	defer fast.close()
+
+	go func() {
+		for i := 0; i < streamBacklog+1; i++ {
+			w.Write(binaryFrame(slow.id, float64(i), 0))
+		}
+		w.Write(binaryFrame(fast.id, 42, 0))
+	}()
+
+	// demux holds streamBacklog frames for the slow request, then waits for
+	// it before reading any further
+	deadline := time.Now().Add(time.Second)
+	for len(slow.frames) < streamBacklog && time.Now().Before(deadline) {
+		time.Sleep(time.Millisecond)
+	}
+	if got := len(slow.frames); got != streamBacklog {
+		t.Fatalf("slow request holds %d frames, want %d", got, streamBacklog)
+	}
+	select {
+	case f := <-fast.frames:
+		t.Fatalf("fast request got a frame past the slow request's backlog: %+v", f.header)
+	case <-time.After(20 * time.Millisecond):
+	}
+
+	for i := 0; i < streamBacklog+1; i++ {
+		if got := readValues(t, slow); got[0] != float64(i) {
+			t.Fatalf("slow frame %d: got %v", i, got)
+		}
+	}
+	if got := readValues(t, fast); got[0] != 42 {
+		t.Errorf("fast frame: got %v, want 42", got)
+	}
+}
+
+func TestDemuxDropsFramesOfClosedRequest(t *testing.T) {
+	r, w := io.Pipe()
+	defer w.Close()
+	p := newFakePlugin(r)
+	closed := openTestStream(t, p)
+	open := openTestStream(t, p)
+	defer open.close()
+
+	// More frames than the backlog, so demux must give up on the closed
+	// request rather than wait for it
+	closed.close()
+	go func() {
+		for i := 0; i < streamBacklog+2; i++ {
+			w.Write(binaryFrame(closed.id, 0, 0))
+		}
+		w.Write(binaryFrame(open.id, 1, 2))
+	}()
+
+	if got := readValues(t, open); got[0] != 1 {
+		t.Errorf("got %v, want [1 2]", got)
+	}
+}
+
+func TestDemuxHandsUntaggedRepliesToControlRequests(t *testing.T) {
+	r, w := io.Pipe()
+	defer w.Close()
+	p := newFakePlugin(r)
+
+	go w.Write(message(Response{Result: json.RawMessage(`{"ok":true}`)}, nil))
+	resp, err := p.nextReply()
+	if err != nil {
+		t.Fatalf("nextReply: %v", err)
+	}
+	if string(resp.Result) != `{"ok":true}` {
+		t.Errorf("got result %s", resp.Result)
+	}
+}
+
+func TestDemuxEndsRequestsWhenOutputEnds(t *testing.T) {
+	r, w := io.Pipe()
+	p := newFakePlugin(r)
+	s := openTestStream(t, p)
+	defer s.close()
+
+	w.Close()
+	if _, err := s.next(); !errors.Is(err, errPluginExited) {
+		t.Errorf("next: got %v, want errPluginExited", err)
+	}
+	if _, err := p.nextReply(); !errors.Is(err, errPluginExited) {
+		t.Errorf("nextReply: got %v, want errPluginExited", err)
+	}
+	if _, err := p.openStream(Request{Method: "get_series_data"}); !errors.Is(err, errPluginExited) {
+		t.Errorf("openStream: got %v, want errPluginExited", err)
+	}
+}
+
+// chunkFrame encodes a "chunk" frame of float64 values tagged with id,
+// shuffled and LZ4-compressed if compress is set.
+func chunkFrame(id uint64, compress bool, values ...float64) []byte {
+	payload := float64Bytes(values...)
+	header := Response{ID: id, Type: "chunk", Length: len(payload)}
+	if compress {
+		header.RawLength = len(payload)
+		payload = literalBlock(shuffle(payload, 8))
+		header.Length = len(payload)
+	}
+	return message(header, payload)
+}
+
+func TestReadChunkedData(t *testing.T) {
+	end := message(Response{Type: "end"}, nil)
+	tests := []struct {
+		name    string
+		header  Response
+		frames  [][]byte
+		want    []float64
+		wantErr bool
+	}{
+		{
+			"interleaved",
+			Response{Type: "chunked", Storage: "interleaved", Points: 3},
+			[][]byte{chunkFrame(0, false, 1, 10, 2, 20), chunkFrame(0, false, 3, 30), end},
+			[]float64{1, 10, 2, 20, 3, 30},
+			false,
+		},
+		{
+			// Each chunk holds its own x block then its y block
+			"arrays",
+			Response{Type: "chunked", Storage: "arrays"},
+			[][]byte{chunkFrame(0, false, 1, 2, 10, 20), chunkFrame(0, false, 3, 30), end},
+			[]float64{1, 2, 3, 10, 20, 30},
+			false,
+		},
+		{
+			"compressed arrays",
+			Response{Type: "chunked", Storage: "arrays", Compression: "shuffle-lz4", Points: 3},
+			[][]byte{chunkFrame(0, true, 1, 2, 10, 20), chunkFrame(0, true, 3, 30), end},
+			[]float64{1, 2, 3, 10, 20, 30},
+			false,
+		},
+		{
+			"compressed interleaved",
+			Response{Type: "chunked", Storage: "interleaved", Compression: "shuffle-lz4"},
+			[][]byte{chunkFrame(0, true, 1, 10), chunkFrame(0, false, 2, 20), end},
+			[]float64{1, 10, 2, 20},
+			false,
+		},
+		{
+			"f32 arrays",
+			Response{Type: "chunked", Storage: "arrays", DType: "f32"},
+			[][]byte{
+				message(Response{Type: "chunk", Length: 16}, float32Bytes(1, 2, 10, 20)),
+				message(Response{Type: "chunk", Length: 8}, float32Bytes(3, 30)),
+				end,
+			},
+			[]float64{1, 2, 3, 10, 20, 30},
+			false,
+		},
+		{
+			"cancelled",
+			Response{Type: "chunked", Storage: "interleaved"},
+			[][]byte{chunkFrame(0, false, 1, 10), message(Response{Error: "cancelled"}, nil)},
+			nil,
+			true,
+		},
+		{
+			"partial point",
+			Response{Type: "chunked", Storage: "interleaved"},
+			[][]byte{chunkFrame(0, false, 1, 10, 2), end},
+			nil,
+			true,
+		},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			var out []byte
+			for _, f := range tt.frames {
+				out = append(out, f...)
+			}
+			p := &Plugin{stdout: bufio.NewReader(bytes.NewReader(out))}
+			s := &dataStream{p: p, r: p.stdout}
+
+			got, err := s.readSeriesPayload(&tt.header)
+			if (err != nil) != tt.wantErr {
+				t.Fatalf("got error %v, want error %v", err, tt.wantErr)
+			}
+			if !tt.wantErr && !reflect.DeepEqual(got, tt.want) {
+				t.Errorf("got %v, want %v", got, tt.want)
+			}
+		})
+	}
+}
+
+func TestReadChunkedDataInterleavedReplies(t *testing.T) {
+	r, w := io.Pipe()
+	defer w.Close()
+	p := newFakePlugin(r)
+	a := openTestStream(t, p)
+	defer a.close()
+	b := openTestStream(t, p)
+	defer b.close()
+
+	go func() {
+		for _, msg := range [][]byte{
+			message(Response{ID: a.id, Type: "chunked", Storage: "arrays", Compression: "shuffle-lz4"}, nil),
+			message(Response{ID: b.id, Type: "chunked", Storage: "interleaved"}, nil),
+			chunkFrame(a.id, true, 1, 2, 10, 20),
+			chunkFrame(b.id, false, 5, 50),
+			chunkFrame(b.id, false, 6, 60),
+			chunkFrame(a.id, true, 3, 30),
+			message(Response{ID: b.id, Type: "end"}, nil),
+			message(Response{ID: a.id, Type: "end"}, nil),
+		} {
+			w.Write(msg)
+		}
+	}()
+
+	tests := []struct {
+		name string
+		s    *dataStream
+		want []float64
+	}{
+		{"b", b, []float64{5, 50, 6, 60}},
+		{"a", a, []float64{1, 2, 3, 10, 20, 30}},
+	}
+	for _, tt := range tests {
+		if got := readValues(t, tt.s); !reflect.DeepEqual(got, tt.want) {
+			t.Errorf("%s: got %v, want %v", tt.name, got, tt.want)
+		}
+	}
+}
@@ -0,0 +1,38 @@
+//go:build linux
+
+package ipc
+
+import (
+	"fmt"
+	"os"
+	"strings"
+	"syscall"
+)
+
+// sharedMemoryTransport is requested from plugins for large series data.
+const sharedMemoryTransport = "shm"
+
+// readSharedMemory maps a POSIX shared memory object created with shm_open,
+// which Linux exposes under /dev/shm, and unlinks it once mapped.
+func readSharedMemory(handle string, offset, length int) ([]float64, error) {
+	path := "/dev/shm/" + strings.TrimPrefix(handle, "/")
+	file, err := os.Open(path)
+	if err != nil {
+		return nil, fmt.Errorf("failed to open shared memory: %w", err)
+	}
+	defer file.Close()
+	// The name is no longer needed; the memory lives until it is unmapped
+	os.Remove(path)
+
+	if length == 0 {
+		return nil, nil
+	}
+
+	mem, err := syscall.Mmap(int(file.Fd()), 0, offset+length, syscall.PROT_READ, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, fmt.Errorf("failed to map shared memory: %w", err)
+	}
+	defer syscall.Munmap(mem)
+
+	return copyFloats(mem[offset : offset+length]), nil
+}
@@ -0,0 +1,12 @@
+//go:build !linux && !windows
+
+package ipc
+
+import "errors"
+
+// Shared memory is not wired up on this platform, so data uses the pipe.
+const sharedMemoryTransport = ""
+
+func readSharedMemory(handle string, offset, length int) ([]float64, error) {
+	return nil, errors.New("shared memory transport is not supported on this platform")
+}
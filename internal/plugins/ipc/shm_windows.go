@@ -0,0 +1,41 @@
+//go:build windows
+
+package ipc
+
+import (
+	"fmt"
+	"syscall"
+	"unsafe"
+)
+
+// sharedMemoryTransport is requested from plugins for large series data.
+const sharedMemoryTransport = "shm"
+
+var procOpenFileMappingW = syscall.NewLazyDLL("kernel32.dll").NewProc("OpenFileMappingW")
+
+// readSharedMemory maps a named file mapping created by the plugin.
+func readSharedMemory(handle string, offset, length int) ([]float64, error) {
+	if length == 0 {
+		return nil, nil
+	}
+
+	name, err := syscall.UTF16PtrFromString(handle)
+	if err != nil {
+		return nil, err
+	}
+	mapping, _, callErr := procOpenFileMappingW.Call(syscall.FILE_MAP_READ, 0, uintptr(unsafe.Pointer(name)))
+	if mapping == 0 {
+		return nil, fmt.Errorf("failed to open shared memory: %w", callErr)
+	}
+	defer syscall.CloseHandle(syscall.Handle(mapping))
+
+	addr, err := syscall.MapViewOfFile(syscall.Handle(mapping), syscall.FILE_MAP_READ, 0, 0, uintptr(offset+length))
+	if err != nil {
+		return nil, fmt.Errorf("failed to map shared memory: %w", err)
+	}
+	defer syscall.UnmapViewOfFile(addr)
+
+	// The view lies outside the Go heap, so building a slice over it is safe
+	mem := unsafe.Slice((*byte)(unsafe.Add(unsafe.Pointer(nil), addr)), offset+length)
+	return copyFloats(mem[offset : offset+length]), nil
+}
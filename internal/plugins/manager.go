@@ -3,6 +3,7 @@ package plugins
 
 import (
 	"fmt"
+	"slices"
 	"sync"
 
 	"olicanaplot/internal/logging"
@@ -15,11 +16,16 @@ type pluginEntry struct {
 	enabled  bool
 }
 
+// WarmPoolSize is how many inactive plugins may keep a reset process running,
+// ready for the next document that uses them.
+const WarmPoolSize = 4
+
 // Manager handles registration and lookup of plugins.
 type Manager struct {
 	mu           sync.RWMutex
 	plugins      map[string]pluginEntry
 	activePlugin string         // Currently active plugin name
+	warm         []string       // Inactive plugins with a warm process, oldest first
 	logger       logging.Logger // Structured logger
 }
 
@@ -92,9 +98,76 @@ func (m *Manager) SetActive(name string) error {
 		return fmt.Errorf("plugin not found: %s", name)
 	}
 	m.activePlugin = name
+	m.warm = slices.DeleteFunc(m.warm, func(warm string) bool { return warm == name })
 	return nil
 }
 
+// Release readies a plugin for its next document. A reusable plugin is reset
+// and its process stays in the warm pool, closing the longest unused one if
+// the pool is full; other plugins are closed and start afresh when next used.
+func (m *Manager) Release(p Plugin) {
+	warm, ok := p.(WarmPlugin)
+	if !ok || !warm.Reusable() {
+		p.Close()
+		return
+	}
+	if err := warm.Reset(); err != nil {
+		m.logger.Warn("Failed to reset plugin, closing it", "name", p.Name(), "error", err)
+		p.Close()
+		return
+	}
+	m.keepWarm(p.Name(), true)
+}
+
+// Prewarm starts the processes of reusable plugins ahead of their first
+// request, as many as fit in the warm pool.
+func (m *Manager) Prewarm() {
+	m.mu.RLock()
+	candidates := make(map[string]WarmPlugin)
+	for name, entry := range m.plugins {
+		if warm, ok := entry.plugin.(WarmPlugin); ok && entry.enabled && warm.Reusable() && name != m.activePlugin {
+			candidates[name] = warm
+		}
+		if len(candidates) == WarmPoolSize {
+			break
+		}
+	}
+	m.mu.RUnlock()
+
+	for name, warm := range candidates {
+		if err := warm.Warm(); err != nil {
+			m.logger.Warn("Failed to prewarm plugin", "name", name, "error", err)
+			continue
+		}
+		m.keepWarm(name, false)
+	}
+}
+
+// keepWarm adds a plugin to the warm pool, closing the longest unused
+// plugins beyond its size. The active plugin is left out, since a document
+// may have activated it while it was warming and the pool would later close
+// it in use, unless it is being released on the way to another one.
+func (m *Manager) keepWarm(name string, releasing bool) {
+	m.mu.Lock()
+	if name == m.activePlugin && !releasing {
+		m.mu.Unlock()
+		return
+	}
+	m.warm = slices.DeleteFunc(m.warm, func(warm string) bool { return warm == name })
+	m.warm = append(m.warm, name)
+	var evicted []Plugin
+	for len(m.warm) > WarmPoolSize {
+		evicted = append(evicted, m.plugins[m.warm[0]].plugin)
+		m.warm = m.warm[1:]
+	}
+	m.mu.Unlock()
+
+	for _, p := range evicted {
+		m.logger.Debug("Closing plugin beyond the warm pool", "name", p.Name())
+		p.Close()
+	}
+}
+
 // ActiveName returns the name of the active plugin.
 func (m *Manager) ActiveName() string {
 	m.mu.RLock()
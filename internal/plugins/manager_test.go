@@ -0,0 +1,79 @@
+package plugins
+
+import (
+	"fmt"
+	"testing"
+
+	"olicanaplot/internal/logging"
+)
+
+// warmPlugin is a reusable plugin that records whether it was closed, and
+// runs onWarm while its process starts.
+type warmPlugin struct {
+	name   string
+	closed bool
+	onWarm func()
+}
+
+func (p *warmPlugin) Name() string                   { return p.name }
+func (p *warmPlugin) Version() uint32                { return PluginAPIVersion }
+func (p *warmPlugin) Path() string                   { return "" }
+func (p *warmPlugin) GetFilePatterns() []FilePattern { return nil }
+func (p *warmPlugin) Initialize(interface{}, string, logging.Logger) (string, error) {
+	return "", nil
+}
+func (p *warmPlugin) GetChartConfig(string) (*ChartConfig, error) { return nil, nil }
+func (p *warmPlugin) GetSeriesConfig() ([]SeriesConfig, error)    { return nil, nil }
+func (p *warmPlugin) GetSeriesData(string, string) ([]float64, string, error) {
+	return nil, "", nil
+}
+func (p *warmPlugin) Close() error   { p.closed = true; return nil }
+func (p *warmPlugin) Reusable() bool { return true }
+func (p *warmPlugin) Reset() error   { return nil }
+func (p *warmPlugin) Warm() error {
+	if p.onWarm != nil {
+		p.onWarm()
+	}
+	return nil
+}
+
+func TestPrewarmSkipsPluginActivatedWhileWarming(t *testing.T) {
+	m := NewManager(logging.NewLogger("test"))
+	m.Register(&warmPlugin{name: "first"}, true)
+
+	// A document activates the plugin while Prewarm is starting it
+	target := &warmPlugin{name: "target"}
+	target.onWarm = func() { m.SetActive("target") }
+	m.Register(target, true)
+	m.Prewarm()
+
+	// Filling the pool with released plugins must not evict the active one
+	for i := 0; i < WarmPoolSize+1; i++ {
+		p := &warmPlugin{name: fmt.Sprintf("other-%d", i)}
+		m.Register(p, true)
+		m.Release(p)
+	}
+	if target.closed {
+		t.Error("active plugin was closed by the warm pool")
+	}
+	if m.ActiveName() != "target" {
+		t.Errorf("active plugin is %s, want target", m.ActiveName())
+	}
+}
+
+func TestReleaseKeepsActivePluginWarm(t *testing.T) {
+	m := NewManager(logging.NewLogger("test"))
+	active := &warmPlugin{name: "active"}
+	m.Register(active, true)
+
+	// Released on the way to another document, the active plugin is pooled
+	m.Release(active)
+	m.Register(&warmPlugin{name: "next"}, true)
+	m.SetActive("next")
+	if len(m.warm) != 1 || m.warm[0] != "active" {
+		t.Errorf("warm pool is %v, want [active]", m.warm)
+	}
+	if active.closed {
+		t.Error("released plugin was closed")
+	}
+}
@@ -258,3 +258,102 @@ type Plugin interface {
 	// Close cleans up plugin resources. Called on shutdown.
 	Close() error
 }
+
+// ViewHints describes the view a series will be drawn into. Plugins may use it
+// to return only the visually significant points instead of the full series.
+type ViewHints struct {
+	PixelWidth int      // Width of the plot area in device pixels (0 = no hint)
+	XMin       *float64 // Visible x range; XMin and XMax are set together
+	XMax       *float64
+}
+
+// ViewAwarePlugin is implemented by plugins that can reduce series data to a
+// view, e.g. by min/max decimation per pixel column.
+type ViewAwarePlugin interface {
+	// GetSeriesDataForView behaves like GetSeriesData but may return a reduced
+	// series that looks identical when drawn into the described view.
+	GetSeriesDataForView(seriesID string, preferredStorage string, hints ViewHints) ([]float64, string, error)
+}
+
+// SeriesData is one series of a batch response.
+type SeriesData struct {
+	ID      string
+	Data    []float64
+	Storage string // "interleaved" or "arrays"
+}
+
+// BatchPlugin is implemented by plugins that can return several series in a
+// single request, generating them concurrently.
+type BatchPlugin interface {
+	// SupportsBatch reports whether the plugin answers batch requests.
+	SupportsBatch() bool
+
+	// GetSeriesDataBatch returns the requested series in the order given.
+	GetSeriesDataBatch(seriesIDs []string, preferredStorage string) ([]SeriesData, error)
+}
+
+// ProgressivePlugin is implemented by batch plugins that can send coarse
+// previews of each series while the full data is still being produced.
+type ProgressivePlugin interface {
+	// GetSeriesDataBatchProgressive behaves like GetSeriesDataBatch, calling
+	// preview with each decimated version of a series that arrives before its
+	// final data. preview runs on the calling goroutine.
+	GetSeriesDataBatchProgressive(seriesIDs []string, preferredStorage string, preview func(SeriesData)) ([]SeriesData, error)
+}
+
+// RangePlugin is implemented by plugins that keep a level-of-detail cache of
+// their series and can answer zoom and pan queries without regenerating them.
+type RangePlugin interface {
+	// GetSeriesRange returns the points of a series within [xMin, xMax],
+	// reduced to what is visible at pixelWidth.
+	GetSeriesRange(seriesID string, preferredStorage string, xMin, xMax float64, pixelWidth int) ([]float64, string, error)
+}
+
+// LivePlugin is implemented by plugins whose series can keep growing, such as
+// live acquisition sources. Subscribers receive only the points appended
+// since the last frame, instead of refetching the whole series.
+type LivePlugin interface {
+	// SubscribeSeries starts appending to a series at about rate points a
+	// second (0 for the plugin's default). Each frame on the channel holds
+	// the new points; the channel closes when the series stops growing.
+	SubscribeSeries(seriesID string, preferredStorage string, rate float64) (<-chan SeriesData, error)
+
+	// UnsubscribeSeries stops appending to a series.
+	UnsubscribeSeries(seriesID string) error
+}
+
+// SeriesSummary describes a series without its points: its size and extents,
+// and the mean and population variance of its y values.
+type SeriesSummary struct {
+	Count    int     `json:"count"`
+	XMin     float64 `json:"x_min"`
+	XMax     float64 `json:"x_max"`
+	YMin     float64 `json:"y_min"`
+	YMax     float64 `json:"y_max"`
+	Mean     float64 `json:"mean"`
+	Variance float64 `json:"variance"`
+}
+
+// SummaryPlugin is implemented by plugins that can summarise a series
+// without sending it, so axes can be scaled before the data is fetched.
+type SummaryPlugin interface {
+	// GetSeriesSummary returns the summary of a series. The plugin may
+	// generate the series to compute it, keeping it for the data request
+	// that usually follows.
+	GetSeriesSummary(seriesID string) (*SeriesSummary, error)
+}
+
+// WarmPlugin is implemented by plugins that run as a separate process and can
+// keep it between documents, returning it to its initial state instead of
+// restarting it. The Manager keeps a pool of such processes warm.
+type WarmPlugin interface {
+	// Reusable reports whether the plugin can be reset.
+	Reusable() bool
+
+	// Warm starts the plugin's process ahead of its first request.
+	Warm() error
+
+	// Reset returns the plugin's running process to its state at startup:
+	// default configuration, no live series and no cached data.
+	Reset() error
+}
@@ -40,11 +40,12 @@ func (s *Service) SetApp(app interface{}) {
 func (s *Service) ActivatePlugin(name string, initStr string) error {
 	s.logger.Info("Activating plugin", "name", name)
 
-	// Close the current active plugin if it's an IPC plugin to ensure fresh start
+	// Reset or close the current active plugin so the next document starts
+	// from a fresh state; reusable plugins keep a warm process
 	active := s.manager.GetActive()
 	if active != nil {
-		s.logger.Debug("Closing current active plugin before switch", "name", active.Name())
-		active.Close()
+		s.logger.Debug("Releasing current active plugin before switch", "name", active.Name())
+		s.manager.Release(active)
 	}
 
 	if err := s.manager.SetActive(name); err != nil {
@@ -165,6 +165,9 @@ func main() {
 		logger.Debug("IPC plugin file patterns refreshed")
 	}()
 
+	// Start reusable plugin processes ahead of the first document
+	go pluginManager.Prewarm()
+
 	// Run the application. This blocks until the application has been exited.
 	err = app.Run()
 
@@ -0,0 +1,6 @@
+@echo off
+REM Initialize Visual Studio build environment
+call "C:\Program Files\Microsoft Visual Studio\2022\Community\VC\Auxiliary\Build\vcvarsall.bat" x64 >nul 2>&1
+
+REM Build the stage benchmark
+cl /EHsc /O2 /std:c++20 /Fe:stage_bench.exe stage_bench.cpp
@@ -0,0 +1,643 @@
+// stage_bench times each stage of the random walk plugin's data path on its
+// own, across series lengths and thread counts, and reports the results as
+// JSON on stdout:
+//
+//   stage_bench [--stages sample,walk,decimate,encode,compress,write]
+//               [--points 1e5,1e6,1e7] [--threads 1,2,4] [--runs 3]
+//               [--baseline old.json] [--threshold 0.1]
+//
+//   sample    Draws a walk's time steps and increments with each kernel the
+//             CPU supports, its blocks split between the threads.
+//   walk      Generates whole walks with each kernel, as the parallel engine
+//             does: sampling, integrating blocks and offsetting them.
+//   decimate  Reduces a walk to 1000 columns with M4Decimator, and builds a
+//             SeriesPyramid and queries the whole of it.
+//   encode    Fits and encodes a walk as f32 and as i32-delta.
+//   compress  Shuffles and compresses a walk chunk by chunk through a
+//             ChunkCompressor with that many threads.
+//   write     Writes a walk to a pipe drained by another thread, or copies
+//             it into new shared memory regions.
+//
+// Stages that have no threads of their own (decimate, encode, write) run one
+// copy per thread, each over its own share of the points, which shows how
+// they scale when several requests run them at once. Each result is the
+// fastest of --runs runs. On Linux it also carries the cycles, instructions,
+// cache misses and branch misses of that run, its threads included, when
+// the kernel allows perf events.
+//
+// --baseline takes an earlier output of stage_bench, such as one saved
+// before a change, and compares every result with the one for the same
+// stage, variant, thread count and length. The exit status is 1 if any is
+// more than --threshold slower.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "../../../sdk/cpp/compress.hpp"
+#include "../../../sdk/cpp/decimate.hpp"
+#include "../../../sdk/cpp/json.hpp"
+#include "../../../sdk/cpp/protocol.hpp"
+#include "../../../sdk/cpp/pyramid.hpp"
+#include "../../../sdk/cpp/shared_memory.hpp"
+#include "../walk.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using walk::Kernel;
+
+// Hardware counters of the calling thread, and of the threads it starts,
+// between start() and stop(). Counters the kernel refuses are left out, as
+// are all of them on systems other than Linux. Threads add their counts
+// once they exit, so stages must join theirs before stop().
+class PerfCounters {
+public:
+  PerfCounters() {
+#ifdef __linux__
+    for (size_t i = 0; i < kEvents.size(); ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = kEvents[i].config;
+      attr.disabled = 1;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[i] = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  void start() {
+#ifdef __linux__
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  // The counts since start() as a JSON object, or null if there are none.
+  // Counts are scaled up for the time the kernel had them switched out.
+  std::string stop() {
+    std::string members;
+#ifdef __linux__
+    for (size_t i = 0; i < kEvents.size(); ++i) {
+      if (fds_[i] < 0) {
+        continue;
+      }
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t values[3] = {}; // Count, time enabled, time running
+      if (read(fds_[i], values, sizeof(values)) != sizeof(values) ||
+          values[2] == 0) {
+        continue;
+      }
+      double count = static_cast<double>(values[0]) *
+                     static_cast<double>(values[1]) /
+                     static_cast<double>(values[2]);
+      members += std::format("{}\"{}\":{:.0f}", members.empty() ? "" : ",",
+                             kEvents[i].name, count);
+    }
+#endif
+    return members.empty() ? "null" : "{" + members + "}";
+  }
+
+private:
+#ifdef __linux__
+  struct Event {
+    uint64_t config;
+    std::string_view name;
+  };
+  static constexpr std::array<Event, 4> kEvents = {{
+      {PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+      {PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+      {PERF_COUNT_HW_CACHE_MISSES, "cache_misses"},
+      {PERF_COUNT_HW_BRANCH_MISSES, "branch_misses"},
+  }};
+  std::array<int, kEvents.size()> fds_;
+#endif
+};
+
+// Keeps the compiler from dropping work whose results are otherwise unused.
+volatile double g_sink = 0;
+
+// One walk in the layouts the stages read it in.
+struct Series {
+  std::vector<double> interleaved;
+  std::vector<double> xs;
+  std::vector<double> ys;
+  // kDefaultChunkPoints points at a time, each chunk's x block followed by
+  // its y block, as ChunkedWriter streams arrays
+  std::vector<double> chunked;
+
+  size_t size() const { return xs.size(); }
+};
+
+walk::Params walk_params(size_t points, unsigned threads,
+                         Kernel kernel = walk::best_kernel()) {
+  return {.seed = 42,
+          .steps = points - 1,
+          .noise = 1.0,
+          .threads = threads,
+          .kernel = kernel};
+}
+
+Series make_series(size_t points) {
+  Series series;
+  series.interleaved.reserve(points * 2);
+  walk::generate(walk_params(points, 0), [&](std::span<const double> run) {
+    series.interleaved.insert(series.interleaved.end(), run.begin(),
+                              run.end());
+    return true;
+  });
+  series.xs.resize(points);
+  series.ys.resize(points);
+  for (size_t i = 0; i < points; ++i) {
+    series.xs[i] = series.interleaved[i * 2];
+    series.ys[i] = series.interleaved[i * 2 + 1];
+  }
+  series.chunked.reserve(points * 2);
+  for (size_t first = 0; first < points; first += sdk::kDefaultChunkPoints) {
+    size_t n = std::min(sdk::kDefaultChunkPoints, points - first);
+    auto xs = std::span(series.xs).subspan(first, n);
+    auto ys = std::span(series.ys).subspan(first, n);
+    series.chunked.insert(series.chunked.end(), xs.begin(), xs.end());
+    series.chunked.insert(series.chunked.end(), ys.begin(), ys.end());
+  }
+  return series;
+}
+
+// Runs f(first, count) on `threads` threads at once, each over its own share
+// of [0, points), and waits for them all.
+template <typename F> void run_shares(size_t points, unsigned threads, F f) {
+  auto share = [&](unsigned t) {
+    size_t first = points * t / threads;
+    return std::pair(first, points * (t + 1) / threads - first);
+  };
+  std::vector<std::jthread> pool;
+  for (unsigned t = 1; t < threads; ++t) {
+    pool.emplace_back([&, t] {
+      auto [first, count] = share(t);
+      f(first, count);
+    });
+  }
+  auto [first, count] = share(0);
+  f(first, count);
+}
+
+struct Result {
+  std::string stage;
+  std::string variant;
+  unsigned threads = 1;
+  size_t points = 0;
+  size_t bytes = 0; // What the stage produced, where that differs
+  double seconds = std::numeric_limits<double>::infinity();
+  std::string counters = "null";
+
+  std::string key() const {
+    return std::format("{} {} {} {}", stage, variant, threads, points);
+  }
+};
+
+// Times `runs` calls of f(), which returns the bytes it produced, keeping the
+// fastest together with its counters.
+template <typename F>
+Result measure(std::string_view stage, std::string_view variant,
+               unsigned threads, size_t points, int runs, F &&f) {
+  Result result{std::string(stage), std::string(variant), threads, points};
+  for (int r = 0; r < runs; ++r) {
+    PerfCounters counters;
+    counters.start();
+    Clock::time_point start = Clock::now();
+    size_t bytes = f();
+    std::chrono::duration<double> seconds = Clock::now() - start;
+    std::string counts = counters.stop();
+    if (seconds.count() < result.seconds) {
+      result.seconds = seconds.count();
+      result.bytes = bytes;
+      result.counters = std::move(counts);
+    }
+  }
+  return result;
+}
+
+std::vector<Kernel> supported_kernels() {
+  std::vector<Kernel> kernels;
+  for (Kernel kernel : {Kernel::Scalar, Kernel::Avx2, Kernel::Avx512}) {
+    if (static_cast<int>(kernel) <= static_cast<int>(walk::best_kernel())) {
+      kernels.push_back(kernel);
+    }
+  }
+  return kernels;
+}
+
+void bench_sample(size_t points, unsigned threads, int runs,
+                  std::vector<Result> &results) {
+  for (Kernel kernel : supported_kernels()) {
+    walk::Params params = walk_params(points, threads, kernel);
+    results.push_back(measure(
+        "sample", walk::kernel_name(kernel), threads, points, runs, [&] {
+          walk::parallel_for(
+              walk::block_count(params), threads, [&](size_t block) {
+                const walk::Increments &steps = walk::block_increments(
+                    params, block, walk::block_steps(params, block));
+                g_sink = g_sink + steps.dy.back();
+              });
+          return 0;
+        }));
+  }
+}
+
+void bench_walk(size_t points, unsigned threads, int runs,
+                std::vector<Result> &results) {
+  constexpr sdk::Layout kArrays = sdk::Layout::Arrays;
+  for (Kernel kernel : supported_kernels()) {
+    walk::Params params = walk_params(points, threads, kernel);
+    results.push_back(measure(
+        "walk", walk::kernel_name(kernel), threads, points, runs, [&] {
+          walk::WindowBuffer<kArrays> buffer;
+          walk::generate<kArrays>(
+              params, buffer,
+              [](sdk::Samples<kArrays, const double> window) {
+                g_sink = g_sink + window.y(window.size() - 1);
+                return true;
+              });
+          return 0;
+        }));
+  }
+}
+
+void bench_decimate(const Series &series, unsigned threads, int runs,
+                    std::vector<Result> &results) {
+  constexpr size_t kColumns = 1000;
+  results.push_back(
+      measure("decimate", "m4", threads, series.size(), runs, [&] {
+        run_shares(series.size(), threads, [&](size_t first, size_t count) {
+          auto decimator = sdk::M4Decimator::by_index(kColumns, count);
+          decimator.push(
+              std::span(series.interleaved).subspan(first * 2, count * 2));
+          decimator.finish();
+          g_sink = g_sink + static_cast<double>(decimator.size());
+        });
+        return 0;
+      }));
+  results.push_back(
+      measure("decimate", "pyramid", threads, series.size(), runs, [&] {
+        run_shares(series.size(), threads, [&](size_t first, size_t count) {
+          sdk::SeriesPyramid pyramid;
+          pyramid.reserve(count);
+          pyramid.push(
+              std::span(series.interleaved).subspan(first * 2, count * 2));
+          pyramid.finish();
+          sdk::M4Decimator view = pyramid.query(
+              series.xs[first], series.xs[first + count - 1], kColumns);
+          g_sink = g_sink + static_cast<double>(view.size());
+        });
+        return 0;
+      }));
+}
+
+void bench_encode(const Series &series, unsigned threads, int runs,
+                  std::vector<Result> &results) {
+  for (sdk::DType dtype : {sdk::DType::F32, sdk::DType::I32Delta}) {
+    results.push_back(measure(
+        "encode", sdk::dtype_name(dtype), threads, series.size(), runs, [&] {
+          std::atomic<size_t> bytes = 0;
+          run_shares(series.size(), threads, [&](size_t first, size_t count) {
+            auto xs = std::span(series.xs).subspan(first, count);
+            auto ys = std::span(series.ys).subspan(first, count);
+            sdk::Encoding encoding = sdk::Encoding::fit(dtype, xs, ys);
+            sdk::ArenaVector<std::byte> out;
+            encoding.encode(xs.data(), ys.data(), 1, count, true, out);
+            bytes += out.size();
+          });
+          return bytes.load();
+        }));
+  }
+}
+
+void bench_compress(const Series &series, unsigned threads, int runs,
+                    std::vector<Result> &results) {
+  for (sdk::Compression compression :
+       {sdk::Compression::Lz4, sdk::Compression::Lz4High}) {
+    std::string_view variant =
+        compression == sdk::Compression::Lz4 ? "lz4" : "lz4-high";
+    results.push_back(measure(
+        "compress", variant, threads, series.size(), runs, [&] {
+          size_t bytes = 0;
+          auto send = [&](sdk::CompressedPayload payload) {
+            bytes += payload.bytes.size();
+          };
+          sdk::ChunkCompressor compressor(compression, threads);
+          auto raw = std::as_bytes(std::span(series.chunked));
+          size_t chunk_bytes = sdk::kDefaultChunkPoints * 2 * sizeof(double);
+          for (size_t first = 0; first < raw.size(); first += chunk_bytes) {
+            compressor.submit(
+                raw.subspan(first, std::min(chunk_bytes, raw.size() - first)),
+                sizeof(double), send);
+          }
+          compressor.finish(send);
+          return bytes;
+        }));
+  }
+}
+
+// Writes bytes to a new pipe whose other end another thread reads, and
+// waits until it has read them all.
+void write_pipe(std::span<const std::byte> bytes) {
+#ifdef _WIN32
+  HANDLE read_end = nullptr;
+  HANDLE write_end = nullptr;
+  if (!CreatePipe(&read_end, &write_end, nullptr, 1 << 20)) {
+    return;
+  }
+#else
+  int ends[2];
+  if (pipe(ends) != 0) {
+    return;
+  }
+  int read_end = ends[0];
+  int write_end = ends[1];
+#endif
+
+  std::jthread reader([read_end] {
+    std::vector<char> buffer(1 << 16);
+    for (;;) {
+#ifdef _WIN32
+      DWORD got = 0;
+      if (!ReadFile(read_end, buffer.data(),
+                    static_cast<DWORD>(buffer.size()), &got, nullptr) ||
+          got == 0) {
+        break;
+      }
+#else
+      if (read(read_end, buffer.data(), buffer.size()) <= 0) {
+        break;
+      }
+#endif
+    }
+  });
+
+  while (!bytes.empty()) {
+#ifdef _WIN32
+    DWORD written = 0;
+    DWORD want = static_cast<DWORD>(std::min<size_t>(bytes.size(), 1 << 30));
+    if (!WriteFile(write_end, bytes.data(), want, &written, nullptr)) {
+      break;
+    }
+#else
+    ssize_t written = write(write_end, bytes.data(), bytes.size());
+    if (written <= 0) {
+      break;
+    }
+#endif
+    bytes = bytes.subspan(static_cast<size_t>(written));
+  }
+
+#ifdef _WIN32
+  CloseHandle(write_end);
+  reader.join();
+  CloseHandle(read_end);
+#else
+  close(write_end);
+  reader.join();
+  close(read_end);
+#endif
+}
+
+void bench_write(const Series &series, unsigned threads, int runs,
+                 std::vector<Result> &results) {
+  results.push_back(
+      measure("write", "pipe", threads, series.size(), runs, [&] {
+        run_shares(series.size(), threads, [&](size_t first, size_t count) {
+          write_pipe(std::as_bytes(
+              std::span(series.interleaved).subspan(first * 2, count * 2)));
+        });
+        return 0;
+      }));
+
+  if (!sdk::SharedRegion(sizeof(double)).valid()) {
+    std::cerr << "no shared memory, skipping write shm\n";
+    return;
+  }
+  results.push_back(
+      measure("write", "shm", threads, series.size(), runs, [&] {
+        run_shares(series.size(), threads, [&](size_t first, size_t count) {
+          auto points =
+              std::span(series.interleaved).subspan(first * 2, count * 2);
+          sdk::SharedRegion region(points.size_bytes());
+          if (region.valid()) {
+            std::ranges::copy(points, region.doubles().begin());
+            region.unmap();
+          }
+        });
+        return 0;
+      }));
+}
+
+// The points_per_s of each result in an earlier output, by Result::key().
+std::map<std::string, double> read_baseline(const std::string &path) {
+  std::map<std::string, double> baseline;
+  std::ifstream file(path, std::ios::binary);
+  std::string text((std::istreambuf_iterator<char>(file)),
+                   std::istreambuf_iterator<char>());
+  sdk::JsonObject output = sdk::JsonObject::parse(text);
+  output["results"].for_each([&](sdk::JsonValue value) {
+    sdk::JsonObject result = value.object();
+    std::string key = std::format(
+        "{} {} {} {}", result["stage"].str(), result["variant"].str(),
+        result["threads"].raw(), result["points"].raw());
+    baseline[key] = result["points_per_s"].number().value_or(0);
+  });
+  return baseline;
+}
+
+std::vector<double> parse_numbers(std::string_view text) {
+  std::vector<double> values;
+  while (!text.empty()) {
+    std::string_view item = text.substr(0, text.find(','));
+    text.remove_prefix(std::min(text.size(), item.size() + 1));
+    if (!item.empty()) {
+      values.push_back(std::atof(std::string(item).c_str()));
+    }
+  }
+  return values;
+}
+
+std::vector<std::string> parse_names(std::string_view text) {
+  std::vector<std::string> names;
+  while (!text.empty()) {
+    std::string_view item = text.substr(0, text.find(','));
+    text.remove_prefix(std::min(text.size(), item.size() + 1));
+    if (!item.empty()) {
+      names.emplace_back(item);
+    }
+  }
+  return names;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> stages =
+      parse_names("sample,walk,decimate,encode,compress,write");
+  std::vector<double> lengths = parse_numbers("1e5,1e6,1e7");
+  std::vector<double> thread_counts;
+  unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned t = 1; t < hardware; t *= 2) {
+    thread_counts.push_back(t);
+  }
+  thread_counts.push_back(hardware);
+  int runs = 3;
+  std::string baseline_path;
+  double threshold = 0.1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string_view flag = argv[i];
+    std::string_view value = argv[i + 1];
+    if (flag == "--stages") {
+      stages = parse_names(value);
+    } else if (flag == "--points") {
+      lengths = parse_numbers(value);
+    } else if (flag == "--threads") {
+      thread_counts = parse_numbers(value);
+    } else if (flag == "--runs") {
+      runs = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--baseline") {
+      baseline_path = value;
+    } else if (flag == "--threshold") {
+      threshold = std::atof(argv[i + 1]);
+    } else {
+      std::cerr << "usage: stage_bench [--stages "
+                   "sample,walk,decimate,encode,compress,write] "
+                   "[--points 1e5,1e6,1e7] [--threads 1,2,4] [--runs 3] "
+                   "[--baseline old.json] [--threshold 0.1]\n";
+      return 2;
+    }
+  }
+  auto wants = [&](std::string_view stage) {
+    return std::ranges::find(stages, stage) != stages.end();
+  };
+
+  std::vector<Result> results;
+  for (double length : lengths) {
+    auto points = std::max<size_t>(2, static_cast<size_t>(length));
+    Series series = make_series(points);
+    for (double count : thread_counts) {
+      auto threads = std::max(1u, static_cast<unsigned>(count));
+      std::cerr << std::format("points {} threads {}\n", points, threads);
+      if (wants("sample")) {
+        bench_sample(points, threads, runs, results);
+      }
+      if (wants("walk")) {
+        bench_walk(points, threads, runs, results);
+      }
+      if (wants("decimate")) {
+        bench_decimate(series, threads, runs, results);
+      }
+      if (wants("encode")) {
+        bench_encode(series, threads, runs, results);
+      }
+      if (wants("compress")) {
+        bench_compress(series, threads, runs, results);
+      }
+      if (wants("write")) {
+        bench_write(series, threads, runs, results);
+      }
+    }
+  }
+
+  std::map<std::string, double> baseline;
+  if (!baseline_path.empty()) {
+    baseline = read_baseline(baseline_path);
+    if (baseline.empty()) {
+      std::cerr << "no results in baseline " << baseline_path << '\n';
+      return 2;
+    }
+  }
+
+  std::string out = "{\"results\":[";
+  int regressions = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    double points_per_s = static_cast<double>(r.points) / r.seconds;
+    out += i == 0 ? "\n" : ",\n";
+    out += std::format(
+        R"({{"stage":"{}","variant":"{}","threads":{},"points":{},)"
+        R"("bytes":{},"seconds":{:.6f},"points_per_s":{:.0f},)"
+        R"("mb_per_s":{:.1f},"counters":{})",
+        r.stage, r.variant, r.threads, r.points, r.bytes, r.seconds,
+        points_per_s,
+        static_cast<double>(r.points) * 2 * sizeof(double) / r.seconds / 1e6,
+        r.counters);
+    if (auto base = baseline.find(r.key());
+        base != baseline.end() && base->second > 0) {
+      double change = points_per_s / base->second - 1;
+      out += std::format(R"(,"baseline_points_per_s":{:.0f},"change":{:.3f})",
+                         base->second, change);
+      if (change < -threshold) {
+        std::cerr << std::format(
+            "slower: {} {} threads {} points {}: {:+.1f}%\n", r.stage,
+            r.variant, r.threads, r.points, change * 100);
+        ++regressions;
+      }
+    }
+    out += "}";
+  }
+  out += "\n]}\n";
+  std::cout << out;
+  return regressions == 0 ? 0 : 1;
+}
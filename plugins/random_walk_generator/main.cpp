@@ -1,24 +1,43 @@
-#ifndef UNICODE
-#define UNICODE
-#endif
-
 #include <algorithm>
 #include <cmath>
-#include <ctime>
-#include <fcntl.h>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
 #include <format>
-#include <io.h>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <random>
+#include <set>
+#include <stop_token>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
-#include <windows.h>
 
+#ifdef _MSC_VER
+// No console window when the host starts the plugin
 #pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:mainCRTStartup")
+#endif
 
+#include "../../sdk/cpp/arena.hpp"
+#include "../../sdk/cpp/batch.hpp"
+#include "../../sdk/cpp/decimate.hpp"
+#include "../../sdk/cpp/live.hpp"
+#include "../../sdk/cpp/mapped_store.hpp"
+#include "../../sdk/cpp/pipeline.hpp"
 #include "../../sdk/cpp/protocol.hpp"
+#include "../../sdk/cpp/pyramid.hpp"
+#include "../../sdk/cpp/runtime.hpp"
+#include "../../sdk/cpp/shared_memory.hpp"
+#include "../../sdk/cpp/summary.hpp"
+#include "series_cache.hpp"
+#include "walk.hpp"
+
+enum class Engine { Sequential, Parallel };
 
 // Global configuration
 struct Config {
@@ -27,14 +46,116 @@ struct Config {
   int order = 6;
   double multiplier = 1.0;
   double noise = 1.0;
+  Engine engine = Engine::Parallel;
+  int threads = 0; // 0 = one per hardware thread
+  walk::Kernel kernel = walk::best_kernel();
+  uint64_t seed = 0;
+
+  // Whether both configurations generate the same series. The thread count
+  // only changes how the parallel engine's blocks are shared out, and the
+  // kernels give bit-identical walks.
+  bool same_series(const Config &other) const {
+    return numPoints == other.numPoints && numSeries == other.numSeries &&
+           order == other.order && multiplier == other.multiplier &&
+           noise == other.noise && engine == other.engine &&
+           seed == other.seed;
+  }
 };
 
 static Config g_config;
 
+// Generated series with their level-of-detail pyramids, keyed by series id.
+// Cleared whenever the configuration changes. Series too large for the
+// budget are regenerated for every request instead.
+constexpr size_t kCacheBudgetBytes = size_t{1} << 30;
+static SeriesCache g_cache(kCacheBudgetBytes);
+
+// Block checkpoints of the parallel engine's walks, keyed by series id, so
+// ranges of series too large to cache are generated on their own. Cleared
+// with the cache.
+static std::map<std::string, walk::Checkpoints, std::less<>> g_checkpoints;
+
+// Series too large to cache are spilled to memory-mapped files as they are
+// streamed, and served from there afterwards, also by later runs with the
+// same configuration. Mapped files are dropped, but not deleted, with the
+// cache.
+static std::optional<sdk::MappedSeriesStore> g_store;
+static std::map<std::string, sdk::MappedSeries, std::less<>> g_spilled;
+
+// Summaries of series too large to cache, keyed by series id, kept from
+// streaming or summarising them. Cached series carry theirs in the pyramid.
+// Cleared with the cache.
+static std::map<std::string, sdk::SeriesSummary, std::less<>> g_summaries;
+
+// Guards the checkpoints, spilled series and summaries, and the spill store,
+// for data requests on several workers. Entries are only ever erased by
+// drop_series(), once every request has finished, so pointers to them stay
+// valid while a request runs.
+static std::mutex g_series_mutex;
+// Series being spilled, so two requests never write the same file
+static std::set<std::string, std::less<>> g_spilling;
+
+// Compresses payloads sent through the pipe, for hosts that decode it. Off
+// unless asked for, as a local pipe outruns the compressor.
+static sdk::Compression g_compression = sdk::Compression::None;
+
+// Optional view hints from get_series_data and get_series_range
+struct ViewHints {
+  int pixel_width = 0;
+  std::optional<double> x_min;
+  std::optional<double> x_max;
+  std::optional<size_t> start; // Index range [start, end) of the points
+  std::optional<size_t> end;
+};
+
+// How the host wants series data sent back, and whether it still wants it
+struct Delivery {
+  std::string_view storage;             // "interleaved" or "arrays"
+  bool shared = false;                  // Accepts shared memory responses
+  std::vector<std::string_view> dtypes; // Compact formats it can decode
+  sdk::Compression compression = sdk::Compression::None; // Of payloads
+  bool progressive = false;             // Wants previews before full data
+  std::stop_token stop;                 // Triggered if the host cancels
+};
+
 // Plugin metadata
 constexpr std::string_view pluginName = "Random Walk Generator";
 constexpr int pluginVersion = 1;
 
+// Printed for --metadata, which the host runs before starting the plugin
+constexpr std::string_view metadata = R"({
+    "name": "Random Walk Generator",
+    "patterns": [],
+    "capabilities": ["cancel", "metrics", "live", "summary", "reset",
+                     "multiplex", "batch"]
+})";
+
+enum class Method {
+  Info,
+  Initialize,
+  GetChartConfig,
+  GetSeriesConfig,
+  GetSeriesData,
+  GetSeriesRange,
+  GetSeriesDataBatch,
+  SubscribeSeries,
+  UnsubscribeSeries,
+  GetSeriesSummary,
+};
+
+constexpr auto kMethods = sdk::method_table<Method>({
+    {"info", Method::Info},
+    {"initialize", Method::Initialize},
+    {"get_chart_config", Method::GetChartConfig},
+    {"get_series_config", Method::GetSeriesConfig},
+    {"get_series_data", Method::GetSeriesData},
+    {"get_series_range", Method::GetSeriesRange},
+    {"get_series_data_batch", Method::GetSeriesDataBatch},
+    {"subscribe_series", Method::SubscribeSeries},
+    {"unsubscribe_series", Method::UnsubscribeSeries},
+    {"get_series_summary", Method::GetSeriesSummary},
+});
+
 // Form schema for host-controlled UI
 constexpr std::string_view formSchema = R"({
     "method": "show_form",
@@ -62,164 +183,1199 @@ constexpr std::string_view formSchema = R"({
                 "minimum": 1,
                 "maximum": 10,
                 "default": 1
+            },
+            "engine": {
+                "type": "string",
+                "title": "Engine",
+                "enum": ["parallel", "sequential"],
+                "default": "parallel"
+            },
+            "threads": {
+                "type": "integer",
+                "title": "Threads",
+                "description": "0 uses one thread per core",
+                "minimum": 0,
+                "maximum": 64,
+                "default": 0
+            },
+            "kernel": {
+                "type": "string",
+                "title": "Sampling Kernel",
+                "enum": ["auto", "avx512", "avx2", "scalar"],
+                "default": "auto"
+            },
+            "seed": {
+                "type": "integer",
+                "title": "Seed",
+                "description": "The same seed always produces the same walks",
+                "minimum": 0,
+                "default": 0
             }
         }
     },
     "uiSchema": {
         "numSeries": {"ui:widget": "range"},
         "order": {"ui:widget": "range"},
-        "multiplier": {"ui:widget": "range"}
+        "multiplier": {"ui:widget": "range"},
+        "threads": {"ui:widget": "range"}
     }
 })";
 
 // --- Plugin Logic ---
 
-bool show_host_form() {
-  std::string schema_str(formSchema);
-  // Remove newlines to keep it a single-line JSON for the IPC protocol
-  schema_str.erase(std::remove(schema_str.begin(), schema_str.end(), '\n'),
-                   schema_str.end());
-  schema_str.erase(std::remove(schema_str.begin(), schema_str.end(), '\r'),
-                   schema_str.end());
+// Forgets every generated series: cached pyramids, checkpoints, summaries
+// and mapped spill files, which stay on disk for later runs.
+void drop_series() {
+  std::lock_guard lock(g_series_mutex);
+  g_cache.clear();
+  g_checkpoints.clear();
+  g_spilled.clear();
+  g_summaries.clear();
+  g_spilling.clear();
+}
 
-  sdk::send_response(schema_str);
+bool show_host_form() {
+  // Minified at compile time into the single line the IPC protocol needs
+  sdk::send_response(sdk::minified_json<formSchema>);
 
   // Read response from host (stdin)
-  std::string response;
-  if (!std::getline(std::cin, response)) {
+  std::string line;
+  if (!std::getline(std::cin, line)) {
     return false;
   }
 
   // Check for error/cancelled
-  if (response.find("\"error\"") != std::string::npos) {
+  sdk::JsonObject response = sdk::JsonObject::parse(line);
+  if (!response.valid() || response.contains("error")) {
     return false;
   }
 
   // Parse result
-  std::string_view series_str = sdk::find_json_value(response, "numSeries");
-  std::string_view order_str = sdk::find_json_value(response, "order");
-  std::string_view mult_str = sdk::find_json_value(response, "multiplier");
+  sdk::JsonObject result = response["result"].object();
 
+  Config previous = g_config;
   bool updated = false;
-  if (!series_str.empty()) {
-    try {
-      g_config.numSeries = std::stoi(std::string(series_str));
-      updated = true;
-    } catch (...) {
-    }
+  if (auto series = result["numSeries"].number<int>()) {
+    g_config.numSeries = *series;
+    updated = true;
   }
-  if (!order_str.empty()) {
-    try {
-      g_config.order = std::stoi(std::string(order_str));
-      updated = true;
-    } catch (...) {
-    }
+  if (auto order = result["order"].number<int>()) {
+    g_config.order = *order;
+    updated = true;
   }
-  if (!mult_str.empty()) {
-    try {
-      g_config.multiplier = std::stod(std::string(mult_str));
-      updated = true;
-    } catch (...) {
-    }
+  if (auto multiplier = result["multiplier"].number()) {
+    g_config.multiplier = *multiplier;
+    updated = true;
+  }
+
+  if (std::string_view engine = result["engine"].str(); !engine.empty()) {
+    g_config.engine =
+        engine == "sequential" ? Engine::Sequential : Engine::Parallel;
+    updated = true;
+  }
+  if (auto threads = result["threads"].number<int>()) {
+    g_config.threads = std::max(0, *threads);
+    updated = true;
+  }
+
+  if (std::string_view kernel = result["kernel"].str(); !kernel.empty()) {
+    g_config.kernel = walk::select_kernel(kernel);
+    updated = true;
+  }
+  if (auto seed = result["seed"].number<uint64_t>()) {
+    g_config.seed = *seed;
+    updated = true;
   }
 
   if (updated) {
     g_config.numPoints =
         static_cast<int>(g_config.multiplier * std::pow(10, g_config.order));
-    sdk::log_info(std::format(
-        "Config updated: points={}, series={}, order={}, multiplier={:.2f}",
+    sdk::log_info(
+        "Config updated: points={}, series={}, order={}, multiplier={:.2f}, "
+        "engine={}, threads={}, kernel={}, seed={}",
         g_config.numPoints, g_config.numSeries, g_config.order,
-        g_config.multiplier));
+        g_config.multiplier,
+        g_config.engine == Engine::Sequential ? "sequential" : "parallel",
+        g_config.threads, walk::kernel_name(g_config.kernel), g_config.seed);
+  }
+
+  if (!g_config.same_series(previous)) {
+    if (g_cache.size() > 0) {
+      sdk::log_info("Series cache cleared");
+    }
+    drop_series();
   }
 
   return updated;
 }
 
-void generate_data(std::string_view series_id) {
-  sdk::log_info(std::format("Generating data for series: {}", series_id));
-
-  // Unique seed per series to ensure different data
-  std::hash<std::string_view> hasher;
-  unsigned int series_seed = static_cast<unsigned int>(std::time(nullptr)) ^
-                             static_cast<unsigned int>(hasher(series_id));
+// Engines hand consecutive runs of interleaved (t, y) points to a sink, which
+// returns false to stop generation early.
 
-  std::mt19937 gen(series_seed);
+// Reference single-threaded walk driven by std::mt19937.
+template <typename Sink> void generate_sequential(uint64_t seed, Sink &&sink) {
+  std::mt19937 gen(static_cast<std::mt19937::result_type>(seed));
   std::normal_distribution<double> dist(0.0, 1.0);
-  std::uniform_real_distribution<double> dt_dist(0.1, 10.0);
+  std::uniform_real_distribution<double> dt_dist(walk::kDtMin, walk::kDtMax);
 
-  std::vector<double> result;
-  result.reserve((static_cast<size_t>(g_config.numPoints) + 1) * 2);
+  constexpr size_t batch_points = 4096;
+  std::vector<double> batch;
+  batch.reserve(batch_points * 2);
 
   double t = 0;
   double y = 0;
-  result.push_back(t);
-  result.push_back(y);
+  batch.push_back(t);
+  batch.push_back(y);
 
   for (int i = 0; i < g_config.numPoints; ++i) {
     double dt = dt_dist(gen);
     t += dt;
     y += dist(gen) * std::sqrt(dt) * g_config.noise;
-    result.push_back(t);
-    result.push_back(y);
+    batch.push_back(t);
+    batch.push_back(y);
+    if (batch.size() == batch_points * 2) {
+      if (!sink(std::span<const double>(batch))) {
+        return;
+      }
+      batch.clear();
+    }
   }
+  if (!batch.empty()) {
+    sink(std::span<const double>(batch));
+  }
+}
 
-  sdk::send_binary_data(result, "interleaved");
+// The parallel engine's parameters for a walk. Threads do not change its
+// output.
+walk::Params
+walk_params(uint64_t seed,
+            unsigned threads = static_cast<unsigned>(g_config.threads)) {
+  return {
+      .seed = seed,
+      .steps = static_cast<size_t>(g_config.numPoints),
+      .noise = g_config.noise,
+      .threads = threads,
+      .kernel = g_config.kernel,
+  };
 }
 
-int main(int argc, char *argv[]) {
-  // Check for --metadata flag
-  for (int i = 1; i < argc; ++i) {
-    if (std::string_view(argv[i]) == "--metadata") {
-      std::cout << R"({"name":"Random Walk Generator","patterns":[]})"
-                << std::endl;
-      return 0;
-    }
+// Threads only affect the parallel engine; its output does not depend on them.
+template <typename Sink>
+void generate_walk(uint64_t seed, Sink &&sink,
+                   unsigned threads = static_cast<unsigned>(g_config.threads)) {
+  if (g_config.engine == Engine::Sequential) {
+    generate_sequential(seed, sink);
+  } else {
+    walk::generate(walk_params(seed, threads), sink);
   }
+}
 
-  std::string line;
-  while (std::getline(std::cin, line)) {
-    if (line.empty())
-      continue;
-
-    if (line.find("\"method\":\"info\"") != std::string::npos) {
-      sdk::send_response(std::format("{{\"name\":\"{}\",\"version\":{}}}",
-                                     pluginName, pluginVersion));
-    } else if (line.find("\"method\":\"initialize\"") != std::string::npos) {
-      bool ok = show_host_form();
-      if (ok) {
-        sdk::send_response("{\"result\":\"initialized\"}");
-      } else {
-        sdk::send_response("{\"error\":\"cancelled\"}");
+// Generates the walk laid out as L into windows taken from
+// buffers.next(points), see walk::generate. The sequential engine copies its
+// batches into them.
+template <sdk::Layout L, typename Buffers, typename Sink>
+void generate_walk_into(
+    uint64_t seed, Buffers &&buffers, Sink &&sink,
+    unsigned threads = static_cast<unsigned>(g_config.threads)) {
+  if (g_config.engine == Engine::Sequential) {
+    generate_sequential(seed, [&](std::span<const double> points) {
+      sdk::Samples<L> out = buffers.next(points.size() / 2);
+      for (size_t i = 0; i < out.size(); ++i) {
+        out.set(i, points[i * 2], points[i * 2 + 1]);
       }
-    } else if (line.find("\"method\":\"get_chart_config\"") !=
-               std::string::npos) {
-      sdk::send_response("{\"result\":{\"title\":\"C++ Random "
-                         "Walk\",\"axis_labels\":[\"Time\",\"Value\"]}}");
-    } else if (line.find("\"method\":\"get_series_config\"") !=
-               std::string::npos) {
-      std::string items = "";
-      for (int i = 0; i < g_config.numSeries; ++i) {
-        if (i > 0)
-          items += ",";
-        items += std::format("{{\"id\":\"series_{}\",\"name\":\"C++ Series "
-                             "{}\"}}",
-                             i, i + 1);
+      return sink(sdk::Samples<L, const double>(out));
+    });
+  } else {
+    walk::generate<L>(walk_params(seed, threads), buffers, sink);
+  }
+}
+
+// Hands out consecutive windows of one block of points, so a walk is
+// written straight into memory the caller sends.
+template <sdk::Layout L> class SampleBuffers {
+public:
+  explicit SampleBuffers(sdk::Samples<L> out) : out_(out) {}
+
+  sdk::Samples<L> next(size_t points) {
+    sdk::Samples<L> window = out_.subspan(used_, points);
+    used_ += points;
+    return window;
+  }
+
+private:
+  sdk::Samples<L> out_;
+  size_t used_ = 0;
+};
+
+// Hands out the next points of a pyramid as generation windows.
+class PyramidBuffers {
+public:
+  explicit PyramidBuffers(sdk::SeriesPyramid &pyramid) : pyramid_(pyramid) {}
+
+  sdk::Samples<sdk::Layout::Arrays> next(size_t points) {
+    return pyramid_.extend(points);
+  }
+
+private:
+  sdk::SeriesPyramid &pyramid_;
+};
+
+// Hands out pipeline blocks as generation windows.
+template <sdk::Layout L> class PipelineBuffers {
+public:
+  explicit PipelineBuffers(sdk::WritePipeline &pipeline)
+      : pipeline_(pipeline) {}
+
+  sdk::Samples<L> next(size_t points) {
+    return sdk::Samples<L>::of(pipeline_.next(points * 2).data(), points);
+  }
+
+  // Queues a window from next() to be written.
+  void submit(const sdk::Samples<L, const double> &window) {
+    pipeline_.submit({window.xs, window.size() * 2});
+  }
+
+  // The points of a block as handed to the pipeline's consumer.
+  static sdk::Samples<L, const double> points(std::span<const double> block) {
+    return sdk::Samples<L, const double>::of(block.data(), block.size() / 2);
+  }
+
+private:
+  sdk::WritePipeline &pipeline_;
+};
+
+// The requested series id, decoded, as it is echoed back in frame headers
+std::string parse_series_id(const sdk::JsonObject &request) {
+  sdk::JsonValue id = request["series_id"];
+  return id.is_string() ? id.unescaped() : "series_0";
+}
+
+Delivery parse_delivery(const sdk::JsonObject &request,
+                        std::stop_token stop) {
+  return {
+      .storage = request["preferred_storage"].str(),
+      .shared = request["transport"].str() == "shm",
+      .dtypes = request["dtypes"].strings(),
+      .compression = sdk::choose_compression(request["compression"].strings(),
+                                             g_compression),
+      .progressive = request["progressive"].boolean().value_or(false),
+      .stop = std::move(stop),
+  };
+}
+
+// The encoding for sending x and y to the host.
+sdk::Encoding fit_encoding(const Delivery &delivery, std::span<const double> x,
+                           std::span<const double> y) {
+  sdk::Encoding encoding =
+      sdk::Encoding::fit(sdk::choose_dtype(delivery.dtypes), x, y);
+  encoding.compression = delivery.compression;
+  return encoding;
+}
+
+// The encoding for streaming points whose range is unknown until they are
+// generated, so at most f32 applies.
+sdk::Encoding stream_encoding(const Delivery &delivery) {
+  return {.dtype = sdk::choose_dtype(delivery.dtypes, false),
+          .compression = delivery.compression};
+}
+
+ViewHints parse_view_hints(const sdk::JsonObject &request) {
+  ViewHints hints;
+  if (auto width = request["pixel_width"].number()) {
+    hints.pixel_width = std::max(0, static_cast<int>(*width));
+  }
+  hints.x_min = request["x_min"].number();
+  hints.x_max = request["x_max"].number();
+  hints.start = request["start"].number<size_t>();
+  hints.end = request["end"].number<size_t>();
+  return hints;
+}
+
+// Unique seed per series to ensure different data. Uses FNV-1a rather than
+// std::hash so a seed gives the same walks on every platform and build.
+uint64_t series_seed(std::string_view series_id) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (char c : series_id) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ULL;
+  }
+  return walk::mix64(g_config.seed ^ hash);
+}
+
+size_t series_points() { return static_cast<size_t>(g_config.numPoints) + 1; }
+
+bool cacheable() {
+  return g_cache.fits(sdk::SeriesPyramid::bytes_for(series_points()));
+}
+
+// Generates a series into a new pyramid, stopping early if stop fires. The
+// walk is written straight into the pyramid's x and y columns, by threads
+// on the caller's NUMA node when it is bound to one. Safe to call from
+// worker threads as it neither logs nor touches the cache.
+sdk::SeriesPyramid build_pyramid(std::string_view series_id, unsigned threads,
+                                 std::stop_token stop) {
+  SDK_SPAN("generate");
+  sdk::SeriesPyramid pyramid;
+  pyramid.reserve(series_points());
+  PyramidBuffers buffers(pyramid);
+  generate_walk_into<sdk::Layout::Arrays>(
+      series_seed(series_id), buffers,
+      [&](const auto &) { return !stop.stop_requested(); }, threads);
+  pyramid.finish();
+  return pyramid;
+}
+
+SeriesCache::Pyramid cache_pyramid(std::string_view series_id,
+                                   sdk::SeriesPyramid pyramid) {
+  sdk::log_info("Built {}-level pyramid for {} ({} MiB)", pyramid.levels(),
+                series_id, pyramid.memory_bytes() >> 20);
+  return g_cache.insert(std::string(series_id), std::move(pyramid));
+}
+
+// Returns the cached pyramid for a series, generating it on first use, or
+// nullptr if the request is cancelled meanwhile.
+SeriesCache::Pyramid get_pyramid(std::string_view series_id,
+                                 std::stop_token stop) {
+  if (SeriesCache::Pyramid cached = g_cache.find(series_id)) {
+    return cached;
+  }
+  sdk::SeriesPyramid pyramid = build_pyramid(
+      series_id, static_cast<unsigned>(g_config.threads), stop);
+  if (stop.stop_requested()) {
+    return nullptr;
+  }
+  return cache_pyramid(series_id, std::move(pyramid));
+}
+
+// Identifies a series' contents in the spill store: everything its points
+// depend on. The kernels and thread count do not change them.
+uint64_t spill_key(std::string_view series_id) {
+  uint64_t key = series_seed(series_id);
+  key = walk::mix64(key ^ static_cast<uint64_t>(g_config.numPoints));
+  key = walk::mix64(key ^ static_cast<uint64_t>(g_config.engine));
+  return walk::mix64(key ^ std::bit_cast<uint64_t>(g_config.noise));
+}
+
+// Returns the spilled copy of a series, mapping it on first use, or nullptr
+// if it has none.
+const sdk::MappedSeries *find_spilled(std::string_view series_id) {
+  std::lock_guard lock(g_series_mutex);
+  if (auto it = g_spilled.find(series_id); it != g_spilled.end()) {
+    return &it->second;
+  }
+  if (!g_store) {
+    return nullptr;
+  }
+  uint64_t key = spill_key(series_id);
+  std::optional<sdk::MappedSeries> spilled =
+      g_store->open(std::format("{:016x}", key), key, series_points());
+  if (!spilled) {
+    return nullptr;
+  }
+  sdk::log_info("Mapped spilled copy of {}", series_id);
+  return &g_spilled.emplace(series_id, std::move(*spilled)).first->second;
+}
+
+// Starts spilling a series, making room on the disk by deleting the oldest
+// spilled series if needed. Returns nothing if there is no room.
+std::optional<sdk::MappedSeriesWriter>
+start_spill(std::string_view series_id) {
+  std::lock_guard lock(g_series_mutex);
+  if (!g_store || g_spilling.contains(series_id)) {
+    return std::nullopt;
+  }
+  size_t bytes = sdk::MappedSeriesStore::file_bytes(series_points());
+  if (!g_store->make_room(bytes)) {
+    sdk::log_warn("No disk space to spill {} ({} MiB)", series_id,
+                  bytes >> 20);
+    return std::nullopt;
+  }
+  uint64_t key = spill_key(series_id);
+  std::optional<sdk::MappedSeriesWriter> writer =
+      g_store->create(std::format("{:016x}", key), key, series_points());
+  if (writer) {
+    g_spilling.emplace(series_id);
+  }
+  return writer;
+}
+
+// Commits a spill once its series is complete, or abandons it, and lets
+// the series be spilled again.
+void finish_spill(std::string_view series_id,
+                  std::optional<sdk::MappedSeriesWriter> spill,
+                  bool complete) {
+  std::optional<sdk::MappedSeries> spilled;
+  if (complete) {
+    spilled = spill->commit();
+  }
+  spill.reset();
+
+  std::lock_guard lock(g_series_mutex);
+  if (auto it = g_spilling.find(series_id); it != g_spilling.end()) {
+    g_spilling.erase(it);
+  }
+  if (spilled) {
+    sdk::log_info("Spilled {} to disk ({} MiB)", series_id,
+                  sdk::MappedSeriesStore::file_bytes(spilled->size()) >> 20);
+    g_spilled.try_emplace(std::string(series_id), std::move(*spilled));
+  }
+}
+
+// The parallel engine can generate any range of a walk from its block
+// checkpoints; the sequential engine's walk can only be replayed from the
+// start.
+bool random_access() { return g_config.engine == Engine::Parallel; }
+
+// Returns the checkpoints of a series, computing them on first use, or
+// nullptr if the request is cancelled meanwhile.
+const walk::Checkpoints *get_checkpoints(std::string_view series_id,
+                                         std::stop_token stop) {
+  {
+    std::lock_guard lock(g_series_mutex);
+    if (auto it = g_checkpoints.find(series_id); it != g_checkpoints.end()) {
+      return &it->second;
+    }
+  }
+  SDK_SPAN("checkpoints");
+  std::optional<walk::Checkpoints> checkpoints = walk::make_checkpoints(
+      walk_params(series_seed(series_id)),
+      [&] { return !stop.stop_requested(); });
+  if (!checkpoints) {
+    return nullptr;
+  }
+  sdk::log_info("Checkpointed {} blocks of {} ({} KiB)", checkpoints->blocks(),
+                series_id, checkpoints->memory_bytes() >> 10);
+  std::lock_guard lock(g_series_mutex);
+  return &g_checkpoints.try_emplace(std::string(series_id),
+                                    std::move(*checkpoints))
+              .first->second;
+}
+
+// The index range [first, first + count) of the points a request asks for,
+// clipped to the series: all of it unless start or end is given.
+std::pair<size_t, size_t> index_range(const ViewHints &hints) {
+  size_t total = series_points();
+  size_t first = std::min(hints.start.value_or(0), total);
+  size_t end = std::clamp(hints.end.value_or(total), first, total);
+  return {first, end - first};
+}
+
+// Hands points [first, first + count) of a series to sink as interleaved
+// runs until it returns false. With random access only the blocks holding
+// them are generated; otherwise the walk is replayed up to the end of the
+// range. Returns false if the request is cancelled.
+template <typename Sink>
+bool walk_range(std::string_view series_id, size_t first, size_t count,
+                std::stop_token stop, Sink &&sink) {
+  uint64_t seed = series_seed(series_id);
+  if (random_access() && (first > 0 || count < series_points())) {
+    const walk::Checkpoints *checkpoints = get_checkpoints(series_id, stop);
+    if (checkpoints == nullptr) {
+      return false;
+    }
+    walk::generate_range(walk_params(seed), *checkpoints, first, count,
+                         [&](std::span<const double> points) {
+                           return sink(points) && !stop.stop_requested();
+                         });
+    return !stop.stop_requested();
+  }
+
+  size_t end = first + count;
+  size_t index = 0;
+  generate_walk(seed, [&](std::span<const double> points) {
+    size_t next = index + points.size() / 2;
+    size_t begin = std::clamp(first, index, next);
+    size_t until = std::clamp(end, index, next);
+    bool more = begin == until ||
+                sink(points.subspan((begin - index) * 2, (until - begin) * 2));
+    index = next;
+    return more && index < end && !stop.stop_requested();
+  });
+  return !stop.stop_requested();
+}
+
+// Generates the requested part of the walk and keeps only its M4-significant
+// points for the view. With random access and an x range, only the blocks
+// around the range are generated.
+sdk::M4Decimator decimate_walk(std::string_view series_id,
+                               const ViewHints &hints, std::stop_token stop) {
+  SDK_SPAN("decimate");
+  auto buckets = static_cast<size_t>(hints.pixel_width);
+  auto [first, count] = index_range(hints);
+  bool by_x = hints.x_min && hints.x_max;
+  sdk::M4Decimator decimator =
+      by_x ? sdk::M4Decimator(buckets, *hints.x_min, *hints.x_max)
+           : sdk::M4Decimator::by_index(buckets, count);
+
+  if (by_x && random_access()) {
+    const walk::Checkpoints *checkpoints = get_checkpoints(series_id, stop);
+    if (checkpoints == nullptr) {
+      return decimator;
+    }
+    auto [begin, end] = checkpoints->points_around(*hints.x_min, *hints.x_max);
+    first = begin;
+    count = end - begin;
+  }
+  walk_range(series_id, first, count, stop,
+             [&](std::span<const double> points) {
+               return decimator.push(points);
+             });
+  decimator.finish();
+  return decimator;
+}
+
+// Reduces a series held in memory to the view, reading only the points
+// around its x or index range.
+sdk::M4Decimator decimate_points(std::span<const double> x,
+                                 std::span<const double> y,
+                                 const ViewHints &hints) {
+  SDK_SPAN("decimate");
+  auto buckets = static_cast<size_t>(hints.pixel_width);
+  if (hints.x_min && hints.x_max) {
+    // x never decreases, so start from the last point left of the view
+    auto from = std::ranges::lower_bound(x, *hints.x_min);
+    size_t first = static_cast<size_t>(std::max<std::ptrdiff_t>(
+        from - x.begin() - 1, 0));
+    sdk::M4Decimator decimator(buckets, *hints.x_min, *hints.x_max);
+    for (size_t i = first; i < x.size() && decimator.push(x[i], y[i]); ++i) {
+    }
+    decimator.finish();
+    return decimator;
+  }
+
+  auto [first, count] = index_range(hints);
+  sdk::M4Decimator decimator = sdk::M4Decimator::by_index(buckets, count);
+  for (size_t i = first; i < first + count; ++i) {
+    decimator.push(x[i], y[i]);
+  }
+  decimator.finish();
+  return decimator;
+}
+
+void send_decimated(const sdk::M4Decimator &decimator,
+                    const Delivery &delivery, int pixel_width) {
+  sdk::log_info("Decimated to {} points for {} px", decimator.size(),
+                pixel_width);
+
+  sdk::Encoding encoding = fit_encoding(delivery, decimator.x(), decimator.y());
+  sdk::send_encoded_data(decimator.x(), decimator.y(), delivery.storage,
+                         encoding);
+}
+
+// Sends the series reduced to the view, answered from the series' pyramid
+// when it is small enough to cache, or from its spilled copy if it has one.
+void send_view(std::string_view series_id, const Delivery &delivery,
+               const ViewHints &hints) {
+  auto width = static_cast<size_t>(hints.pixel_width);
+  std::optional<sdk::M4Decimator> decimator = [&] {
+    if (!cacheable()) {
+      if (const sdk::MappedSeries *spilled = find_spilled(series_id)) {
+        return std::optional(
+            decimate_points(spilled->x(), spilled->y(), hints));
       }
-      sdk::send_response(std::format("{{\"result\":[{}]}}", items));
-    } else if (line.find("\"method\":\"get_series_data\"") !=
-               std::string::npos) {
-      std::string_view line_view = line;
-      std::string_view sid = "series_0";
-      size_t pos = line_view.find("\"series_id\":\"");
-      if (pos != std::string_view::npos) {
-        size_t start = pos + 13;
-        size_t end = line_view.find("\"", start);
-        if (end != std::string_view::npos) {
-          sid = line_view.substr(start, end - start);
+      return std::optional(decimate_walk(series_id, hints, delivery.stop));
+    }
+    SeriesCache::Pyramid pyramid = get_pyramid(series_id, delivery.stop);
+    if (pyramid == nullptr) {
+      return std::optional<sdk::M4Decimator>();
+    }
+    if (hints.x_min && hints.x_max) {
+      return std::optional(pyramid->query(*hints.x_min, *hints.x_max, width));
+    }
+    return std::optional(pyramid->query(width));
+  }();
+  if (delivery.stop.stop_requested()) {
+    sdk::send_cancelled();
+    return;
+  }
+  send_decimated(*decimator, delivery, hints.pixel_width);
+}
+
+// Sends points [start, end) of a series, reduced to pixel_width columns if
+// given. They are sliced from the cached or spilled series if there is one
+// and otherwise generated on their own, so the rest of the series is never
+// generated or stored.
+void send_index_range(std::string_view series_id, const Delivery &delivery,
+                      const ViewHints &hints) {
+  auto [first, count] = index_range(hints);
+  auto width = static_cast<size_t>(hints.pixel_width);
+
+  std::optional<std::pair<std::span<const double>, std::span<const double>>>
+      stored;
+  SeriesCache::Pyramid cached = g_cache.find(series_id);
+  if (cached) {
+    stored.emplace(cached->x(), cached->y());
+  } else if (const sdk::MappedSeries *spilled = find_spilled(series_id)) {
+    stored.emplace(spilled->x(), spilled->y());
+  }
+  if (stored) {
+    auto [x, y] = *stored;
+    if (width > 0) {
+      send_decimated(decimate_points(x, y, hints), delivery,
+                     hints.pixel_width);
+      return;
+    }
+    std::span<const double> xs = x.subspan(first, count);
+    std::span<const double> ys = y.subspan(first, count);
+    sdk::send_encoded_data(xs, ys, delivery.storage,
+                           fit_encoding(delivery, xs, ys));
+    return;
+  }
+
+  if (width > 0) {
+    sdk::M4Decimator decimator = decimate_walk(series_id, hints, delivery.stop);
+    if (delivery.stop.stop_requested()) {
+      sdk::send_cancelled();
+      return;
+    }
+    send_decimated(decimator, delivery, hints.pixel_width);
+    return;
+  }
+
+  sdk::Layout layout = sdk::parse_layout(delivery.storage);
+  sdk::ChunkedWriter writer(sdk::layout_name(layout), count,
+                            sdk::kDefaultChunkPoints, {},
+                            stream_encoding(delivery));
+  if (!walk_range(series_id, first, count, delivery.stop,
+                  [&](std::span<const double> points) {
+                    writer.write(points);
+                    return true;
+                  })) {
+    writer.abort("cancelled");
+  }
+}
+
+// Pixel columns of the first preview of a progressive response; each further
+// preview has 16 times as many, while it stays well below the full series.
+constexpr size_t kPreviewColumns = 1024;
+
+void send_preview(const sdk::M4Decimator &preview, const Delivery &delivery,
+                  std::string_view series_id) {
+  sdk::Encoding encoding = fit_encoding(delivery, preview.x(), preview.y());
+  sdk::send_preview(preview.x(), preview.y(), delivery.storage, encoding,
+                    series_id);
+}
+
+// Sends coarse-to-fine previews of a series ahead of its full data.
+void send_previews(const sdk::SeriesPyramid &pyramid, const Delivery &delivery,
+                   std::string_view series_id) {
+  for (size_t columns = kPreviewColumns; columns * 4 * 16 <= pyramid.size();
+       columns *= 16) {
+    send_preview(pyramid.query(columns), delivery, series_id);
+  }
+}
+
+// Sends a whole series from memory, through shared memory if the host asked
+// for it. A series_id tags it as a batch frame.
+void send_points(std::span<const double> x, std::span<const double> y,
+                 const Delivery &delivery, std::string_view series_id = {}) {
+  if (delivery.shared &&
+      sdk::send_shared_data(x, y, delivery.storage, series_id)) {
+    return;
+  }
+
+  sdk::Encoding encoding = fit_encoding(delivery, x, y);
+  if (delivery.storage == "arrays" && encoding.plain()) {
+    sdk::send_binary_data(x, y, series_id);
+    return;
+  }
+  sdk::ChunkedWriter writer(
+      delivery.storage == "arrays" ? "arrays" : "interleaved", x.size(),
+      sdk::kDefaultChunkPoints, series_id, encoding);
+  writer.write(x, y);
+}
+
+// Sends a cached series, preceded by previews if the host wants them.
+void send_series(const sdk::SeriesPyramid &pyramid, const Delivery &delivery,
+                 std::string_view series_id = {}) {
+  if (delivery.progressive) {
+    send_previews(pyramid, delivery, series_id);
+  }
+  send_points(pyramid.x(), pyramid.y(), delivery, series_id);
+}
+
+// Generates a series laid out as L and streams it chunk by chunk, or writes
+// it straight into shared memory if the host asked for it. Streamed windows
+// go through a pipeline, so the next window is generated while the last is
+// written to the pipe. Builds the series' pyramid on the way, or spills a
+// series too large for it to disk, so repeat requests and zooms are
+// answered without regenerating it, and summarises it for
+// get_series_summary. A cancelled stream ends with an error frame and
+// nothing is kept.
+template <sdk::Layout L>
+void stream_walk(std::string_view series_id, const Delivery &delivery,
+                 std::string_view tag) {
+  SDK_SPAN("stream");
+  bool build = cacheable();
+  sdk::SeriesPyramid pyramid;
+  sdk::SeriesSummary summary;
+  std::optional<sdk::MappedSeriesWriter> spill;
+  if (build) {
+    pyramid.reserve(series_points());
+  } else {
+    spill = start_spill(series_id);
+  }
+
+  auto generate = [&](auto &&buffers, auto &&write) {
+    generate_walk_into<L>(series_seed(series_id), buffers,
+                          [&](sdk::Samples<L, const double> points) {
+                            if (build) {
+                              pyramid.push(points);
+                            } else {
+                              summary.add(points);
+                              if (spill) {
+                                spill->append(points);
+                              }
+                            }
+                            write(points);
+                            return !delivery.stop.stop_requested();
+                          });
+  };
+
+  std::optional<sdk::SharedRegion> region;
+  if (delivery.shared) {
+    region.emplace(series_points() * 2 * sizeof(double));
+  }
+  if (region && region->valid()) {
+    sdk::Samples<L> out =
+        sdk::Samples<L>::of(region->doubles().data(), series_points());
+    generate(SampleBuffers<L>(out), [](const auto &) {});
+    if (delivery.stop.stop_requested()) {
+      sdk::send_cancelled(tag);
+    } else {
+      sdk::send_shared_data(std::move(*region), sdk::layout_name(L), tag);
+    }
+  } else {
+    sdk::ChunkedWriter writer(sdk::layout_name(L), series_points(),
+                              sdk::kDefaultChunkPoints, tag,
+                              stream_encoding(delivery));
+    sdk::WritePipeline pipeline([&](std::span<const double> block) {
+      writer.write(PipelineBuffers<L>::points(block));
+    });
+    PipelineBuffers<L> buffers(pipeline);
+    generate(buffers, [&](const sdk::Samples<L, const double> &points) {
+      buffers.submit(points);
+    });
+    if (delivery.stop.stop_requested()) {
+      pipeline.discard();
+    }
+    pipeline.finish();
+    if (delivery.stop.stop_requested()) {
+      writer.abort("cancelled");
+    }
+  }
+
+  bool complete = !delivery.stop.stop_requested();
+  if (spill) {
+    finish_spill(series_id, std::move(spill), complete);
+  }
+  if (!complete) {
+    return;
+  }
+  if (build) {
+    pyramid.finish();
+    cache_pyramid(series_id, std::move(pyramid));
+    return;
+  }
+  std::lock_guard lock(g_series_mutex);
+  g_summaries.insert_or_assign(std::string(series_id), summary);
+}
+
+// Streams a series in the layout the host prefers, so it needs no
+// conversion on arrival. When the host wants previews, a first pass over
+// the walk yields one before the much longer full transfer starts.
+void stream_series(std::string_view series_id, const Delivery &delivery,
+                   std::string_view tag = {}) {
+  if (delivery.progressive) {
+    ViewHints hints;
+    hints.pixel_width = static_cast<int>(kPreviewColumns);
+    sdk::M4Decimator preview = decimate_walk(series_id, hints, delivery.stop);
+    if (!delivery.stop.stop_requested()) {
+      send_preview(preview, delivery, tag);
+    }
+  }
+
+  sdk::with_layout(sdk::parse_layout(delivery.storage), [&](auto layout) {
+    stream_walk<decltype(layout)::value>(series_id, delivery, tag);
+  });
+}
+
+void generate_data(std::string_view series_id, const Delivery &delivery,
+                   const ViewHints &hints) {
+  sdk::log_info("Generating data for series: {}", series_id);
+
+  if (hints.pixel_width > 0) {
+    send_view(series_id, delivery, hints);
+    return;
+  }
+
+  if (SeriesCache::Pyramid cached = g_cache.find(series_id)) {
+    sdk::log_info("Serving {} from cache", series_id);
+    send_series(*cached, delivery);
+    return;
+  }
+  if (const sdk::MappedSeries *spilled = find_spilled(series_id)) {
+    sdk::log_info("Serving {} from disk", series_id);
+    send_points(spilled->x(), spilled->y(), delivery);
+    return;
+  }
+  if (delivery.progressive && cacheable()) {
+    // Previews come from the pyramid, so build it before sending anything
+    if (SeriesCache::Pyramid pyramid = get_pyramid(series_id, delivery.stop)) {
+      send_series(*pyramid, delivery);
+    } else {
+      sdk::send_cancelled();
+    }
+    return;
+  }
+  stream_series(series_id, delivery);
+}
+
+// Answers get_series_data_batch. Cached and spilled series are sent straight
+// away and series too large to cache are streamed one by one; the rest are
+// generated concurrently, sharing the thread budget, and sent as each
+// completes. Once cancelled, every series not yet sent is answered with an
+// error frame.
+void get_series_data_batch(std::span<const std::string> ids,
+                           const Delivery &delivery) {
+  sdk::log_info("Generating batch of {} series", ids.size());
+  sdk::send_batch_header(ids.size());
+
+  const std::stop_token &stop = delivery.stop;
+  std::vector<std::string_view> pending;
+  for (std::string_view id : ids) {
+    if (stop.stop_requested()) {
+      sdk::send_cancelled(id);
+    } else if (SeriesCache::Pyramid cached = g_cache.find(id)) {
+      send_series(*cached, delivery, id);
+    } else if (const sdk::MappedSeries *spilled = find_spilled(id)) {
+      send_points(spilled->x(), spilled->y(), delivery, id);
+    } else if (!cacheable()) {
+      stream_series(id, delivery, id);
+    } else {
+      pending.push_back(id);
+    }
+  }
+
+  unsigned threads = walk::resolve_threads(g_config.threads);
+  auto workers = static_cast<unsigned>(
+      std::clamp<size_t>(pending.size(), 1, threads));
+  sdk::run_batch(
+      pending.size(), workers,
+      [&](size_t i) {
+        return build_pyramid(pending[i], threads / workers, stop);
+      },
+      [&](size_t i, sdk::SeriesPyramid pyramid) {
+        if (stop.stop_requested()) {
+          sdk::send_cancelled(pending[i]);
+          return;
         }
-      }
-      generate_data(sid);
+        send_series(*cache_pyramid(pending[i], std::move(pyramid)), delivery,
+                    pending[i]);
+      });
+}
+
+// Answers get_series_range for an index range [start, end), or for an x
+// range reduced to pixel_width columns.
+void get_series_range(std::string_view series_id, const Delivery &delivery,
+                      const ViewHints &hints) {
+  if (hints.start || hints.end) {
+    send_index_range(series_id, delivery, hints);
+    return;
+  }
+  if (hints.pixel_width <= 0 || !hints.x_min || !hints.x_max) {
+    sdk::send_response("{\"error\":\"get_series_range needs start and end, "
+                       "or x_min, x_max and pixel_width\"}");
+    return;
+  }
+  send_view(series_id, delivery, hints);
+}
+
+// Returns the summary of a series, or nothing if the request is cancelled
+// meanwhile. Series streamed or cached before have one already; spilled
+// series are summarised from disk, and the rest are generated for it, into
+// the cache if they fit.
+std::optional<sdk::SeriesSummary> find_summary(std::string_view series_id,
+                                               std::stop_token stop) {
+  if (SeriesCache::Pyramid cached = g_cache.find(series_id)) {
+    return cached->summary();
+  }
+  {
+    std::lock_guard lock(g_series_mutex);
+    if (auto it = g_summaries.find(series_id); it != g_summaries.end()) {
+      return it->second;
     }
   }
-  return 0;
+  if (cacheable()) {
+    SeriesCache::Pyramid pyramid = get_pyramid(series_id, stop);
+    if (pyramid == nullptr) {
+      return std::nullopt;
+    }
+    return pyramid->summary();
+  }
+
+  SDK_SPAN("summarize");
+  sdk::SeriesSummary summary;
+  if (const sdk::MappedSeries *spilled = find_spilled(series_id)) {
+    summary.add(sdk::Samples<sdk::Layout::Arrays, const double>{
+        spilled->x().data(), spilled->y().data(), spilled->size()});
+  } else if (!walk_range(series_id, 0, series_points(), stop,
+                         [&](std::span<const double> points) {
+                           summary.add(points);
+                           return true;
+                         })) {
+    return std::nullopt;
+  }
+  std::lock_guard lock(g_series_mutex);
+  g_summaries.insert_or_assign(std::string(series_id), summary);
+  return summary;
 }
+
+// Answers get_series_summary with a series' count, x and y ranges and the
+// mean and variance of y, so the host can set up its axes before fetching
+// any data.
+void get_series_summary(std::string_view series_id, std::stop_token stop) {
+  std::optional<sdk::SeriesSummary> summary = find_summary(series_id, stop);
+  if (!summary) {
+    sdk::send_cancelled();
+    return;
+  }
+  sdk::send_response("{{\"result\":{}}}", summary->json());
+}
+
+// Points a second a live series grows by unless subscribe_series asks for
+// another rate.
+constexpr double kDefaultLiveRate = 1e6;
+
+// Live series are extended this often, and give up on points more than
+// kLiveMaxLag seconds overdue rather than bursting to catch up with them.
+constexpr auto kLiveTick = std::chrono::milliseconds(10);
+constexpr double kLiveMaxLag = 0.25;
+
+// Where a live series continues from. The parallel engine's walks go on
+// with the very steps a longer walk would have taken; the sequential
+// engine's continue from their last point with the parallel engine's
+// streams for the blocks after it. Returns nothing if the request is
+// cancelled meanwhile.
+std::optional<walk::Extension> live_extension(std::string_view series_id,
+                                              std::stop_token stop) {
+  walk::Params params = walk_params(series_seed(series_id));
+  if (random_access()) {
+    const walk::Checkpoints *checkpoints = get_checkpoints(series_id, stop);
+    if (checkpoints == nullptr) {
+      return std::nullopt;
+    }
+    return walk::Extension(
+        params, params.steps,
+        checkpoints->start(params.steps / walk::kBlockSteps));
+  }
+
+  std::optional<walk::BlockTotals> last;
+  if (SeriesCache::Pyramid cached = g_cache.find(series_id)) {
+    last = walk::BlockTotals{cached->x().back(), cached->y().back()};
+  } else if (const sdk::MappedSeries *spilled = find_spilled(series_id)) {
+    last = walk::BlockTotals{spilled->x().back(), spilled->y().back()};
+  } else if (!walk_range(series_id, params.steps, 1, stop,
+                         [&](std::span<const double> point) {
+                           last = walk::BlockTotals{point[0], point[1]};
+                           return true;
+                         })) {
+    return std::nullopt;
+  }
+  size_t next_block = walk::block_count(params);
+  return walk::Extension(params, next_block * walk::kBlockSteps, *last);
+}
+
+// Extends a live series by `rate` points a second until stop fires, then
+// ends it. Points are generated straight into the writer's buffer, which
+// sends them as coalesced append frames of at most its max_points.
+void run_live(std::string series_id, walk::Extension extension, double rate,
+              std::string storage, sdk::DType dtype, std::stop_token stop) {
+  using Clock = std::chrono::steady_clock;
+  sdk::AppendWriter writer(std::move(series_id), storage, dtype);
+  auto max_lag = std::max<uint64_t>(static_cast<uint64_t>(rate * kLiveMaxLag),
+                                    1);
+  Clock::time_point begin = Clock::now();
+  uint64_t produced = 0;
+  while (!stop.stop_requested()) {
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    auto due = static_cast<uint64_t>(rate * elapsed.count());
+    produced = std::max(produced, due > max_lag ? due - max_lag : 0);
+    // In frame-sized pieces, so a backlog is not sent as one huge frame
+    do {
+      auto points = static_cast<size_t>(std::min<uint64_t>(
+          due - produced, writer.max_points() - writer.size()));
+      extension.next(writer.extend(points));
+      produced += points;
+      writer.poll();
+    } while (produced < due && !stop.stop_requested());
+    std::this_thread::sleep_for(kLiveTick);
+  }
+}
+
+// Answers subscribe_series: starts extending a series at the requested
+// rate, continuing from its last point, and replies with the number of
+// points it had. Later appends are sent laid out as preferred_storage.
+void subscribe_series(std::string_view series_id,
+                      const sdk::JsonObject &request, const Delivery &delivery,
+                      sdk::LiveFeeds &live) {
+  double rate = request["rate"].number().value_or(kDefaultLiveRate);
+  if (!(rate > 0)) {
+    sdk::send_response("{\"error\":\"rate must be positive\"}");
+    return;
+  }
+  std::optional<walk::Extension> extension =
+      live_extension(series_id, delivery.stop);
+  if (!extension) {
+    sdk::send_cancelled();
+    return;
+  }
+  sdk::send_response(
+      "{{\"result\":{{\"series_id\":{},\"points\":{},\"rate\":{}}}}}",
+      sdk::json_quoted(series_id), series_points(), rate);
+  sdk::log_info("Live: {} at {} points/s", series_id, rate);
+
+  live.start(std::string(series_id),
+             [id = std::string(series_id), extension = std::move(*extension),
+              rate, storage = std::string(delivery.storage),
+              dtype = sdk::choose_dtype(delivery.dtypes)](
+                 std::stop_token stop) mutable {
+               run_live(std::move(id), std::move(extension), rate, storage,
+                        dtype, std::move(stop));
+             });
+}
+
+int main(int argc, char *argv[]) {
+  std::error_code no_temp;
+  std::filesystem::path spill_dir =
+      std::filesystem::temp_directory_path(no_temp);
+  if (!spill_dir.empty()) {
+    spill_dir = spill_dir / "olicanaplot" / "random_walk";
+  }
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--metadata") {
+      sdk::send_response(sdk::minified_json<metadata>);
+      return 0;
+    }
+    // --trace <file> writes a Chrome trace of the session's spans at exit
+    if (arg == "--trace" && i + 1 < argc) {
+      sdk::metrics().start_trace(argv[++i]);
+    }
+    // --large-pages backs the generation buffers with large pages if it can
+    if (arg == "--large-pages" && !sdk::output_arena().use_large_pages(true)) {
+      sdk::log_warn("Large pages are unavailable, using normal pages");
+    }
+    // --spill-dir <dir> keeps spilled series there; --no-spill turns it off
+    if (arg == "--spill-dir" && i + 1 < argc) {
+      spill_dir = argv[++i];
+    }
+    if (arg == "--no-spill") {
+      spill_dir.clear();
+    }
+    // --compression lz4|lz4-high compresses payloads for hosts that accept
+    // it, e.g. across a slow remote or sandbox pipe
+    if (arg == "--compression" && i + 1 < argc) {
+      std::string_view level = argv[++i];
+      g_compression = level == "lz4"        ? sdk::Compression::Lz4
+                      : level == "lz4-high" ? sdk::Compression::Lz4High
+                                            : sdk::Compression::None;
+    }
+  }
+  if (!spill_dir.empty()) {
+    g_store.emplace(spill_dir);
+    if (!g_store->prepare()) {
+      sdk::log_warn("Cannot use {} for spilled series", spill_dir.string());
+      g_store.reset();
+    }
+  }
+
+  // Live series are extended on threads of their own. Declared first, so
+  // they stop only after the runtime has finished its last request.
+  sdk::LiveFeeds live;
+
+  // Data requests run on workers so cancel and info are answered while a
+  // series is generated. With a host that tags its requests with ids, a
+  // second worker answers views of cached series while a long one streams.
+  sdk::PluginRuntime runtime(kMethods, 2);
+
+  runtime.on(Method::Info, sdk::Run::Inline, [](auto &, auto) {
+    sdk::send_response(sdk::info_response<pluginName, pluginVersion>);
+  });
+  runtime.on(Method::Initialize, sdk::Run::Exclusive, [&](auto &, auto) {
+    Config previous = g_config;
+    bool updated = show_host_form();
+    // Live series continue walks of the old configuration
+    if (!g_config.same_series(previous)) {
+      live.stop_all();
+    }
+    if (updated) {
+      sdk::send_response("{\"result\":\"initialized\"}");
+    } else {
+      sdk::send_response("{\"error\":\"cancelled\"}");
+    }
+  });
+  // A pooled process is reused as if newly started: default configuration,
+  // no live series and nothing cached
+  runtime.on_reset([&] {
+    live.stop_all();
+    g_config = Config{};
+    drop_series();
+  });
+  runtime.on(Method::GetChartConfig, sdk::Run::Inline, [](auto &, auto) {
+    sdk::send_response("{\"result\":{\"title\":\"C++ Random "
+                       "Walk\",\"axis_labels\":[\"Time\",\"Value\"]}}");
+  });
+  runtime.on(Method::GetSeriesConfig, sdk::Run::Inline, [](auto &, auto) {
+    std::string items = "";
+    for (int i = 0; i < g_config.numSeries; ++i) {
+      if (i > 0)
+        items += ",";
+      items += std::format("{{\"id\":\"series_{}\",\"name\":\"C++ Series "
+                           "{}\"}}",
+                           i, i + 1);
+    }
+    sdk::send_response("{{\"result\":[{}]}}", items);
+  });
+  runtime.on(Method::GetSeriesData, sdk::Run::Worker,
+             [](const sdk::JsonObject &request, std::stop_token stop) {
+               generate_data(parse_series_id(request),
+                             parse_delivery(request, std::move(stop)),
+                             parse_view_hints(request));
+             });
+  runtime.on(Method::GetSeriesRange, sdk::Run::Worker,
+             [](const sdk::JsonObject &request, std::stop_token stop) {
+               get_series_range(parse_series_id(request),
+                                parse_delivery(request, std::move(stop)),
+                                parse_view_hints(request));
+             });
+  runtime.on(Method::GetSeriesDataBatch, sdk::Run::Worker,
+             [](const sdk::JsonObject &request, std::stop_token stop) {
+               get_series_data_batch(request["series_ids"].unescaped_strings(),
+                                     parse_delivery(request, std::move(stop)));
+             });
+  runtime.on(Method::SubscribeSeries, sdk::Run::Worker,
+             [&](const sdk::JsonObject &request, std::stop_token stop) {
+               subscribe_series(parse_series_id(request), request,
+                                parse_delivery(request, std::move(stop)),
+                                live);
+             });
+  runtime.on(Method::GetSeriesSummary, sdk::Run::Worker,
+             [](const sdk::JsonObject &request, std::stop_token stop) {
+               get_series_summary(parse_series_id(request), std::move(stop));
+             });
+  // Stopping a feed waits for its final frame, which takes one tick at most
+  runtime.on(Method::UnsubscribeSeries, sdk::Run::Inline,
+             [&](const sdk::JsonObject &request, auto) {
+               std::string series_id = parse_series_id(request);
+               if (live.stop(series_id)) {
+                 sdk::send_response("{\"result\":\"unsubscribed\"}");
+               } else {
+                 sdk::send_response(
+                     "{{\"error\":{}}}",
+                     sdk::json_quoted(
+                         std::format("{} is not live", series_id)));
+               }
+             });
+
+  return runtime.run();
+}
\ No newline at end of file
@@ -0,0 +1,627 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <span>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define WALK_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX instructions inside functions that opt in to
+// the instruction set; MSVC accepts intrinsics anywhere.
+#if defined(WALK_X86) && (defined(__GNUC__) || defined(__clang__))
+#define WALK_TARGET(isa) __attribute__((target(isa)))
+#else
+#define WALK_TARGET(isa)
+#endif
+
+// Bit-identical kernels rely on every multiply and add rounding separately,
+// so keep the compiler from contracting them into FMAs (GCC does so by
+// default whenever the target has FMA, including the AVX-512 kernel).
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+// Sampling kernels for the random walk: uniform time steps and Gaussian
+// increments drawn from a counter-based RNG.
+//
+// Samples are produced in groups of 16 steps. Step j of a group draws its
+// time step from counter 2j and a uniform from counter 2j + 1. The uniforms
+// of steps 0-7 and 8-15 form eight Box-Muller pairs: pair j sets the normal of
+// step j from the cosine and of step 8 + j from the sine. Every kernel
+// evaluates the same log/sincos polynomials in the same operation order, so
+// the scalar, AVX2 and AVX-512 kernels produce bit-identical samples and a
+// seed yields the same walk on every machine.
+namespace walk {
+
+inline constexpr double kDtMin = 0.1;
+inline constexpr double kDtMax = 10.0;
+
+inline constexpr size_t kGroupSteps = 16;
+inline constexpr size_t kGroupPairs = kGroupSteps / 2;
+
+// SplitMix64 finalizer: a fast bijective 64-bit mixer.
+constexpr uint64_t mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// CounterRng returns the n-th value of a stream as a pure function of
+// (key, n), with no state carried between draws.
+class CounterRng {
+public:
+  static constexpr uint64_t kGamma = 0x9E3779B97F4A7C15ULL;
+
+  constexpr CounterRng(uint64_t seed, uint64_t stream)
+      : key_(mix64(seed ^ mix64((stream + 1) * kGamma))) {}
+
+  constexpr uint64_t operator()(uint64_t counter) const {
+    return mix64(key_ + counter * kGamma);
+  }
+
+  constexpr uint64_t key() const { return key_; }
+
+private:
+  uint64_t key_;
+};
+
+enum class Kernel { Scalar, Avx2, Avx512 };
+
+constexpr std::string_view kernel_name(Kernel kernel) {
+  switch (kernel) {
+  case Kernel::Avx512:
+    return "avx512";
+  case Kernel::Avx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+namespace detail {
+
+inline constexpr uint64_t kOneBits = 0x3FF0000000000000ULL;
+inline constexpr uint64_t kMantissaMask = 0x000FFFFFFFFFFFFFULL;
+inline constexpr uint64_t kMagicBits = 0x4330000000000000ULL; // 2^52
+inline constexpr double kMagic = 0x1.0p52;
+
+inline constexpr double kDtSpan = kDtMax - kDtMin;
+inline constexpr double kTwoPi = 2.0 * std::numbers::pi;
+
+// fdlibm log: reduction constants and minimax coefficients
+inline constexpr double kSqrt2 = 1.41421356237309514547;
+inline constexpr double kLn2Hi = 6.93147180369123816490e-01;
+inline constexpr double kLn2Lo = 1.90821492927058770002e-10;
+inline constexpr double kLg1 = 6.666666666666735130e-01;
+inline constexpr double kLg2 = 3.999999999940941908e-01;
+inline constexpr double kLg3 = 2.857142874366239149e-01;
+inline constexpr double kLg4 = 2.222219843214978396e-01;
+inline constexpr double kLg5 = 1.818357216161805012e-01;
+inline constexpr double kLg6 = 1.531383769920937332e-01;
+inline constexpr double kLg7 = 1.479819860511658591e-01;
+
+// fdlibm sin/cos kernels on [-pi/4, pi/4]
+inline constexpr double kS1 = -1.66666666666666324348e-01;
+inline constexpr double kS2 = 8.33333333332248946124e-03;
+inline constexpr double kS3 = -1.98412698298579493134e-04;
+inline constexpr double kS4 = 2.75573137070700676789e-06;
+inline constexpr double kS5 = -2.50507602534068634195e-08;
+inline constexpr double kS6 = 1.58969099521155010221e-10;
+inline constexpr double kC1 = 4.16666666666666019037e-02;
+inline constexpr double kC2 = -1.38888888888741095749e-03;
+inline constexpr double kC3 = 2.48015872894767294178e-05;
+inline constexpr double kC4 = -2.75573143513906633035e-07;
+inline constexpr double kC5 = 2.08757232129817482790e-09;
+inline constexpr double kC6 = -1.13596475577881948265e-11;
+
+// Maps 64 random bits to [0, 1) with 52 bits of resolution.
+inline double unit(uint64_t bits) {
+  return std::bit_cast<double>((bits >> 12) | kOneBits) - 1.0;
+}
+
+// Natural log for x in [2^-52, 1].
+inline double log_unit(double x) {
+  uint64_t bits = std::bit_cast<uint64_t>(x);
+  double k = (std::bit_cast<double>((bits >> 52) | kMagicBits) - kMagic) -
+             1023.0;
+  double m = std::bit_cast<double>((bits & kMantissaMask) | kOneBits);
+  if (m > kSqrt2) {
+    m = m * 0.5;
+    k = k + 1.0;
+  }
+  double f = m - 1.0;
+  double s = f / (2.0 + f);
+  double z = s * s;
+  double w = z * z;
+  double t1 = w * (kLg2 + w * (kLg4 + w * kLg6));
+  double t2 = z * (kLg1 + w * (kLg3 + w * (kLg5 + w * kLg7)));
+  double r = t2 + t1;
+  double hfsq = 0.5 * f * f;
+  return k * kLn2Hi - ((hfsq - (s * (hfsq + r) + k * kLn2Lo)) - f);
+}
+
+// sin(2 pi u) and cos(2 pi u) for u in [0, 1).
+inline void sincos_turns(double u, double &sin_out, double &cos_out) {
+  double t = u * 4.0 + kMagic; // rounds u * 4 to the nearest quadrant
+  double q = t - kMagic;
+  double x = (u - q * 0.25) * kTwoPi;
+  double z = x * x;
+  double sr = kS2 + z * (kS3 + z * (kS4 + z * (kS5 + z * kS6)));
+  double sn = x + x * z * (kS1 + z * sr);
+  double cr = kC1 + z * (kC2 + z * (kC3 + z * (kC4 + z * (kC5 + z * kC6))));
+  double cs = 1.0 - (0.5 * z - z * z * cr);
+
+  uint64_t quadrant = std::bit_cast<uint64_t>(t);
+  if (quadrant & 1) {
+    std::swap(sn, cs);
+  }
+  sin_out = std::bit_cast<double>(std::bit_cast<uint64_t>(sn) ^
+                                  ((quadrant & 2) << 62));
+  cos_out = std::bit_cast<double>(std::bit_cast<uint64_t>(cs) ^
+                                  (((quadrant + 1) & 2) << 62));
+}
+
+// Fills one group of 16 steps starting at block step k0.
+inline void fill_group_scalar(const CounterRng &rng, uint64_t k0,
+                              double noise, double *dt, double *dy) {
+  for (size_t j = 0; j < kGroupSteps; ++j) {
+    dt[j] = kDtMin + kDtSpan * unit(rng(2 * (k0 + j)));
+  }
+  for (size_t j = 0; j < kGroupPairs; ++j) {
+    double u1 = 1.0 - unit(rng(2 * (k0 + j) + 1));
+    double u2 = unit(rng(2 * (k0 + kGroupPairs + j) + 1));
+    double r = std::sqrt(-2.0 * log_unit(u1));
+    double sn, cs;
+    sincos_turns(u2, sn, cs);
+    dy[j] = r * cs * std::sqrt(dt[j]) * noise;
+    dy[kGroupPairs + j] = r * sn * std::sqrt(dt[kGroupPairs + j]) * noise;
+  }
+}
+
+inline void fill_groups_scalar(const CounterRng &rng, size_t groups,
+                               double noise, double *dt, double *dy) {
+  for (size_t g = 0; g < groups; ++g) {
+    size_t k0 = g * kGroupSteps;
+    fill_group_scalar(rng, k0, noise, dt + k0, dy + k0);
+  }
+}
+
+#ifdef WALK_X86
+
+// --- AVX2: four lanes, two half-groups per group ---
+
+WALK_TARGET("avx2")
+inline __m256i mullo64_avx2(__m256i a, uint64_t c) {
+  __m256i lo = _mm256_mul_epu32(a, _mm256_set1_epi64x(static_cast<int64_t>(c)));
+  __m256i cross = _mm256_add_epi64(
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32),
+                       _mm256_set1_epi64x(static_cast<int64_t>(c))),
+      _mm256_mul_epu32(a, _mm256_set1_epi64x(static_cast<int64_t>(c >> 32))));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// rng(first + stride * lane) for lanes 0-3.
+WALK_TARGET("avx2")
+inline __m256i rng_avx2(const CounterRng &rng, uint64_t first,
+                        uint64_t stride) {
+  constexpr uint64_t g = CounterRng::kGamma;
+  uint64_t base = rng.key() + first * g;
+  uint64_t step = stride * g;
+  __m256i z = _mm256_set_epi64x(static_cast<int64_t>(base + 3 * step),
+                                static_cast<int64_t>(base + 2 * step),
+                                static_cast<int64_t>(base + step),
+                                static_cast<int64_t>(base));
+  z = _mm256_xor_si256(z, _mm256_srli_epi64(z, 30));
+  z = mullo64_avx2(z, 0xBF58476D1CE4E5B9ULL);
+  z = _mm256_xor_si256(z, _mm256_srli_epi64(z, 27));
+  z = mullo64_avx2(z, 0x94D049BB133111EBULL);
+  return _mm256_xor_si256(z, _mm256_srli_epi64(z, 31));
+}
+
+WALK_TARGET("avx2")
+inline __m256d unit_avx2(__m256i bits) {
+  __m256i m = _mm256_or_si256(_mm256_srli_epi64(bits, 12),
+                              _mm256_set1_epi64x(kOneBits));
+  return _mm256_sub_pd(_mm256_castsi256_pd(m), _mm256_set1_pd(1.0));
+}
+
+// Horner step: c + x * acc
+WALK_TARGET("avx2")
+inline __m256d horner_avx2(__m256d acc, __m256d x, double c) {
+  return _mm256_add_pd(_mm256_set1_pd(c), _mm256_mul_pd(x, acc));
+}
+
+WALK_TARGET("avx2")
+inline __m256d log_unit_avx2(__m256d x) {
+  __m256i bits = _mm256_castpd_si256(x);
+  __m256d e = _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                          _mm256_set1_epi64x(kMagicBits))),
+      _mm256_set1_pd(kMagic));
+  __m256d k = _mm256_sub_pd(e, _mm256_set1_pd(1023.0));
+  __m256d m = _mm256_castsi256_pd(
+      _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(kMantissaMask)),
+                      _mm256_set1_epi64x(kOneBits)));
+  __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(kSqrt2), _CMP_GT_OQ);
+  m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+  k = _mm256_add_pd(k, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+  __m256d f = _mm256_sub_pd(m, _mm256_set1_pd(1.0));
+  __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+  __m256d z = _mm256_mul_pd(s, s);
+  __m256d w = _mm256_mul_pd(z, z);
+  __m256d t1 = horner_avx2(_mm256_set1_pd(kLg6), w, kLg4);
+  t1 = _mm256_mul_pd(w, horner_avx2(t1, w, kLg2));
+  __m256d t2 = horner_avx2(_mm256_set1_pd(kLg7), w, kLg5);
+  t2 = horner_avx2(t2, w, kLg3);
+  t2 = _mm256_mul_pd(z, horner_avx2(t2, w, kLg1));
+  __m256d r = _mm256_add_pd(t2, t1);
+  __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), f);
+  __m256d inner = _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, r)),
+                                _mm256_mul_pd(k, _mm256_set1_pd(kLn2Lo)));
+  return _mm256_sub_pd(_mm256_mul_pd(k, _mm256_set1_pd(kLn2Hi)),
+                       _mm256_sub_pd(_mm256_sub_pd(hfsq, inner), f));
+}
+
+WALK_TARGET("avx2")
+inline void sincos_turns_avx2(__m256d u, __m256d &sin_out, __m256d &cos_out) {
+  __m256d t = _mm256_add_pd(_mm256_mul_pd(u, _mm256_set1_pd(4.0)),
+                            _mm256_set1_pd(kMagic));
+  __m256d q = _mm256_sub_pd(t, _mm256_set1_pd(kMagic));
+  __m256d x = _mm256_mul_pd(
+      _mm256_sub_pd(u, _mm256_mul_pd(q, _mm256_set1_pd(0.25))),
+      _mm256_set1_pd(kTwoPi));
+  __m256d z = _mm256_mul_pd(x, x);
+
+  __m256d sr = horner_avx2(_mm256_set1_pd(kS6), z, kS5);
+  sr = horner_avx2(sr, z, kS4);
+  sr = horner_avx2(sr, z, kS3);
+  sr = horner_avx2(sr, z, kS2);
+  __m256d sn = _mm256_add_pd(
+      x, _mm256_mul_pd(_mm256_mul_pd(x, z), horner_avx2(sr, z, kS1)));
+
+  __m256d cr = horner_avx2(_mm256_set1_pd(kC6), z, kC5);
+  cr = horner_avx2(cr, z, kC4);
+  cr = horner_avx2(cr, z, kC3);
+  cr = horner_avx2(cr, z, kC2);
+  cr = horner_avx2(cr, z, kC1);
+  __m256d cs = _mm256_sub_pd(
+      _mm256_set1_pd(1.0),
+      _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), z),
+                    _mm256_mul_pd(_mm256_mul_pd(z, z), cr)));
+
+  __m256i quadrant = _mm256_castpd_si256(t);
+  __m256i one = _mm256_set1_epi64x(1);
+  __m256i two = _mm256_set1_epi64x(2);
+  __m256d swap = _mm256_castsi256_pd(
+      _mm256_cmpeq_epi64(_mm256_and_si256(quadrant, one), one));
+  __m256i sin_sign = _mm256_slli_epi64(_mm256_and_si256(quadrant, two), 62);
+  __m256i cos_sign = _mm256_slli_epi64(
+      _mm256_and_si256(_mm256_add_epi64(quadrant, one), two), 62);
+
+  __m256d s = _mm256_blendv_pd(sn, cs, swap);
+  __m256d c = _mm256_blendv_pd(cs, sn, swap);
+  sin_out = _mm256_castsi256_pd(
+      _mm256_xor_si256(_mm256_castpd_si256(s), sin_sign));
+  cos_out = _mm256_castsi256_pd(
+      _mm256_xor_si256(_mm256_castpd_si256(c), cos_sign));
+}
+
+// r * trig * sqrt(dt) * noise
+WALK_TARGET("avx2")
+inline __m256d increment_avx2(__m256d r, __m256d trig, __m256d dt,
+                              __m256d noise) {
+  return _mm256_mul_pd(
+      _mm256_mul_pd(_mm256_mul_pd(r, trig), _mm256_sqrt_pd(dt)), noise);
+}
+
+WALK_TARGET("avx2")
+inline void fill_groups_avx2(const CounterRng &rng, size_t groups,
+                             double noise, double *dt, double *dy) {
+  const __m256d dt_min = _mm256_set1_pd(kDtMin);
+  const __m256d dt_span = _mm256_set1_pd(kDtSpan);
+  const __m256d noise_v = _mm256_set1_pd(noise);
+
+  for (size_t g = 0; g < groups; ++g) {
+    uint64_t k0 = g * kGroupSteps;
+    double *gdt = dt + k0;
+    double *gdy = dy + k0;
+
+    for (size_t j = 0; j < kGroupSteps; j += 4) {
+      __m256d u = unit_avx2(rng_avx2(rng, 2 * (k0 + j), 2));
+      _mm256_storeu_pd(gdt + j,
+                       _mm256_add_pd(dt_min, _mm256_mul_pd(dt_span, u)));
+    }
+
+    for (size_t j = 0; j < kGroupPairs; j += 4) {
+      __m256d u1 = _mm256_sub_pd(_mm256_set1_pd(1.0),
+                                 unit_avx2(rng_avx2(rng, 2 * (k0 + j) + 1, 2)));
+      __m256d u2 =
+          unit_avx2(rng_avx2(rng, 2 * (k0 + kGroupPairs + j) + 1, 2));
+      __m256d r = _mm256_sqrt_pd(
+          _mm256_mul_pd(_mm256_set1_pd(-2.0), log_unit_avx2(u1)));
+      __m256d sn, cs;
+      sincos_turns_avx2(u2, sn, cs);
+
+      __m256d dt_lo = _mm256_loadu_pd(gdt + j);
+      __m256d dt_hi = _mm256_loadu_pd(gdt + kGroupPairs + j);
+      _mm256_storeu_pd(gdy + j, increment_avx2(r, cs, dt_lo, noise_v));
+      _mm256_storeu_pd(gdy + kGroupPairs + j,
+                       increment_avx2(r, sn, dt_hi, noise_v));
+    }
+  }
+}
+
+// --- AVX-512: eight lanes, one full group of pairs per iteration ---
+
+#define WALK_AVX512 "avx512f,avx512dq"
+
+WALK_TARGET(WALK_AVX512)
+inline __m512i splat_avx512(uint64_t v) {
+  return _mm512_set1_epi64(static_cast<int64_t>(v));
+}
+
+WALK_TARGET(WALK_AVX512)
+inline __m512i rng_avx512(const CounterRng &rng, uint64_t first,
+                          uint64_t stride) {
+  constexpr uint64_t g = CounterRng::kGamma;
+  __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+  __m512i z = _mm512_add_epi64(splat_avx512(rng.key() + first * g),
+                               _mm512_mullo_epi64(lane, splat_avx512(stride * g)));
+  z = _mm512_xor_si512(z, _mm512_srli_epi64(z, 30));
+  z = _mm512_mullo_epi64(z, splat_avx512(0xBF58476D1CE4E5B9ULL));
+  z = _mm512_xor_si512(z, _mm512_srli_epi64(z, 27));
+  z = _mm512_mullo_epi64(z, splat_avx512(0x94D049BB133111EBULL));
+  return _mm512_xor_si512(z, _mm512_srli_epi64(z, 31));
+}
+
+WALK_TARGET(WALK_AVX512)
+inline __m512d unit_avx512(__m512i bits) {
+  __m512i m = _mm512_or_si512(_mm512_srli_epi64(bits, 12),
+                              _mm512_set1_epi64(kOneBits));
+  return _mm512_sub_pd(_mm512_castsi512_pd(m), _mm512_set1_pd(1.0));
+}
+
+WALK_TARGET(WALK_AVX512)
+inline __m512d horner_avx512(__m512d acc, __m512d x, double c) {
+  return _mm512_add_pd(_mm512_set1_pd(c), _mm512_mul_pd(x, acc));
+}
+
+WALK_TARGET(WALK_AVX512)
+inline __m512d log_unit_avx512(__m512d x) {
+  __m512i bits = _mm512_castpd_si512(x);
+  __m512d e = _mm512_sub_pd(
+      _mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(bits, 52),
+                                          _mm512_set1_epi64(kMagicBits))),
+      _mm512_set1_pd(kMagic));
+  __m512d k = _mm512_sub_pd(e, _mm512_set1_pd(1023.0));
+  __m512d m = _mm512_castsi512_pd(
+      _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64(kMantissaMask)),
+                      _mm512_set1_epi64(kOneBits)));
+  __mmask8 big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(kSqrt2), _CMP_GT_OQ);
+  m = _mm512_mask_mul_pd(m, big, m, _mm512_set1_pd(0.5));
+  k = _mm512_mask_add_pd(k, big, k, _mm512_set1_pd(1.0));
+
+  __m512d f = _mm512_sub_pd(m, _mm512_set1_pd(1.0));
+  __m512d s = _mm512_div_pd(f, _mm512_add_pd(_mm512_set1_pd(2.0), f));
+  __m512d z = _mm512_mul_pd(s, s);
+  __m512d w = _mm512_mul_pd(z, z);
+  __m512d t1 = horner_avx512(_mm512_set1_pd(kLg6), w, kLg4);
+  t1 = _mm512_mul_pd(w, horner_avx512(t1, w, kLg2));
+  __m512d t2 = horner_avx512(_mm512_set1_pd(kLg7), w, kLg5);
+  t2 = horner_avx512(t2, w, kLg3);
+  t2 = _mm512_mul_pd(z, horner_avx512(t2, w, kLg1));
+  __m512d r = _mm512_add_pd(t2, t1);
+  __m512d hfsq = _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), f), f);
+  __m512d inner = _mm512_add_pd(_mm512_mul_pd(s, _mm512_add_pd(hfsq, r)),
+                                _mm512_mul_pd(k, _mm512_set1_pd(kLn2Lo)));
+  return _mm512_sub_pd(_mm512_mul_pd(k, _mm512_set1_pd(kLn2Hi)),
+                       _mm512_sub_pd(_mm512_sub_pd(hfsq, inner), f));
+}
+
+WALK_TARGET(WALK_AVX512)
+inline void sincos_turns_avx512(__m512d u, __m512d &sin_out,
+                                __m512d &cos_out) {
+  __m512d t = _mm512_add_pd(_mm512_mul_pd(u, _mm512_set1_pd(4.0)),
+                            _mm512_set1_pd(kMagic));
+  __m512d q = _mm512_sub_pd(t, _mm512_set1_pd(kMagic));
+  __m512d x = _mm512_mul_pd(
+      _mm512_sub_pd(u, _mm512_mul_pd(q, _mm512_set1_pd(0.25))),
+      _mm512_set1_pd(kTwoPi));
+  __m512d z = _mm512_mul_pd(x, x);
+
+  __m512d sr = horner_avx512(_mm512_set1_pd(kS6), z, kS5);
+  sr = horner_avx512(sr, z, kS4);
+  sr = horner_avx512(sr, z, kS3);
+  sr = horner_avx512(sr, z, kS2);
+  __m512d sn = _mm512_add_pd(
+      x, _mm512_mul_pd(_mm512_mul_pd(x, z), horner_avx512(sr, z, kS1)));
+
+  __m512d cr = horner_avx512(_mm512_set1_pd(kC6), z, kC5);
+  cr = horner_avx512(cr, z, kC4);
+  cr = horner_avx512(cr, z, kC3);
+  cr = horner_avx512(cr, z, kC2);
+  cr = horner_avx512(cr, z, kC1);
+  __m512d cs = _mm512_sub_pd(
+      _mm512_set1_pd(1.0),
+      _mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), z),
+                    _mm512_mul_pd(_mm512_mul_pd(z, z), cr)));
+
+  __m512i quadrant = _mm512_castpd_si512(t);
+  __m512i one = _mm512_set1_epi64(1);
+  __m512i two = _mm512_set1_epi64(2);
+  __mmask8 swap = _mm512_test_epi64_mask(quadrant, one);
+  __m512i sin_sign = _mm512_slli_epi64(_mm512_and_si512(quadrant, two), 62);
+  __m512i cos_sign = _mm512_slli_epi64(
+      _mm512_and_si512(_mm512_add_epi64(quadrant, one), two), 62);
+
+  __m512d s = _mm512_mask_blend_pd(swap, sn, cs);
+  __m512d c = _mm512_mask_blend_pd(swap, cs, sn);
+  sin_out = _mm512_castsi512_pd(
+      _mm512_xor_si512(_mm512_castpd_si512(s), sin_sign));
+  cos_out = _mm512_castsi512_pd(
+      _mm512_xor_si512(_mm512_castpd_si512(c), cos_sign));
+}
+
+// r * trig * sqrt(dt) * noise
+WALK_TARGET(WALK_AVX512)
+inline __m512d increment_avx512(__m512d r, __m512d trig, __m512d dt,
+                                __m512d noise) {
+  return _mm512_mul_pd(
+      _mm512_mul_pd(_mm512_mul_pd(r, trig), _mm512_sqrt_pd(dt)), noise);
+}
+
+WALK_TARGET(WALK_AVX512)
+inline void fill_groups_avx512(const CounterRng &rng, size_t groups,
+                               double noise, double *dt, double *dy) {
+  const __m512d dt_min = _mm512_set1_pd(kDtMin);
+  const __m512d dt_span = _mm512_set1_pd(kDtSpan);
+  const __m512d noise_v = _mm512_set1_pd(noise);
+
+  for (size_t g = 0; g < groups; ++g) {
+    uint64_t k0 = g * kGroupSteps;
+    double *gdt = dt + k0;
+    double *gdy = dy + k0;
+
+    __m512d u_lo = unit_avx512(rng_avx512(rng, 2 * k0, 2));
+    __m512d u_hi = unit_avx512(rng_avx512(rng, 2 * (k0 + kGroupPairs), 2));
+    __m512d dt_lo = _mm512_add_pd(dt_min, _mm512_mul_pd(dt_span, u_lo));
+    __m512d dt_hi = _mm512_add_pd(dt_min, _mm512_mul_pd(dt_span, u_hi));
+    _mm512_storeu_pd(gdt, dt_lo);
+    _mm512_storeu_pd(gdt + kGroupPairs, dt_hi);
+
+    __m512d u1 = _mm512_sub_pd(_mm512_set1_pd(1.0),
+                               unit_avx512(rng_avx512(rng, 2 * k0 + 1, 2)));
+    __m512d u2 =
+        unit_avx512(rng_avx512(rng, 2 * (k0 + kGroupPairs) + 1, 2));
+    __m512d r = _mm512_sqrt_pd(
+        _mm512_mul_pd(_mm512_set1_pd(-2.0), log_unit_avx512(u1)));
+    __m512d sn, cs;
+    sincos_turns_avx512(u2, sn, cs);
+
+    _mm512_storeu_pd(gdy, increment_avx512(r, cs, dt_lo, noise_v));
+    _mm512_storeu_pd(gdy + kGroupPairs,
+                     increment_avx512(r, sn, dt_hi, noise_v));
+  }
+}
+
+#endif // WALK_X86
+
+} // namespace detail
+
+// Returns the widest kernel this CPU and OS support.
+inline Kernel detect_kernel() {
+#ifdef WALK_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  int max_leaf = info[0];
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || max_leaf < 7) {
+    return Kernel::Scalar;
+  }
+  unsigned long long xcr0 = _xgetbv(0);
+  __cpuidex(info, 7, 0);
+  bool avx2 = (info[1] & (1 << 5)) != 0;
+  bool avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 17)) != 0;
+  // The OS must save YMM (bits 1-2) and, for AVX-512, opmask/ZMM (bits 5-7)
+  if (avx512 && (xcr0 & 0xE6) == 0xE6) {
+    return Kernel::Avx512;
+  }
+  if (avx2 && (xcr0 & 0x06) == 0x06) {
+    return Kernel::Avx2;
+  }
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+    return Kernel::Avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return Kernel::Avx2;
+  }
+#endif
+#endif
+  return Kernel::Scalar;
+}
+
+inline Kernel best_kernel() {
+  static const Kernel kernel = detect_kernel();
+  return kernel;
+}
+
+// Resolves a kernel name from the form ("auto", "avx512", "avx2", "scalar"),
+// falling back to the widest supported kernel no wider than the request.
+inline Kernel select_kernel(std::string_view name) {
+  Kernel best = best_kernel();
+  Kernel requested = best;
+  if (name == "scalar") {
+    requested = Kernel::Scalar;
+  } else if (name == "avx2") {
+    requested = Kernel::Avx2;
+  } else if (name == "avx512") {
+    requested = Kernel::Avx512;
+  }
+  return static_cast<int>(requested) < static_cast<int>(best) ? requested
+                                                              : best;
+}
+
+// Fills dt with uniform time steps in [kDtMin, kDtMax) and dy with Gaussian
+// increments scaled by sqrt(dt) * noise for the steps of one block.
+inline void fill_increments(Kernel kernel, const CounterRng &rng, double noise,
+                            std::span<double> dt, std::span<double> dy) {
+  size_t n = dt.size();
+  size_t groups = n / kGroupSteps;
+
+  switch (kernel) {
+#ifdef WALK_X86
+  case Kernel::Avx512:
+    detail::fill_groups_avx512(rng, groups, noise, dt.data(), dy.data());
+    break;
+  case Kernel::Avx2:
+    detail::fill_groups_avx2(rng, groups, noise, dt.data(), dy.data());
+    break;
+#endif
+  default:
+    detail::fill_groups_scalar(rng, groups, noise, dt.data(), dy.data());
+    break;
+  }
+
+  // A partial final group is evaluated in full and truncated, so its samples
+  // match those a longer block would have produced.
+  size_t done = groups * kGroupSteps;
+  if (done < n) {
+    double tail_dt[kGroupSteps];
+    double tail_dy[kGroupSteps];
+    detail::fill_group_scalar(rng, done, noise, tail_dt, tail_dy);
+    std::copy_n(tail_dt, n - done, dt.begin() + done);
+    std::copy_n(tail_dy, n - done, dy.begin() + done);
+  }
+}
+
+} // namespace walk
+
+#if defined(__clang__)
+#pragma clang fp contract(on)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#elif defined(_MSC_VER)
+#pragma fp_contract(on)
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "../../sdk/cpp/pyramid.hpp"
+
+// Least-recently-used cache of generated series under a memory budget, safe
+// to use from several threads. Series are handed out shared, so one still
+// being sent outlives its eviction by a later insert or a clear.
+class SeriesCache {
+public:
+  using Pyramid = std::shared_ptr<const sdk::SeriesPyramid>;
+
+  explicit SeriesCache(size_t budget_bytes) : budget_(budget_bytes) {}
+
+  // Returns the cached series and marks it most recently used, or nullptr.
+  Pyramid find(std::string_view id) {
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->pyramid;
+  }
+
+  // True if a series of this size can be cached at all.
+  bool fits(size_t bytes) const { return bytes <= budget_; }
+
+  // Stores a series, evicting the least recently used ones to make room.
+  Pyramid insert(std::string id, sdk::SeriesPyramid pyramid) {
+    size_t bytes = pyramid.memory_bytes();
+    auto shared =
+        std::make_shared<const sdk::SeriesPyramid>(std::move(pyramid));
+    std::lock_guard lock(mutex_);
+    erase(id);
+    while (!entries_.empty() && bytes_ + bytes > budget_) {
+      erase(entries_.back().id);
+    }
+
+    entries_.push_front({std::move(id), shared, bytes});
+    index_.emplace(entries_.front().id, entries_.begin());
+    bytes_ += bytes;
+    return entries_.front().pyramid;
+  }
+
+  void clear() {
+    std::lock_guard lock(mutex_);
+    index_.clear();
+    entries_.clear();
+    bytes_ = 0;
+  }
+
+  size_t size() const {
+    std::lock_guard lock(mutex_);
+    return entries_.size();
+  }
+  size_t bytes() const {
+    std::lock_guard lock(mutex_);
+    return bytes_;
+  }
+  size_t budget() const { return budget_; }
+
+private:
+  struct Entry {
+    std::string id;
+    Pyramid pyramid;
+    size_t bytes = 0;
+  };
+
+  void erase(std::string_view id) {
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+      return;
+    }
+    bytes_ -= it->second->bytes;
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+
+  size_t budget_;
+  mutable std::mutex mutex_;
+  size_t bytes_ = 0;
+  std::list<Entry> entries_; // Most recently used first
+  std::map<std::string, std::list<Entry>::iterator, std::less<>> index_;
+};
@@ -0,0 +1,453 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../../sdk/cpp/arena.hpp"
+#include "../../sdk/cpp/layout.hpp"
+#include "../../sdk/cpp/numa.hpp"
+#include "sampling.hpp"
+
+// Counter-based, block-parallel random walk engine.
+//
+// The walk is split into fixed-size blocks. Every block draws from its own
+// counter-based RNG stream keyed by (seed, block index), so a block can be
+// generated on any thread, in any order, and always yields the same values.
+// Blocks are integrated locally in parallel and then offset by a prefix sum of
+// the block totals taken in block order, which keeps the output bit-identical
+// for a given seed whatever the thread count.
+namespace walk {
+
+// Steps per block. A multiple of kGroupSteps so only the final block of a
+// walk has a partial sample group.
+inline constexpr size_t kBlockSteps = size_t{1} << 16;
+static_assert(kBlockSteps % kGroupSteps == 0);
+
+// Runs f(i) for every i in [0, count) on up to `threads` threads. Helper
+// threads stay on the caller's NUMA node if it is bound to one, so a walk
+// is written by threads local to the memory it lands in.
+template <typename F>
+void parallel_for(size_t count, unsigned threads, const F &f) {
+  threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      f(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    size_t i;
+    while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+      f(i);
+    }
+  };
+
+  std::optional<size_t> node = sdk::NumaTopology::thread_node();
+  std::vector<std::jthread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned t = 1; t < threads; ++t) {
+    pool.emplace_back([&] {
+      if (node) {
+        sdk::numa_topology().bind_thread(*node);
+      }
+      worker();
+    });
+  }
+  worker();
+}
+
+inline unsigned resolve_threads(unsigned requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+struct Params {
+  uint64_t seed = 0;
+  size_t steps = 0;
+  double noise = 1.0;
+  unsigned threads = 0; // 0 = hardware concurrency
+  Kernel kernel = best_kernel();
+};
+
+struct BlockTotals {
+  double t = 0;
+  double y = 0;
+};
+
+// Steps in block `block` of the walk; only the last block may be short.
+inline size_t block_steps(const Params &params, size_t block) {
+  return std::min(kBlockSteps, params.steps - block * kBlockSteps);
+}
+
+inline size_t block_count(const Params &params) {
+  return (params.steps + kBlockSteps - 1) / kBlockSteps;
+}
+
+struct Increments {
+  std::vector<double> dt;
+  std::vector<double> dy;
+};
+
+// The first n time and value steps of block `block`, in a buffer owned by
+// the calling thread.
+inline const Increments &block_increments(const Params &params, size_t block,
+                                          size_t n) {
+  thread_local Increments increments;
+  increments.dt.resize(n);
+  increments.dy.resize(n);
+  fill_increments(params.kernel, CounterRng(params.seed, block), params.noise,
+                  increments.dt, increments.dy);
+  return increments;
+}
+
+// Writes block `block` of the walk into out relative to the block start
+// and returns the block's end point.
+template <sdk::Layout L>
+BlockTotals integrate_block(const Params &params, size_t block,
+                            sdk::Samples<L> out) {
+  size_t n = out.size();
+  const Increments &steps = block_increments(params, block, n);
+
+  double t = 0;
+  double y = 0;
+  for (size_t k = 0; k < n; ++k) {
+    t += steps.dt[k];
+    y += steps.dy[k];
+    out.set(k, t, y);
+  }
+  return {t, y};
+}
+
+// The end point of block `block` relative to its start, summed in the same
+// order as integrate_block() but without storing the points.
+inline BlockTotals block_totals(const Params &params, size_t block) {
+  size_t n = block_steps(params, block);
+  const Increments &steps = block_increments(params, block, n);
+
+  BlockTotals totals;
+  for (size_t k = 0; k < n; ++k) {
+    totals.t += steps.dt[k];
+    totals.y += steps.dy[k];
+  }
+  return totals;
+}
+
+// Blocks per generation window: a few per thread, so every thread stays busy
+// while memory stays bounded.
+inline size_t blocks_per_window(unsigned threads) {
+  return std::max<size_t>(size_t{4} * threads, 16);
+}
+
+// The window buffer generate() uses unless given others: one block reused
+// for every window, borrowed from the SDK arena so repeat requests reuse its
+// pages.
+template <sdk::Layout L> class WindowBuffer {
+public:
+  sdk::Samples<L> next(size_t points) {
+    buffer_.resize_for_overwrite(points * 2);
+    return sdk::Samples<L>::of(buffer_.data(), points);
+  }
+
+private:
+  sdk::ArenaVector<double> buffer_;
+};
+
+// Generates steps + 1 points starting at the origin, laid out as L, and
+// hands them to sink as consecutive runs of sdk::Samples<L, const double>;
+// the sink returns false to stop early. Work proceeds in windows of a few
+// blocks per thread, so memory stays bounded for any walk length.
+//
+// Each window is written in place into buffers.next(points), an
+// sdk::Samples<L>, so the caller chooses where the points land: a pipeline
+// block, shared memory, ... A window handed to the sink is not touched again
+// by generate().
+template <sdk::Layout L, typename Buffers, typename Sink>
+void generate(const Params &params, Buffers &&buffers, Sink &&sink) {
+  sdk::Samples<L> origin = buffers.next(1);
+  origin.set(0, 0.0, 0.0);
+  if (!sink(sdk::Samples<L, const double>(origin))) {
+    return;
+  }
+
+  unsigned threads = resolve_threads(params.threads);
+  size_t total_blocks = block_count(params);
+  size_t window_blocks = blocks_per_window(threads);
+
+  std::vector<BlockTotals> totals;
+  BlockTotals carry;
+
+  for (size_t first = 0; first < total_blocks; first += window_blocks) {
+    size_t blocks = std::min(window_blocks, total_blocks - first);
+    size_t first_step = first * kBlockSteps;
+    size_t steps = std::min(blocks * kBlockSteps, params.steps - first_step);
+
+    sdk::Samples<L> window = buffers.next(steps);
+    totals.resize(blocks);
+
+    auto block_samples = [&](size_t b) {
+      size_t begin = b * kBlockSteps;
+      size_t end = std::min(begin + kBlockSteps, steps);
+      return window.subspan(begin, end - begin);
+    };
+
+    parallel_for(blocks, threads, [&](size_t b) {
+      totals[b] = integrate_block<L>(params, first + b, block_samples(b));
+    });
+
+    // Exclusive scan of block totals in block order
+    std::vector<BlockTotals> offsets(blocks);
+    for (size_t b = 0; b < blocks; ++b) {
+      offsets[b] = carry;
+      carry.t += totals[b].t;
+      carry.y += totals[b].y;
+    }
+
+    parallel_for(blocks, threads, [&](size_t b) {
+      sdk::Samples<L> out = block_samples(b);
+      for (size_t k = 0; k < out.size(); ++k) {
+        out.x(k) += offsets[b].t;
+        out.y(k) += offsets[b].y;
+      }
+    });
+
+    if (!sink(sdk::Samples<L, const double>(window))) {
+      return;
+    }
+  }
+}
+
+// Checkpoints hold the point of the walk at every block boundary, so any
+// range of it can be generated from the blocks the range lies in alone:
+// each block draws from its own stream and only needs its start point.
+// They take O(blocks) memory, 16 bytes per 65536 steps.
+class Checkpoints {
+public:
+  Checkpoints() = default;
+  Checkpoints(std::vector<BlockTotals> starts, size_t steps)
+      : starts_(std::move(starts)), steps_(steps) {}
+
+  size_t blocks() const { return starts_.size() - 1; }
+
+  // The point block `block` starts from, or the last point of the walk for
+  // block == blocks().
+  const BlockTotals &start(size_t block) const { return starts_[block]; }
+
+  // Indexes [first, end) of the fewest whole blocks covering every point
+  // with t in [t_min, t_max] and the nearest point on either side of it.
+  std::pair<size_t, size_t> points_around(double t_min, double t_max) const {
+    // Starts are in increasing t, as every time step is positive
+    auto from_min = std::lower_bound(
+        starts_.begin(), starts_.end(), t_min,
+        [](const BlockTotals &p, double t) { return p.t < t; });
+    auto after_max = std::upper_bound(
+        starts_.begin(), starts_.end(), t_max,
+        [](double t, const BlockTotals &p) { return t < p.t; });
+    // From the last start before t_min to the first start after t_max
+    size_t first_block = static_cast<size_t>(from_min - starts_.begin());
+    size_t last_block = static_cast<size_t>(after_max - starts_.begin());
+    first_block = first_block > 0 ? first_block - 1 : 0;
+    last_block = std::min(last_block, blocks());
+    return {boundary(first_block), boundary(last_block) + 1};
+  }
+
+  size_t memory_bytes() const { return starts_.size() * sizeof(BlockTotals); }
+
+private:
+  // Index of the point block `block` starts from.
+  size_t boundary(size_t block) const {
+    return std::min(block * kBlockSteps, steps_);
+  }
+
+  std::vector<BlockTotals> starts_{1}; // blocks() + 1 points
+  size_t steps_ = 0;
+};
+
+// Computes the checkpoints of a walk without storing any of its points,
+// summing block totals in block order exactly as generate() does. Windows of
+// blocks run on params.threads threads; returns nothing if keep_going()
+// turns false between them.
+template <typename Continue>
+std::optional<Checkpoints> make_checkpoints(const Params &params,
+                                            Continue &&keep_going) {
+  unsigned threads = resolve_threads(params.threads);
+  size_t total_blocks = block_count(params);
+  size_t window_blocks = blocks_per_window(threads) * 16;
+
+  std::vector<BlockTotals> starts(total_blocks + 1);
+  for (size_t first = 0; first < total_blocks; first += window_blocks) {
+    size_t blocks = std::min(window_blocks, total_blocks - first);
+    parallel_for(blocks, threads, [&](size_t b) {
+      starts[first + b + 1] = block_totals(params, first + b);
+    });
+    if (!keep_going()) {
+      return std::nullopt;
+    }
+  }
+  for (size_t b = 0; b < total_blocks; ++b) {
+    starts[b + 1].t += starts[b].t;
+    starts[b + 1].y += starts[b].y;
+  }
+  return Checkpoints(std::move(starts), params.steps);
+}
+
+// Writes steps [skip, skip + out.size()) of block `block` into out, offset
+// by the block's start point.
+template <sdk::Layout L>
+void integrate_block_part(const Params &params, size_t block, size_t skip,
+                          const BlockTotals &start, sdk::Samples<L> out) {
+  size_t n = out.size();
+  const Increments &steps = block_increments(params, block, skip + n);
+
+  double t = 0;
+  double y = 0;
+  for (size_t k = 0; k < skip; ++k) {
+    t += steps.dt[k];
+    y += steps.dy[k];
+  }
+  for (size_t k = 0; k < n; ++k) {
+    t += steps.dt[skip + k];
+    y += steps.dy[skip + k];
+    out.set(k, t + start.t, y + start.y);
+  }
+}
+
+// Generates points [first, first + count) of the walk, bit-identical to the
+// same points from generate(), while drawing only the blocks they lie in.
+// Windows come from buffers.next(points) and runs go to sink as for
+// generate(). The range is clipped to the walk's steps + 1 points.
+template <sdk::Layout L, typename Buffers, typename Sink>
+void generate_range(const Params &params, const Checkpoints &checkpoints,
+                    size_t first, size_t count, Buffers &&buffers,
+                    Sink &&sink) {
+  first = std::min(first, params.steps + 1);
+  count = std::min(count, params.steps + 1 - first);
+  if (count == 0) {
+    return;
+  }
+  if (first == 0) {
+    sdk::Samples<L> origin = buffers.next(1);
+    origin.set(0, 0.0, 0.0);
+    if (!sink(sdk::Samples<L, const double>(origin)) || count == 1) {
+      return;
+    }
+    first = 1;
+    --count;
+  }
+
+  unsigned threads = resolve_threads(params.threads);
+  size_t window_blocks = blocks_per_window(threads);
+
+  // Point p > 0 is the end of step p - 1
+  size_t step = first - 1;
+  size_t end_step = step + count;
+  while (step < end_step) {
+    size_t first_block = step / kBlockSteps;
+    size_t window_end =
+        std::min(end_step, (first_block + window_blocks) * kBlockSteps);
+    size_t blocks = (window_end - 1) / kBlockSteps - first_block + 1;
+    sdk::Samples<L> window = buffers.next(window_end - step);
+
+    parallel_for(blocks, threads, [&](size_t b) {
+      size_t block = first_block + b;
+      size_t begin = std::max(step, block * kBlockSteps);
+      size_t end = std::min(window_end, (block + 1) * kBlockSteps);
+      integrate_block_part<L>(params, block, begin - block * kBlockSteps,
+                              checkpoints.start(block),
+                              window.subspan(begin - step, end - begin));
+    });
+
+    if (!sink(sdk::Samples<L, const double>(window))) {
+      return;
+    }
+    step = window_end;
+  }
+}
+
+// Continues a walk past its last step, for live series. The points are
+// bit-identical to those a walk with more steps would have there: each
+// block's points are its own running sums offset by the block's start.
+class Extension {
+public:
+  // Continues from step `step`, whose block starts from `block_start`.
+  Extension(const Params &params, size_t step, BlockTotals block_start)
+      : params_(params), step_(step), start_(block_start) {
+    load(step_ / kBlockSteps);
+    for (size_t k = 0; k < step_ % kBlockSteps; ++k) {
+      local_.t += dt_[k];
+      local_.y += dy_[k];
+    }
+  }
+
+  // Steps taken so far, i.e. the index of the last point written.
+  size_t steps() const { return step_; }
+
+  // Writes the next out.size() points.
+  template <sdk::Layout L> void next(sdk::Samples<L> out) {
+    for (size_t k = 0; k < out.size(); ++k) {
+      size_t i = step_ % kBlockSteps;
+      if (i == 0 && step_ / kBlockSteps != block_) {
+        start_.t += local_.t;
+        start_.y += local_.y;
+        local_ = {};
+        load(step_ / kBlockSteps);
+      }
+      local_.t += dt_[i];
+      local_.y += dy_[i];
+      out.set(k, local_.t + start_.t, local_.y + start_.y);
+      ++step_;
+    }
+  }
+
+private:
+  void load(size_t block) {
+    block_ = block;
+    dt_.resize(kBlockSteps);
+    dy_.resize(kBlockSteps);
+    fill_increments(params_.kernel, CounterRng(params_.seed, block),
+                    params_.noise, dt_, dy_);
+  }
+
+  Params params_;
+  size_t step_;
+  size_t block_ = 0;
+  BlockTotals start_; // Point the current block starts from
+  BlockTotals local_; // Sum of the block's steps so far
+  std::vector<double> dt_;
+  std::vector<double> dy_;
+};
+
+// Generates the walk as interleaved (t, y) pairs, handing the sink
+// std::span<const double> runs.
+template <typename Sink> void generate(const Params &params, Sink &&sink) {
+  constexpr sdk::Layout kInterleaved = sdk::Layout::Interleaved;
+  WindowBuffer<kInterleaved> buffer;
+  generate<kInterleaved>(
+      params, buffer, [&](sdk::Samples<kInterleaved, const double> points) {
+        return sink(points.interleaved());
+      });
+}
+
+// Generates points [first, first + count) as interleaved (t, y) pairs.
+template <typename Sink>
+void generate_range(const Params &params, const Checkpoints &checkpoints,
+                    size_t first, size_t count, Sink &&sink) {
+  constexpr sdk::Layout kInterleaved = sdk::Layout::Interleaved;
+  WindowBuffer<kInterleaved> buffer;
+  generate_range<kInterleaved>(
+      params, checkpoints, first, count, buffer,
+      [&](sdk::Samples<kInterleaved, const double> points) {
+        return sink(points.interleaved());
+      });
+}
+
+} // namespace walk
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "numa.hpp"
+#include "platform.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#elif defined(_MSC_VER)
+#pragma comment(lib, "advapi32.lib")
+#endif
+
+namespace sdk {
+
+namespace detail {
+
+// A block of pages mapped straight from the operating system.
+struct Pages {
+  std::byte *data = nullptr;
+  size_t bytes = 0;
+  std::optional<size_t> node; // NUMA node of the thread that mapped it
+};
+
+inline size_t page_size() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+inline size_t large_page_size() {
+#ifdef _WIN32
+  return GetLargePageMinimum();
+#elif defined(__linux__)
+  return size_t{2} << 20;
+#else
+  return 0;
+#endif
+}
+
+#ifdef _WIN32
+// Large pages need SeLockMemoryPrivilege, which must be both granted to the
+// user and enabled on the process token.
+inline bool enable_lock_memory_privilege() {
+  HANDLE token = nullptr;
+  if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES,
+                        &token)) {
+    return false;
+  }
+  TOKEN_PRIVILEGES privileges{};
+  privileges.PrivilegeCount = 1;
+  privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+  bool enabled =
+      LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege",
+                            &privileges.Privileges[0].Luid) &&
+      AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+      GetLastError() == ERROR_SUCCESS;
+  CloseHandle(token);
+  return enabled;
+}
+#endif
+
+inline size_t round_up(size_t bytes, size_t unit) {
+  return (bytes + unit - 1) / unit * unit;
+}
+
+// Maps at least `bytes` bytes of zeroed, page-aligned memory, on large pages
+// if asked and the system has them to spare. Returns empty Pages on failure.
+inline Pages map_pages(size_t bytes, bool large) {
+  static const size_t small = page_size();
+  size_t huge = large ? large_page_size() : 0;
+#ifdef _WIN32
+  if (huge > 0) {
+    size_t rounded = round_up(bytes, huge);
+    if (void *data = VirtualAlloc(nullptr, rounded,
+                                  MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                  PAGE_READWRITE)) {
+      return {static_cast<std::byte *>(data), rounded, {}};
+    }
+  }
+  size_t rounded = round_up(bytes, small);
+  void *data =
+      VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  return data ? Pages{static_cast<std::byte *>(data), rounded, {}} : Pages{};
+#else
+#ifdef MAP_HUGETLB
+  if (huge > 0) {
+    size_t rounded = round_up(bytes, huge);
+    void *data = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+      return {static_cast<std::byte *>(data), rounded, {}};
+    }
+  }
+#endif
+  size_t rounded = round_up(bytes, small);
+  void *data = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED) {
+    return {};
+  }
+#ifdef MADV_HUGEPAGE
+  if (huge > 0) {
+    // No reserved huge pages: let transparent huge pages back it instead
+    madvise(data, rounded, MADV_HUGEPAGE);
+  }
+#endif
+  return {static_cast<std::byte *>(data), rounded, {}};
+#endif
+}
+
+inline void unmap_pages(const Pages &pages) {
+  if (pages.data == nullptr) {
+    return;
+  }
+#ifdef _WIN32
+  VirtualFree(pages.data, 0, MEM_RELEASE);
+#else
+  munmap(pages.data, pages.bytes);
+#endif
+}
+
+} // namespace detail
+
+class OutputArena;
+
+// ArenaBuffer is a page-aligned block borrowed from an OutputArena, handed
+// back to it when the buffer is destroyed.
+class ArenaBuffer {
+public:
+  ArenaBuffer() = default;
+  ArenaBuffer(OutputArena *arena, detail::Pages pages)
+      : arena_(arena), pages_(pages) {}
+
+  ArenaBuffer(const ArenaBuffer &) = delete;
+  ArenaBuffer &operator=(const ArenaBuffer &) = delete;
+
+  ArenaBuffer(ArenaBuffer &&other) noexcept
+      : arena_(std::exchange(other.arena_, nullptr)),
+        pages_(std::exchange(other.pages_, {})) {}
+  ArenaBuffer &operator=(ArenaBuffer &&other) noexcept {
+    if (this != &other) {
+      release();
+      arena_ = std::exchange(other.arena_, nullptr);
+      pages_ = std::exchange(other.pages_, {});
+    }
+    return *this;
+  }
+
+  inline ~ArenaBuffer();
+
+  std::byte *data() const { return pages_.data; }
+  size_t capacity() const { return pages_.bytes; }
+  explicit operator bool() const { return pages_.data != nullptr; }
+
+private:
+  inline void release();
+
+  OutputArena *arena_ = nullptr;
+  detail::Pages pages_;
+};
+
+// OutputArena recycles the large buffers plugins fill for each request, so a
+// refetch reuses memory that is already mapped and faulted in instead of
+// asking the allocator for fresh, zeroed pages. Buffers come straight from
+// the operating system, page-aligned and optionally on large pages, and are
+// kept for reuse once returned, up to a limit on the idle bytes held.
+// Recycled memory is not cleared. Safe to use from any thread.
+//
+// Pages live on the NUMA node of the thread that first writes them, which
+// for a fresh block is normally the thread that borrowed it. Blocks remember
+// that thread's node, see NumaTopology::bind_thread(), and threads bound to
+// a node are given blocks from their own node first.
+class OutputArena {
+public:
+  static constexpr size_t kDefaultRetainBytes = size_t{1} << 30;
+
+  explicit OutputArena(size_t retain_bytes = kDefaultRetainBytes)
+      : retain_limit_(retain_bytes) {}
+
+  ~OutputArena() { trim(); }
+
+  OutputArena(const OutputArena &) = delete;
+  OutputArena &operator=(const OutputArena &) = delete;
+
+  // A buffer of at least `bytes` bytes with unspecified contents. The
+  // smallest idle block that fits is reused unless it is more than twice the
+  // size asked for, preferring blocks from the calling thread's NUMA node.
+  // Returns an empty buffer if the system is out of memory.
+  ArenaBuffer borrow(size_t bytes) {
+    bytes = std::max<size_t>(bytes, 1);
+    std::optional<size_t> node = NumaTopology::thread_node();
+    bool large = false;
+    {
+      std::lock_guard lock(mutex_);
+      auto best = free_.end();
+      bool best_local = false;
+      for (auto it = free_.begin(); it != free_.end(); ++it) {
+        if (it->bytes < bytes || it->bytes / 2 > bytes) {
+          continue;
+        }
+        bool local = it->node == node;
+        if (best == free_.end() || local > best_local ||
+            (local == best_local && it->bytes < best->bytes)) {
+          best = it;
+          best_local = local;
+        }
+      }
+      if (best != free_.end()) {
+        detail::Pages pages = *best;
+        free_.erase(best);
+        retained_ -= pages.bytes;
+        return {this, pages};
+      }
+      large = large_pages_;
+    }
+    detail::Pages pages = detail::map_pages(bytes, large);
+    if (pages.data == nullptr) {
+      // Idle blocks too large to reuse may be what is holding the memory
+      trim();
+      pages = detail::map_pages(bytes, large);
+    }
+    pages.node = node;
+    return pages.data ? ArenaBuffer(this, pages) : ArenaBuffer();
+  }
+
+  // Asks for large pages (2 MiB on x86-64) for blocks mapped from now on,
+  // falling back to normal pages where the system has none to give. On
+  // Windows this needs the "Lock pages in memory" user right. Returns false
+  // if large pages are unavailable, though on Linux transparent huge pages
+  // are still requested.
+  bool use_large_pages(bool enable) {
+#ifdef _WIN32
+    bool available = !enable || (detail::large_page_size() > 0 &&
+                                 detail::enable_lock_memory_privilege());
+#else
+    bool available = !enable || detail::large_page_size() > 0;
+#endif
+    std::lock_guard lock(mutex_);
+    large_pages_ = enable;
+    return available;
+  }
+
+  // Caps the idle bytes kept for reuse, unmapping the oldest blocks over it.
+  void set_retain_bytes(size_t bytes) {
+    std::lock_guard lock(mutex_);
+    retain_limit_ = bytes;
+    shrink_locked();
+  }
+
+  // Unmaps every idle block.
+  void trim() {
+    std::vector<detail::Pages> idle;
+    {
+      std::lock_guard lock(mutex_);
+      idle.swap(free_);
+      retained_ = 0;
+    }
+    for (const detail::Pages &pages : idle) {
+      detail::unmap_pages(pages);
+    }
+  }
+
+  size_t retained_bytes() const {
+    std::lock_guard lock(mutex_);
+    return retained_;
+  }
+
+private:
+  friend class ArenaBuffer;
+
+  void give_back(detail::Pages pages) {
+    std::lock_guard lock(mutex_);
+    free_.push_back(pages);
+    retained_ += pages.bytes;
+    shrink_locked();
+  }
+
+  void shrink_locked() {
+    while (retained_ > retain_limit_ && !free_.empty()) {
+      retained_ -= free_.front().bytes;
+      detail::unmap_pages(free_.front());
+      free_.erase(free_.begin());
+    }
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<detail::Pages> free_; // Oldest first
+  size_t retained_ = 0;
+  size_t retain_limit_;
+  bool large_pages_ = false;
+};
+
+inline ArenaBuffer::~ArenaBuffer() { release(); }
+
+inline void ArenaBuffer::release() {
+  if (arena_ != nullptr && pages_.data != nullptr) {
+    arena_->give_back(pages_);
+  }
+  arena_ = nullptr;
+  pages_ = {};
+}
+
+// The process-wide arena the SDK's buffers are borrowed from. It is never
+// destroyed, so buffers owned by other statics can still return to it at
+// exit.
+inline OutputArena &output_arena() {
+  static auto *arena = new OutputArena();
+  return *arena;
+}
+
+// ArenaVector is a growable array of trivially copyable values stored in
+// arena memory. Unlike std::vector it never value-initialises: callers size
+// it with resize_for_overwrite() and fill it themselves.
+template <typename T> class ArenaVector {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  ArenaVector() = default;
+  explicit ArenaVector(size_t count) { resize_for_overwrite(count); }
+
+  ArenaVector(ArenaVector &&other) noexcept
+      : buffer_(std::move(other.buffer_)),
+        size_(std::exchange(other.size_, 0)) {}
+  ArenaVector &operator=(ArenaVector &&other) noexcept {
+    buffer_ = std::move(other.buffer_);
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+  }
+
+  void reserve(size_t count) {
+    if (count <= capacity()) {
+      return;
+    }
+    ArenaBuffer grown = output_arena().borrow(count * sizeof(T));
+    if (!grown) {
+      throw std::bad_alloc();
+    }
+    if (size_ > 0) {
+      std::memcpy(grown.data(), buffer_.data(), size_ * sizeof(T));
+    }
+    buffer_ = std::move(grown);
+  }
+
+  // Sets the size, leaving any new elements uninitialised.
+  void resize_for_overwrite(size_t count) {
+    reserve(count);
+    size_ = count;
+  }
+
+  void push_back(const T &value) {
+    if (size_ == capacity()) {
+      reserve(std::max<size_t>(size_ * 2, 4096 / sizeof(T)));
+    }
+    data()[size_++] = value;
+  }
+
+  void clear() { size_ = 0; }
+
+  T *data() { return reinterpret_cast<T *>(buffer_.data()); }
+  const T *data() const { return reinterpret_cast<const T *>(buffer_.data()); }
+  size_t size() const { return size_; }
+  size_t capacity() const { return buffer_.capacity() / sizeof(T); }
+  bool empty() const { return size_ == 0; }
+
+  T *begin() { return data(); }
+  T *end() { return data() + size_; }
+  const T *begin() const { return data(); }
+  const T *end() const { return data() + size_; }
+
+  T &operator[](size_t i) { return data()[i]; }
+  const T &operator[](size_t i) const { return data()[i]; }
+  const T &front() const { return data()[0]; }
+  const T &back() const { return data()[size_ - 1]; }
+
+private:
+  ArenaBuffer buffer_;
+  size_t size_ = 0;
+};
+
+} // namespace sdk
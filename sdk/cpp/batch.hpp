@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "numa.hpp"
+
+namespace sdk {
+
+// Runs produce(i) for every i in [0, count) on up to `threads` worker threads
+// and hands each result to deliver(i, result) on the calling thread as soon as
+// it is ready, in completion order. All output to the host therefore stays on
+// one thread while the work itself overlaps, so a batch takes about as long as
+// its slowest item rather than the sum of all of them.
+//
+// On NUMA machines the workers are spread over the nodes and bound to them,
+// so each item is produced, and its fresh memory first touched, on one node
+// and every socket's memory bandwidth is used.
+template <typename Produce, typename Deliver>
+void run_batch(size_t count, unsigned threads, Produce &&produce,
+               Deliver &&deliver) {
+  using Result = std::invoke_result_t<Produce &, size_t>;
+
+  threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      deliver(i, produce(i));
+    }
+    return;
+  }
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<std::pair<size_t, Result>> done;
+  std::atomic<size_t> next{0};
+
+  std::vector<std::jthread> pool;
+  pool.reserve(threads);
+  for (unsigned t = 0; t < threads; ++t) {
+    pool.emplace_back([&, t] {
+      numa_topology().bind_thread(t);
+      size_t i;
+      while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+        Result result = produce(i);
+        {
+          std::lock_guard lock(mutex);
+          done.emplace_back(i, std::move(result));
+        }
+        ready.notify_one();
+      }
+    });
+  }
+
+  for (size_t delivered = 0; delivered < count; ++delivered) {
+    std::unique_lock lock(mutex);
+    ready.wait(lock, [&] { return !done.empty(); });
+    std::pair<size_t, Result> item = std::move(done.front());
+    done.pop_front();
+    lock.unlock();
+    deliver(item.first, std::move(item.second));
+  }
+}
+
+} // namespace sdk
@@ -0,0 +1,6 @@
+@echo off
+REM Initialize Visual Studio build environment
+call "C:\Program Files\Microsoft Visual Studio\2022\Community\VC\Auxiliary\Build\vcvarsall.bat" x64 >nul 2>&1
+
+REM Build the benchmark
+cl /EHsc /O2 /std:c++20 /Fe:plugin_bench.exe plugin_bench.cpp psapi.lib
@@ -0,0 +1,721 @@
+// plugin_bench drives a plugin executable over the real stdin/stdout protocol
+// as a mock host and reports get_series_data throughput as JSON on stdout.
+//
+//   plugin_bench <plugin> [--orders 3-8] [--series 1,10]
+//                [--storage interleaved,arrays] [--transport pipe,shm]
+//                [--dtypes f64] [--compression none,lz4] [--runs 2]
+//                [--live 5 --rates 1e6,1e7]
+//
+// Every combination gets a fresh plugin process, so the first run of each
+// starts with a cold cache and the reported peak RSS is that combination's
+// own. The plugin is configured through its show_form reply with the
+// numSeries and order under test (a multiplier of 1, so 10^order + 1
+// points per series), which suits the random walk generator and any plugin
+// with the same form fields. Compression levels other than none start the
+// plugin with --compression <level> and offer it "shuffle-lz4"; payloads
+// are timed and counted as sent, without inflating them.
+//
+// With --live <seconds>, it instead subscribes to a live series of plugins
+// with the "live" capability at each of the --rates, and reports the points
+// per second its append frames sustain over that time.
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+#include "../json.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// PluginProcess runs a plugin with pipes on its stdin and stdout. Reads are
+// buffered; read_exact() hands large payloads straight to the caller.
+class PluginProcess {
+public:
+  explicit PluginProcess(const std::string &path,
+                         const std::vector<std::string> &args = {}) {
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES inherit{sizeof(inherit), nullptr, TRUE};
+    HANDLE child_in = nullptr;
+    HANDLE child_out = nullptr;
+    if (!CreatePipe(&child_in, &in_, &inherit, 0) ||
+        !CreatePipe(&out_, &child_out, &inherit, 1 << 20)) {
+      return;
+    }
+    SetHandleInformation(in_, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(out_, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOA startup{};
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = child_in;
+    startup.hStdOutput = child_out;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    std::string command = "\"" + path + "\"";
+    for (const std::string &arg : args) {
+      command += " " + arg;
+    }
+    PROCESS_INFORMATION info{};
+    if (CreateProcessA(nullptr, command.data(), nullptr, nullptr, TRUE,
+                       CREATE_NO_WINDOW, nullptr, nullptr, &startup, &info)) {
+      process_ = info.hProcess;
+      CloseHandle(info.hThread);
+    }
+    CloseHandle(child_in);
+    CloseHandle(child_out);
+#else
+    int to_child[2];
+    int from_child[2];
+    if (pipe(to_child) != 0 || pipe(from_child) != 0) {
+      return;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, to_child[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, from_child[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, to_child[1]);
+    posix_spawn_file_actions_addclose(&actions, from_child[0]);
+    std::vector<char *> argv = {const_cast<char *>(path.c_str())};
+    for (const std::string &arg : args) {
+      argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    if (posix_spawn(&pid_, path.c_str(), &actions, nullptr, argv.data(),
+                    environ) != 0) {
+      pid_ = -1;
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    close(to_child[0]);
+    close(from_child[1]);
+    in_ = to_child[1];
+    out_ = from_child[0];
+    signal(SIGPIPE, SIG_IGN);
+#endif
+  }
+
+  ~PluginProcess() {
+#ifdef _WIN32
+    if (in_) {
+      CloseHandle(in_);
+    }
+    if (process_) {
+      if (WaitForSingleObject(process_, 2000) == WAIT_TIMEOUT) {
+        TerminateProcess(process_, 1);
+      }
+      CloseHandle(process_);
+    }
+    if (out_) {
+      CloseHandle(out_);
+    }
+#else
+    if (in_ >= 0) {
+      close(in_);
+    }
+    if (pid_ > 0) {
+      int status = 0;
+      waitpid(pid_, &status, 0);
+    }
+    if (out_ >= 0) {
+      close(out_);
+    }
+#endif
+  }
+
+  PluginProcess(const PluginProcess &) = delete;
+  PluginProcess &operator=(const PluginProcess &) = delete;
+
+  bool running() const {
+#ifdef _WIN32
+    return process_ != nullptr;
+#else
+    return pid_ > 0;
+#endif
+  }
+
+  bool write_line(std::string line) {
+    line += '\n';
+    std::string_view rest = line;
+    while (!rest.empty()) {
+#ifdef _WIN32
+      DWORD written = 0;
+      if (!WriteFile(in_, rest.data(), static_cast<DWORD>(rest.size()),
+                     &written, nullptr)) {
+        return false;
+      }
+#else
+      ssize_t written = ::write(in_, rest.data(), rest.size());
+      if (written <= 0) {
+        return false;
+      }
+#endif
+      rest.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+  }
+
+  // The next line of output without its newline, or nullopt at end of file.
+  std::optional<std::string> read_line() {
+    std::string line;
+    for (;;) {
+      auto newline = std::find(buffer_.begin() + static_cast<long>(pos_),
+                               buffer_.end(), '\n');
+      line.append(buffer_.begin() + static_cast<long>(pos_), newline);
+      if (newline != buffer_.end()) {
+        pos_ = static_cast<size_t>(newline - buffer_.begin()) + 1;
+        return line;
+      }
+      if (!fill()) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  // Reads exactly out.size() bytes of payload.
+  bool read_exact(std::span<std::byte> out) {
+    size_t buffered = std::min(out.size(), buffer_.size() - pos_);
+    std::memcpy(out.data(), buffer_.data() + pos_, buffered);
+    pos_ += buffered;
+    out = out.subspan(buffered);
+    while (!out.empty()) {
+      size_t got = read_some(out.data(), out.size());
+      if (got == 0) {
+        return false;
+      }
+      out = out.subspan(got);
+    }
+    return true;
+  }
+
+  // The plugin's peak resident memory so far, in bytes.
+  uint64_t peak_rss() const {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(process_, &counters, sizeof(counters))) {
+      return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    std::string path = std::format("/proc/{}/status", pid_);
+    FILE *status = std::fopen(path.c_str(), "r");
+    if (status == nullptr) {
+      return 0;
+    }
+    char line[256];
+    uint64_t kib = 0;
+    while (std::fgets(line, sizeof(line), status)) {
+      if (std::strncmp(line, "VmHWM:", 6) == 0) {
+        kib = std::strtoull(line + 6, nullptr, 10);
+      }
+    }
+    std::fclose(status);
+    return kib * 1024;
+#endif
+  }
+
+private:
+  size_t read_some(void *out, size_t size) {
+#ifdef _WIN32
+    DWORD got = 0;
+    DWORD want = static_cast<DWORD>(std::min<size_t>(size, 1 << 30));
+    if (!ReadFile(out_, out, want, &got, nullptr)) {
+      return 0;
+    }
+    return got;
+#else
+    for (;;) {
+      ssize_t got = ::read(out_, out, size);
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      return got > 0 ? static_cast<size_t>(got) : 0;
+    }
+#endif
+  }
+
+  bool fill() {
+    buffer_.resize(1 << 16);
+    pos_ = 0;
+    size_t got = read_some(buffer_.data(), buffer_.size());
+    buffer_.resize(got);
+    return got > 0;
+  }
+
+#ifdef _WIN32
+  HANDLE in_ = nullptr;
+  HANDLE out_ = nullptr;
+  HANDLE process_ = nullptr;
+#else
+  int in_ = -1;
+  int out_ = -1;
+  pid_t pid_ = -1;
+#endif
+  std::vector<char> buffer_;
+  size_t pos_ = 0;
+};
+
+// Maps a shared memory response and copies it out, as the host does.
+bool read_shared(std::string_view name, size_t offset, size_t length,
+                 std::vector<std::byte> &out) {
+  out.resize(length);
+  if (length == 0) {
+    return true;
+  }
+  std::string handle(name);
+#ifdef _WIN32
+  HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, handle.c_str());
+  if (mapping == nullptr) {
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, offset + length);
+  if (view != nullptr) {
+    std::memcpy(out.data(), static_cast<std::byte *>(view) + offset, length);
+    UnmapViewOfFile(view);
+  }
+  CloseHandle(mapping);
+  return view != nullptr;
+#else
+  int fd = shm_open(handle.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  shm_unlink(handle.c_str());
+  void *view = mmap(nullptr, offset + length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (view == MAP_FAILED) {
+    return false;
+  }
+  std::memcpy(out.data(), static_cast<std::byte *>(view) + offset, length);
+  munmap(view, offset + length);
+  return true;
+#endif
+}
+
+struct Case {
+  int order = 3;
+  int series = 1;
+  std::string storage;
+  std::string transport;
+  std::string dtype;
+  std::string compression = "none";
+};
+
+struct Run {
+  uint64_t points = 0;
+  uint64_t bytes = 0;
+  double seconds = 0;
+  double first_byte_ms = 0; // Mean over the run's requests
+};
+
+// The next line that is not a log message.
+std::optional<sdk::JsonObject> read_message(PluginProcess &plugin,
+                                            std::string &line) {
+  for (;;) {
+    std::optional<std::string> next = plugin.read_line();
+    if (!next) {
+      return std::nullopt;
+    }
+    line = std::move(*next);
+    sdk::JsonObject message = sdk::JsonObject::parse(line);
+    if (message["method"].str() != "log") {
+      return message;
+    }
+  }
+}
+
+// Reads one get_series_data response, returning its payload size in bytes.
+std::optional<uint64_t> read_series(PluginProcess &plugin,
+                                    const sdk::JsonObject &header,
+                                    std::vector<std::byte> &payload) {
+  std::string_view type = header["type"].str();
+  if (type == "binary") {
+    payload.resize(header["length"].number<size_t>().value_or(0));
+    if (!plugin.read_exact(payload)) {
+      return std::nullopt;
+    }
+    return payload.size();
+  }
+  if (type == "shm") {
+    size_t length = header["length"].number<size_t>().value_or(0);
+    if (!read_shared(header["handle"].str(),
+                     header["offset"].number<size_t>().value_or(0), length,
+                     payload)) {
+      return std::nullopt;
+    }
+    return length;
+  }
+  if (type != "chunked") {
+    return std::nullopt;
+  }
+
+  uint64_t total = 0;
+  std::string line;
+  for (;;) {
+    std::optional<sdk::JsonObject> frame = read_message(plugin, line);
+    if (!frame || frame->contains("error")) {
+      return std::nullopt;
+    }
+    if ((*frame)["type"].str() == "end") {
+      return total;
+    }
+    payload.resize((*frame)["length"].number<size_t>().value_or(0));
+    if (!plugin.read_exact(payload)) {
+      return std::nullopt;
+    }
+    total += payload.size();
+  }
+}
+
+// Initializes the plugin, answering its show_form with the case's series
+// count and order. Returns false if it refused.
+bool configure(PluginProcess &plugin, const Case &c) {
+  std::string line;
+  plugin.write_line(R"({"method":"initialize","args":""})");
+  std::optional<sdk::JsonObject> reply = read_message(plugin, line);
+  if (reply && (*reply)["method"].str() == "show_form") {
+    plugin.write_line(std::format(
+        R"({{"result":{{"numSeries":{},"order":{},"multiplier":1}}}})",
+        c.series, c.order));
+    reply = read_message(plugin, line);
+  }
+  return reply && !reply->contains("error");
+}
+
+// Configures a fresh plugin for the case and times `runs` passes over its
+// series. Returns nothing if the plugin misbehaved.
+std::optional<std::vector<Run>> run_case(const std::string &path,
+                                         const Case &c, int runs,
+                                         uint64_t &peak_rss) {
+  std::vector<std::string> args;
+  if (c.compression != "none") {
+    args = {"--compression", c.compression};
+  }
+  PluginProcess plugin(path, args);
+  if (!plugin.running() || !configure(plugin, c)) {
+    return std::nullopt;
+  }
+
+  std::string line;
+  std::string options = std::format(R"(,"preferred_storage":"{}")", c.storage);
+  if (c.transport == "shm") {
+    options += R"(,"transport":"shm")";
+  }
+  if (c.dtype != "f64") {
+    options += std::format(R"(,"dtypes":["{}"])", c.dtype);
+  }
+  if (c.compression != "none") {
+    options += R"(,"compression":["shuffle-lz4"])";
+  }
+
+  uint64_t points = 1;
+  for (int i = 0; i < c.order; ++i) {
+    points *= 10;
+  }
+  points += 1;
+
+  std::vector<Run> results;
+  std::vector<std::byte> payload;
+  for (int r = 0; r < runs; ++r) {
+    Run run;
+    Clock::time_point start = Clock::now();
+    for (int s = 0; s < c.series; ++s) {
+      Clock::time_point sent = Clock::now();
+      plugin.write_line(std::format(
+          R"({{"method":"get_series_data","series_id":"series_{}"{}}})", s,
+          options));
+      std::optional<sdk::JsonObject> header = read_message(plugin, line);
+      if (!header) {
+        return std::nullopt;
+      }
+      run.first_byte_ms += seconds_since(sent) * 1e3;
+      std::optional<uint64_t> bytes = read_series(plugin, *header, payload);
+      if (!bytes) {
+        std::cerr << "bad response: " << line << '\n';
+        return std::nullopt;
+      }
+      run.bytes += *bytes;
+      run.points += points;
+    }
+    run.seconds = seconds_since(start);
+    run.first_byte_ms /= c.series;
+    results.push_back(run);
+  }
+  peak_rss = plugin.peak_rss();
+  return results;
+}
+
+struct LiveRun {
+  uint64_t points = 0;
+  uint64_t bytes = 0;
+  uint64_t frames = 0;
+  double seconds = 0;
+};
+
+// Subscribes to series_0 of a fresh plugin at `rate` points a second and
+// counts what its append frames deliver over `seconds`. Returns nothing if
+// the plugin misbehaved.
+std::optional<LiveRun> run_live_case(const std::string &path, const Case &c,
+                                     double rate, double seconds,
+                                     uint64_t &peak_rss) {
+  PluginProcess plugin(path);
+  if (!plugin.running() || !configure(plugin, c)) {
+    return std::nullopt;
+  }
+
+  std::string request = std::format(
+      R"({{"method":"subscribe_series","series_id":"series_0",)"
+      R"("preferred_storage":"{}","rate":{})",
+      c.storage, rate);
+  if (c.dtype != "f64") {
+    request += std::format(R"(,"dtypes":["{}"])", c.dtype);
+  }
+  plugin.write_line(request + "}");
+
+  LiveRun run;
+  std::string line;
+  std::vector<std::byte> payload;
+  std::optional<Clock::time_point> start;
+  bool unsubscribed = false;
+  for (;;) {
+    std::optional<sdk::JsonObject> message = read_message(plugin, line);
+    if (!message || message->contains("error")) {
+      std::cerr << "bad response: " << line << '\n';
+      return std::nullopt;
+    }
+    if ((*message)["method"].str() != "append") {
+      if (unsubscribed) {
+        break; // The reply to unsubscribe_series
+      }
+      start = Clock::now(); // The reply to subscribe_series
+      continue;
+    }
+    if ((*message)["type"].str() == "end") {
+      continue;
+    }
+    payload.resize((*message)["length"].number<size_t>().value_or(0));
+    if (!plugin.read_exact(payload)) {
+      return std::nullopt;
+    }
+    if (start && !unsubscribed) {
+      size_t width = c.dtype == "f64" ? 16 : 8;
+      run.points += payload.size() / width;
+      run.bytes += payload.size();
+      run.frames += 1;
+      run.seconds = seconds_since(*start);
+      if (run.seconds >= seconds) {
+        plugin.write_line(
+            R"({"method":"unsubscribe_series","series_id":"series_0"})");
+        unsubscribed = true;
+      }
+    }
+  }
+  peak_rss = plugin.peak_rss();
+  return run;
+}
+
+std::vector<double> parse_numbers(std::string_view text) {
+  std::vector<double> values;
+  while (!text.empty()) {
+    std::string_view item = text.substr(0, text.find(','));
+    text.remove_prefix(std::min(text.size(), item.size() + 1));
+    if (!item.empty()) {
+      values.push_back(std::atof(std::string(item).c_str()));
+    }
+  }
+  return values;
+}
+
+// Parses "3-8" or "1,5,10" into the listed integers.
+std::vector<int> parse_ints(std::string_view text) {
+  std::vector<int> values;
+  while (!text.empty()) {
+    std::string_view item = text.substr(0, text.find(','));
+    text.remove_prefix(std::min(text.size(), item.size() + 1));
+    size_t dash = item.find('-', 1);
+    int first = std::atoi(std::string(item.substr(0, dash)).c_str());
+    int last = dash == std::string_view::npos
+                   ? first
+                   : std::atoi(std::string(item.substr(dash + 1)).c_str());
+    for (int v = first; v <= last; ++v) {
+      values.push_back(v);
+    }
+  }
+  return values;
+}
+
+std::vector<std::string> parse_names(std::string_view text) {
+  std::vector<std::string> names;
+  while (!text.empty()) {
+    std::string_view item = text.substr(0, text.find(','));
+    text.remove_prefix(std::min(text.size(), item.size() + 1));
+    if (!item.empty()) {
+      names.emplace_back(item);
+    }
+  }
+  return names;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: plugin_bench <plugin> [--orders 3-8] [--series 1,10] "
+                 "[--storage interleaved,arrays] [--transport pipe,shm] "
+                 "[--dtypes f64] [--compression none,lz4] [--runs 2] "
+                 "[--live 5 --rates 1e6,1e7]\n";
+    return 2;
+  }
+  std::string plugin = argv[1];
+  std::vector<int> orders = parse_ints("3-8");
+  std::vector<int> series = parse_ints("1,10");
+  std::vector<std::string> storages = parse_names("interleaved,arrays");
+  std::vector<std::string> transports = parse_names("pipe,shm");
+  std::vector<std::string> dtypes = parse_names("f64");
+  std::vector<std::string> compressions = parse_names("none");
+  int runs = 2;
+  double live_seconds = 0;
+  std::vector<double> rates = parse_numbers("1e6,1e7");
+  for (int i = 2; i + 1 < argc; i += 2) {
+    std::string_view flag = argv[i];
+    std::string_view value = argv[i + 1];
+    if (flag == "--orders") {
+      orders = parse_ints(value);
+    } else if (flag == "--series") {
+      series = parse_ints(value);
+    } else if (flag == "--storage") {
+      storages = parse_names(value);
+    } else if (flag == "--transport") {
+      transports = parse_names(value);
+    } else if (flag == "--dtypes") {
+      dtypes = parse_names(value);
+    } else if (flag == "--compression") {
+      compressions = parse_names(value);
+    } else if (flag == "--runs") {
+      runs = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--live") {
+      live_seconds = std::atof(argv[i + 1]);
+    } else if (flag == "--rates") {
+      rates = parse_numbers(value);
+    }
+  }
+
+  std::string out = "{\"plugin\":\"";
+  sdk::detail::append_json_escaped(out, plugin);
+  out += "\",\"results\":[";
+  bool first = true;
+  int failures = 0;
+  if (live_seconds > 0) {
+    // Live appends to the first series of the smallest order
+    orders.clear();
+    for (const std::string &storage : storages) {
+      for (const std::string &dtype : dtypes) {
+        for (double rate : rates) {
+          Case c{3, 1, storage, "pipe", dtype};
+          std::cerr << std::format("live {} {} {}\n", storage, dtype, rate);
+          uint64_t peak_rss = 0;
+          std::optional<LiveRun> run =
+              run_live_case(plugin, c, rate, live_seconds, peak_rss);
+          if (!run) {
+            ++failures;
+            continue;
+          }
+          out += first ? "\n" : ",\n";
+          first = false;
+          out += std::format(
+              R"({{"live":true,"storage":"{}","dtype":"{}","rate":{},)"
+              R"("points":{},"bytes":{},"frames":{},"seconds":{:.6f},)"
+              R"("points_per_s":{:.0f},"mb_per_s":{:.1f},)"
+              R"("frames_per_s":{:.1f},"peak_rss_mb":{:.1f}}})",
+              storage, dtype, rate, run->points, run->bytes, run->frames,
+              run->seconds, static_cast<double>(run->points) / run->seconds,
+              static_cast<double>(run->bytes) / run->seconds / 1e6,
+              static_cast<double>(run->frames) / run->seconds,
+              static_cast<double>(peak_rss) / 1e6);
+        }
+      }
+    }
+  }
+  std::vector<Case> cases;
+  for (int order : orders) {
+    for (int count : series) {
+      for (const std::string &storage : storages) {
+        for (const std::string &transport : transports) {
+          for (const std::string &dtype : dtypes) {
+            for (const std::string &compression : compressions) {
+              cases.push_back(
+                  {order, count, storage, transport, dtype, compression});
+            }
+          }
+        }
+      }
+    }
+  }
+  for (const Case &c : cases) {
+    std::cerr << std::format("order {} series {} {} {} {} {}\n", c.order,
+                             c.series, c.storage, c.transport, c.dtype,
+                             c.compression);
+    uint64_t peak_rss = 0;
+    std::optional<std::vector<Run>> result =
+        run_case(plugin, c, runs, peak_rss);
+    if (!result) {
+      ++failures;
+      continue;
+    }
+    for (size_t r = 0; r < result->size(); ++r) {
+      const Run &run = (*result)[r];
+      out += first ? "\n" : ",\n";
+      first = false;
+      out += std::format(
+          R"({{"order":{},"series":{},"storage":"{}","transport":"{}",)"
+          R"("dtype":"{}","compression":"{}","run":{},"cold":{},)"
+          R"("points":{},"bytes":{},"seconds":{:.6f},)"
+          R"("points_per_s":{:.0f},"mb_per_s":{:.1f},)"
+          R"("first_byte_ms":{:.3f},"peak_rss_mb":{:.1f}}})",
+          c.order, c.series, c.storage, c.transport, c.dtype, c.compression,
+          r, r == 0 ? "true" : "false", run.points, run.bytes, run.seconds,
+          static_cast<double>(run.points) / run.seconds,
+          static_cast<double>(run.bytes) / run.seconds / 1e6,
+          run.first_byte_ms, static_cast<double>(peak_rss) / 1e6);
+    }
+  }
+  out += "\n]}\n";
+  std::cout << out;
+  return failures == 0 ? 0 : 1;
+}
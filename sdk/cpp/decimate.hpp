@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace sdk {
+
+// M4Decimator reduces a stream of points to at most four per pixel column:
+// the first, last, minimum and maximum point of the column, in their original
+// order. A line drawn through the reduced series at that width is visually
+// identical to one drawn through the full series, so the transfer size
+// follows the screen resolution instead of the data size.
+//
+// Points must arrive in non-decreasing x order.
+class M4Decimator {
+public:
+  // Buckets points into equal-width columns over [x_min, x_max]. Points
+  // outside the range are dropped except the nearest one on each side, so
+  // lines still run to the edges of the view.
+  M4Decimator(size_t buckets, double x_min, double x_max)
+      : buckets_(std::max<size_t>(buckets, 1)), by_range_(true), x_min_(x_min),
+        x_max_(x_max) {}
+
+  // Buckets points by index, for when the x range is not known up front.
+  static M4Decimator by_index(size_t buckets, size_t total_points) {
+    M4Decimator d(buckets, 0, 0);
+    d.by_range_ = false;
+    d.total_points_ = std::max<size_t>(total_points, 1);
+    return d;
+  }
+
+  // Adds a point. Returns false once a point past x_max has been seen; all
+  // later points are ignored, so producers can stop early.
+  bool push(double x, double y) {
+    if (done_) {
+      return false;
+    }
+    Sample s{x, y, seq_++};
+
+    if (by_range_) {
+      if (x < x_min_) {
+        before_ = s;
+        has_before_ = true;
+        return true;
+      }
+      if (x > x_max_) {
+        flush_bucket();
+        append(s);
+        done_ = true;
+        return false;
+      }
+      if (has_before_) {
+        append(before_);
+        has_before_ = false;
+      }
+    }
+
+    size_t bucket = bucket_of(s);
+    if (!has_bucket_ || bucket != bucket_) {
+      flush_bucket();
+      bucket_ = bucket;
+      has_bucket_ = true;
+      first_ = last_ = min_ = max_ = s;
+      return true;
+    }
+
+    last_ = s;
+    if (y < min_.y) {
+      min_ = s;
+    }
+    if (y > max_.y) {
+      max_ = s;
+    }
+    return true;
+  }
+
+  // Adds interleaved [x, y] pairs. Returns false once the range is passed.
+  bool push(std::span<const double> interleaved) {
+    for (size_t i = 0; i + 1 < interleaved.size(); i += 2) {
+      if (!push(interleaved[i], interleaved[i + 1])) {
+        return false;
+      }
+    }
+    return !done_;
+  }
+
+  // Flushes the last column. Call once after the final point.
+  void finish() {
+    flush_bucket();
+    if (has_before_) {
+      // The whole series lies left of the view; keep its last point.
+      append(before_);
+      has_before_ = false;
+    }
+    done_ = true;
+  }
+
+  bool done() const { return done_; }
+
+  // The pixel column a point at x falls in, for decimators bucketing by
+  // range. Points outside the range are clamped to the edge columns.
+  size_t column_of(double x) const {
+    double span = x_max_ - x_min_;
+    if (!(span > 0)) {
+      return 0;
+    }
+    double pos = (x - x_min_) / span * static_cast<double>(buckets_);
+    return std::min(static_cast<size_t>(std::max(pos, 0.0)), buckets_ - 1);
+  }
+
+  std::span<const double> x() const { return xs_; }
+  std::span<const double> y() const { return ys_; }
+  size_t size() const { return xs_.size(); }
+
+  // Returns the reduced series as interleaved [x, y] pairs.
+  std::vector<double> interleaved() const {
+    std::vector<double> out(xs_.size() * 2);
+    for (size_t i = 0; i < xs_.size(); ++i) {
+      out[i * 2] = xs_[i];
+      out[i * 2 + 1] = ys_[i];
+    }
+    return out;
+  }
+
+private:
+  struct Sample {
+    double x = 0;
+    double y = 0;
+    size_t seq = 0;
+  };
+
+  size_t bucket_of(const Sample &s) const {
+    if (!by_range_) {
+      return std::min(s.seq * buckets_ / total_points_, buckets_ - 1);
+    }
+    return column_of(s.x);
+  }
+
+  void append(const Sample &s) {
+    xs_.push_back(s.x);
+    ys_.push_back(s.y);
+  }
+
+  // Emits the current column's distinct extreme points in arrival order.
+  void flush_bucket() {
+    if (!has_bucket_) {
+      return;
+    }
+    has_bucket_ = false;
+
+    Sample picks[4] = {first_, min_, max_, last_};
+    std::sort(std::begin(picks), std::end(picks),
+              [](const Sample &a, const Sample &b) { return a.seq < b.seq; });
+    for (size_t i = 0; i < 4; ++i) {
+      if (i == 0 || picks[i].seq != picks[i - 1].seq) {
+        append(picks[i]);
+      }
+    }
+  }
+
+  size_t buckets_;
+  bool by_range_;
+  double x_min_;
+  double x_max_;
+  size_t total_points_ = 0;
+
+  size_t seq_ = 0;
+  bool done_ = false;
+  bool has_before_ = false;
+  Sample before_;
+
+  bool has_bucket_ = false;
+  size_t bucket_ = 0;
+  Sample first_, last_, min_, max_;
+
+  std::vector<double> xs_;
+  std::vector<double> ys_;
+};
+
+} // namespace sdk
@@ -0,0 +1,448 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace sdk {
+
+enum class JsonType { Invalid, Null, Bool, Number, String, Array, Object };
+
+class JsonObject;
+
+namespace detail {
+
+// Single-pass scanner over a JSON text. It only finds where values begin and
+// end; numbers, strings and nested containers are decoded on demand.
+class JsonCursor {
+public:
+  explicit JsonCursor(std::string_view text) : text_(text) {}
+
+  void skip_space() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' ||
+            text_[pos_] == '\r')) {
+      ++pos_;
+    }
+  }
+
+  // Skips whitespace, then consumes c if it is the next character.
+  bool consume(char c) {
+    skip_space();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  // Scans the value at the cursor. Strings yield their contents without the
+  // quotes, escapes left in place; everything else yields its text.
+  JsonType scan(std::string_view &raw) {
+    skip_space();
+    if (pos_ >= text_.size()) {
+      return JsonType::Invalid;
+    }
+    size_t start = pos_;
+    char c = text_[pos_];
+    if (c == '"') {
+      if (!skip_string()) {
+        return JsonType::Invalid;
+      }
+      raw = text_.substr(start + 1, pos_ - start - 2);
+      return JsonType::String;
+    }
+
+    JsonType type = JsonType::Invalid;
+    if (c == '{' || c == '[') {
+      type = skip_container() ? (c == '{' ? JsonType::Object : JsonType::Array)
+                              : JsonType::Invalid;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+      while (pos_ < text_.size() && is_number_char(text_[pos_])) {
+        ++pos_;
+      }
+      type = JsonType::Number;
+    } else if (skip_literal("true") || skip_literal("false")) {
+      type = JsonType::Bool;
+    } else if (skip_literal("null")) {
+      type = JsonType::Null;
+    }
+    raw = text_.substr(start, pos_ - start);
+    return type;
+  }
+
+private:
+  static bool is_number_char(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
+  }
+
+  bool skip_literal(std::string_view literal) {
+    if (text_.substr(pos_, literal.size()) != literal) {
+      return false;
+    }
+    pos_ += literal.size();
+    return true;
+  }
+
+  // Moves past the string starting at the cursor's opening quote.
+  bool skip_string() {
+    for (++pos_; pos_ < text_.size(); ++pos_) {
+      if (text_[pos_] == '\\') {
+        ++pos_;
+      } else if (text_[pos_] == '"') {
+        ++pos_;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Moves past the object or array starting at the cursor, matching brackets
+  // without decoding what is inside.
+  bool skip_container() {
+    size_t depth = 0;
+    while (pos_ < text_.size()) {
+      char c = text_[pos_];
+      if (c == '"') {
+        if (!skip_string()) {
+          return false;
+        }
+        continue;
+      }
+      ++pos_;
+      if (c == '{' || c == '[') {
+        ++depth;
+      } else if ((c == '}' || c == ']') && --depth == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::string_view text_;
+  size_t pos_ = 0;
+};
+
+inline void append_utf8(std::string &out, uint32_t code) {
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xC0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    out += static_cast<char>(0xE0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (code >> 18));
+    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+// Appends text as the contents of a JSON string, escaping quotes, backslashes
+// and control characters. Runs of plain characters are copied in one go.
+inline void append_json_escaped(std::string &out, std::string_view text) {
+  constexpr char kHex[] = "0123456789abcdef";
+  size_t run = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    auto c = static_cast<unsigned char>(text[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out.append(text, run, i - run);
+    run = i + 1;
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      out += "\\u00";
+      out += kHex[c >> 4];
+      out += kHex[c & 0xF];
+    }
+  }
+  out.append(text, run);
+}
+
+} // namespace detail
+
+// Returns text as a quoted JSON string, for building messages by hand.
+inline std::string json_quoted(std::string_view text) {
+  std::string out = "\"";
+  detail::append_json_escaped(out, text);
+  out += '"';
+  return out;
+}
+
+// JsonValue is a view of one value inside a parsed message. It does not own
+// the text, which must outlive it. A missing member is an Invalid value, so
+// lookups can be chained and tested at the end.
+class JsonValue {
+public:
+  JsonValue() = default;
+  JsonValue(JsonType type, std::string_view raw) : type_(type), raw_(raw) {}
+
+  JsonType type() const { return type_; }
+  explicit operator bool() const { return type_ != JsonType::Invalid; }
+
+  bool is_null() const { return type_ == JsonType::Null; }
+  bool is_string() const { return type_ == JsonType::String; }
+  bool is_number() const { return type_ == JsonType::Number; }
+
+  // The value's text as it appears in the message. For strings this is the
+  // contents between the quotes, with escapes left in place.
+  std::string_view raw() const { return raw_; }
+
+  // The contents of a string value with escapes left in place, or fallback
+  // for any other type, for names such as a storage layout that never need
+  // unescaping. Text sent back to the host, such as a series id, should be
+  // unescaped() so that escaping it again reproduces it.
+  std::string_view str(std::string_view fallback = {}) const {
+    return is_string() ? raw_ : fallback;
+  }
+
+  // The contents of a string value with its escapes decoded.
+  std::string unescaped() const {
+    std::string out;
+    if (!is_string()) {
+      return out;
+    }
+    out.reserve(raw_.size());
+    for (size_t i = 0; i < raw_.size(); ++i) {
+      if (raw_[i] != '\\' || i + 1 == raw_.size()) {
+        out += raw_[i];
+        continue;
+      }
+      switch (char c = raw_[++i]) {
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        uint32_t code = 0;
+        if (!hex4(i + 1, code)) {
+          return out;
+        }
+        i += 4;
+        // Combine a UTF-16 surrogate pair into one code point
+        uint32_t low = 0;
+        if (code >= 0xD800 && code < 0xDC00 && raw_.substr(i + 1, 2) == "\\u" &&
+            hex4(i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          i += 6;
+        }
+        detail::append_utf8(out, code);
+        break;
+      }
+      default:
+        out += c;
+      }
+    }
+    return out;
+  }
+
+  // The value of a number as T, or nullopt if it is not a number or does not
+  // fit. Integer types also accept integral values written as 5.0 or 1e3.
+  template <typename T = double> std::optional<T> number() const {
+    if (!is_number()) {
+      return std::nullopt;
+    }
+    const char *first = raw_.data();
+    const char *last = first + raw_.size();
+    T value{};
+    auto [end, ec] = std::from_chars(first, last, value);
+    if (ec == std::errc{} && end == last) {
+      return value;
+    }
+    if constexpr (std::is_integral_v<T>) {
+      double real = 0;
+      auto [real_end, real_ec] = std::from_chars(first, last, real);
+      if (real_ec == std::errc{} && real_end == last &&
+          std::trunc(real) == real &&
+          real >= static_cast<double>(std::numeric_limits<T>::lowest()) &&
+          real <= static_cast<double>(std::numeric_limits<T>::max())) {
+        return static_cast<T>(real);
+      }
+    }
+    return std::nullopt;
+  }
+
+  std::optional<bool> boolean() const {
+    if (type_ != JsonType::Bool) {
+      return std::nullopt;
+    }
+    return raw_ == "true";
+  }
+
+  // Parses an object value. Any other type gives an invalid, empty object.
+  JsonObject object() const;
+
+  // Calls fn(JsonValue) for each element of an array value. Returns false if
+  // the value is not a well-formed array.
+  template <typename Fn> bool for_each(Fn &&fn) const {
+    if (type_ != JsonType::Array) {
+      return false;
+    }
+    detail::JsonCursor cursor(raw_);
+    cursor.consume('[');
+    if (cursor.consume(']')) {
+      return true;
+    }
+    do {
+      std::string_view raw;
+      JsonType type = cursor.scan(raw);
+      if (type == JsonType::Invalid) {
+        return false;
+      }
+      fn(JsonValue(type, raw));
+    } while (cursor.consume(','));
+    return cursor.consume(']');
+  }
+
+  // The string elements of an array value, e.g. "series_ids":["a","b"].
+  std::vector<std::string_view> strings() const {
+    std::vector<std::string_view> values;
+    for_each([&](JsonValue element) {
+      if (element.is_string()) {
+        values.push_back(element.raw());
+      }
+    });
+    return values;
+  }
+
+  // The string elements of an array value with their escapes decoded.
+  std::vector<std::string> unescaped_strings() const {
+    std::vector<std::string> values;
+    for_each([&](JsonValue element) {
+      if (element.is_string()) {
+        values.push_back(element.unescaped());
+      }
+    });
+    return values;
+  }
+
+private:
+  bool hex4(size_t pos, uint32_t &code) const {
+    if (pos + 4 > raw_.size()) {
+      return false;
+    }
+    auto [end, ec] =
+        std::from_chars(raw_.data() + pos, raw_.data() + pos + 4, code, 16);
+    return ec == std::errc{} && end == raw_.data() + pos + 4;
+  }
+
+  JsonType type_ = JsonType::Invalid;
+  std::string_view raw_;
+};
+
+// JsonObject is a JSON object parsed in one pass into views of its top-level
+// members, without allocating. Nested objects and arrays are kept as text and
+// parsed when asked for. Keys are compared as written, escapes included.
+class JsonObject {
+public:
+  // Members past this many are ignored. Host messages have far fewer.
+  static constexpr size_t kMaxMembers = 32;
+
+  struct Member {
+    std::string_view key;
+    JsonValue value;
+  };
+
+  JsonObject() = default;
+
+  // Parses text as an object. Check valid() for malformed input.
+  static JsonObject parse(std::string_view text) {
+    JsonObject object;
+    detail::JsonCursor cursor(text);
+    if (!cursor.consume('{')) {
+      return object;
+    }
+    if (cursor.consume('}')) {
+      object.valid_ = true;
+      return object;
+    }
+    do {
+      std::string_view key;
+      std::string_view raw;
+      if (cursor.scan(key) != JsonType::String || !cursor.consume(':')) {
+        return {};
+      }
+      JsonType type = cursor.scan(raw);
+      if (type == JsonType::Invalid) {
+        return {};
+      }
+      if (object.count_ < kMaxMembers) {
+        object.members_[object.count_++] = {key, JsonValue(type, raw)};
+      }
+    } while (cursor.consume(','));
+    object.valid_ = cursor.consume('}');
+    return object;
+  }
+
+  bool valid() const { return valid_; }
+  size_t size() const { return count_; }
+  bool contains(std::string_view key) const {
+    return static_cast<bool>((*this)[key]);
+  }
+
+  std::span<const Member> members() const {
+    return std::span(members_).first(count_);
+  }
+
+  // The member with this key (the last one if repeated), or an Invalid
+  // value if there is none.
+  JsonValue operator[](std::string_view key) const {
+    for (size_t i = count_; i-- > 0;) {
+      if (members_[i].key == key) {
+        return members_[i].value;
+      }
+    }
+    return {};
+  }
+
+private:
+  std::array<Member, kMaxMembers> members_{};
+  size_t count_ = 0;
+  bool valid_ = false;
+};
+
+inline JsonObject JsonValue::object() const {
+  return type_ == JsonType::Object ? JsonObject::parse(raw_) : JsonObject();
+}
+
+} // namespace sdk
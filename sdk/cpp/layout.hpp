@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace sdk {
+
+// How a block of points is laid out: [x0, y0, x1, y1, ...] or every x
+// followed by every y. These are the protocol's "interleaved" and "arrays"
+// storage values.
+enum class Layout { Interleaved, Arrays };
+
+inline Layout parse_layout(std::string_view storage) {
+  return storage == "arrays" ? Layout::Arrays : Layout::Interleaved;
+}
+
+constexpr std::string_view layout_name(Layout layout) {
+  return layout == Layout::Arrays ? "arrays" : "interleaved";
+}
+
+template <Layout L> using LayoutTag = std::integral_constant<Layout, L>;
+
+// Calls fn(LayoutTag<L>{}) for the layout picked at run time, so code
+// templated on the layout is chosen once per request rather than branching
+// per point:
+//   sdk::with_layout(layout, [&](auto tag) {
+//     fill<decltype(tag)::value>(...);
+//   });
+template <typename Fn> decltype(auto) with_layout(Layout layout, Fn &&fn) {
+  if (layout == Layout::Arrays) {
+    return fn(LayoutTag<Layout::Arrays>{});
+  }
+  return fn(LayoutTag<Layout::Interleaved>{});
+}
+
+// Samples is a view of `count` points of type T laid out as L. Every x and y
+// is at a compile-time stride from the last, so loops over it compile to the
+// same code as hand-written ones for that layout.
+template <Layout L, typename T = double> struct Samples {
+  static constexpr size_t kStride = L == Layout::Interleaved ? 2 : 1;
+
+  T *xs = nullptr;
+  T *ys = nullptr;
+  size_t count = 0;
+
+  // The points of a contiguous block of 2 * count values laid out as L.
+  static Samples of(T *data, size_t count) {
+    return {data, data + (L == Layout::Interleaved ? 1 : count), count};
+  }
+
+  size_t size() const { return count; }
+
+  T &x(size_t i) const { return xs[i * kStride]; }
+  T &y(size_t i) const { return ys[i * kStride]; }
+
+  template <typename V> void set(size_t i, V x_value, V y_value) const {
+    x(i) = static_cast<T>(x_value);
+    y(i) = static_cast<T>(y_value);
+  }
+
+  Samples subspan(size_t first, size_t n) const {
+    return {xs + first * kStride, ys + first * kStride, n};
+  }
+
+  // The points as the protocol sends them: interleaved pairs, or the x and
+  // y columns.
+  std::span<T> interleaved() const
+    requires(L == Layout::Interleaved)
+  {
+    return {xs, count * 2};
+  }
+  std::span<T> x_column() const
+    requires(L == Layout::Arrays)
+  {
+    return {xs, count};
+  }
+  std::span<T> y_column() const
+    requires(L == Layout::Arrays)
+  {
+    return {ys, count};
+  }
+
+  operator Samples<L, const T>() const
+    requires(!std::is_const_v<T>)
+  {
+    return {xs, ys, count};
+  }
+};
+
+} // namespace sdk
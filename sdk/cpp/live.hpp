@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "arena.hpp"
+#include "layout.hpp"
+#include "protocol.hpp"
+
+namespace sdk {
+
+// Sends points appended to a live series as one
+// {"method":"append","type":"binary",...} frame, laid out as `storage` in the
+// given encoding. Append frames are sent unprompted, from any thread, and may
+// fall between the frames of other responses. An empty frame tells the host
+// the series is still live.
+inline void append_frame(std::span<const double> x, std::span<const double> y,
+                         std::string_view storage, const Encoding &encoding,
+                         std::string_view series_id) {
+  std::string fields = ",\"method\":\"append\"" + detail::series_tag(series_id);
+  detail::send_encoded(x, y, storage, encoding, fields);
+}
+
+// Tells the host a live series will get no more appends, after its last
+// frame.
+inline void append_end(std::string_view series_id) {
+  send_response("{{\"method\":\"append\",\"type\":\"end\"{}}}",
+                detail::series_tag(series_id));
+}
+
+// AppendWriter coalesces the points a live series grows by into append
+// frames: points are buffered until max_points have piled up or the oldest
+// has waited max_delay, so the host gets few large frames at high rates and
+// prompt ones at low rates. The destructor sends what is left, followed by
+// the end of the series.
+//
+// Filling the buffer only checks its size; call poll() regularly, e.g. once
+// per production step, to send points that are due and an empty frame when
+// the series has been quiet for max_delay.
+class AppendWriter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kDefaultMaxPoints = kDefaultChunkPoints;
+  static constexpr Clock::duration kDefaultMaxDelay =
+      std::chrono::milliseconds(50);
+
+  AppendWriter(std::string series_id, std::string_view storage,
+               DType dtype = DType::F64,
+               size_t max_points = kDefaultMaxPoints,
+               Clock::duration max_delay = kDefaultMaxDelay)
+      : series_id_(std::move(series_id)),
+        storage_(layout_name(parse_layout(storage))), dtype_(dtype),
+        max_points_(std::max<size_t>(max_points, 1)), max_delay_(max_delay),
+        last_sent_(Clock::now()) {
+    xs_.reserve(max_points_);
+    ys_.reserve(max_points_);
+  }
+
+  AppendWriter(const AppendWriter &) = delete;
+  AppendWriter &operator=(const AppendWriter &) = delete;
+
+  ~AppendWriter() { finish(); }
+
+  void push(double x, double y) {
+    start_batch(1);
+    xs_.push_back(x);
+    ys_.push_back(y);
+    if (xs_.size() >= max_points_) {
+      flush();
+    }
+  }
+
+  // Appends `points` points for the caller to fill, as views of the
+  // buffered x and y columns, so a generator can write them in place. They
+  // are sent by the next poll() or flush().
+  Samples<Layout::Arrays> extend(size_t points) {
+    start_batch(points);
+    size_t size = xs_.size();
+    xs_.resize_for_overwrite(size + points);
+    ys_.resize_for_overwrite(size + points);
+    return {xs_.data() + size, ys_.data() + size, points};
+  }
+
+  template <Layout L> void write(const Samples<L, const double> &points) {
+    Samples<Layout::Arrays> out = extend(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+      out.set(i, points.x(i), points.y(i));
+    }
+    poll();
+  }
+
+  // Points buffered and not yet sent.
+  size_t size() const { return xs_.size(); }
+
+  // Points a frame holds before it is sent regardless of its age.
+  size_t max_points() const { return max_points_; }
+
+  // Sends the buffered points once enough have piled up or the oldest is
+  // due, or an empty frame if nothing was sent for max_delay.
+  void poll() {
+    Clock::time_point now = Clock::now();
+    if (xs_.size() >= max_points_ ||
+        (!xs_.empty() && now - oldest_ >= max_delay_) ||
+        (xs_.empty() && now - last_sent_ >= max_delay_)) {
+      flush();
+    }
+  }
+
+  // Sends the buffered points now.
+  void flush() {
+    Encoding encoding = Encoding::fit(dtype_, xs_, ys_);
+    append_frame(xs_, ys_, storage_, encoding, series_id_);
+    xs_.clear();
+    ys_.clear();
+    last_sent_ = Clock::now();
+  }
+
+  // Sends the buffered points and ends the series. Nothing may be appended
+  // afterwards.
+  void finish() {
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    if (!xs_.empty()) {
+      flush();
+    }
+    append_end(series_id_);
+  }
+
+private:
+  void start_batch(size_t points) {
+    if (xs_.empty() && points > 0) {
+      oldest_ = Clock::now();
+    }
+  }
+
+  std::string series_id_;
+  std::string_view storage_;
+  DType dtype_;
+  size_t max_points_;
+  Clock::duration max_delay_;
+  Clock::time_point oldest_;
+  Clock::time_point last_sent_;
+  bool finished_ = false;
+  ArenaVector<double> xs_;
+  ArenaVector<double> ys_;
+};
+
+// LiveFeeds runs the producers of a plugin's live series, one thread per
+// subscribed series. A producer appends to its series until its stop token
+// fires and then ends it, typically by letting its AppendWriter go out of
+// scope. The destructor stops every feed; declare LiveFeeds ahead of the
+// PluginRuntime it serves so feeds end before static objects are destroyed.
+class LiveFeeds {
+public:
+  using Feed = std::function<void(std::stop_token stop)>;
+
+  ~LiveFeeds() { stop_all(); }
+
+  // Starts feed for a series, stopping the one it replaces.
+  void start(std::string series_id, Feed feed) {
+    std::lock_guard lock(mutex_);
+    feeds_.erase(series_id);
+    feeds_.emplace(std::move(series_id), std::jthread(std::move(feed)));
+  }
+
+  // Stops the series' feed and waits for it to end. Returns false if it has
+  // none.
+  bool stop(std::string_view series_id) {
+    std::lock_guard lock(mutex_);
+    auto it = feeds_.find(series_id);
+    if (it == feeds_.end()) {
+      return false;
+    }
+    feeds_.erase(it);
+    return true;
+  }
+
+  // Stops every feed, e.g. when the configuration they were started with
+  // changes.
+  void stop_all() {
+    std::lock_guard lock(mutex_);
+    feeds_.clear();
+  }
+
+private:
+  std::mutex mutex_;
+  std::map<std::string, std::jthread, std::less<>> feeds_;
+};
+
+} // namespace sdk
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace sdk {
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error };
+
+inline std::string_view log_level_name(LogLevel level) {
+  switch (level) {
+  case LogLevel::Debug:
+    return "debug";
+  case LogLevel::Warn:
+    return "warn";
+  case LogLevel::Error:
+    return "error";
+  default:
+    return "info";
+  }
+}
+
+// Parses a host log level name. Unknown names give Info, as on the host.
+inline LogLevel parse_log_level(std::string_view name) {
+  if (name == "debug") {
+    return LogLevel::Debug;
+  }
+  if (name == "warn") {
+    return LogLevel::Warn;
+  }
+  if (name == "error") {
+    return LogLevel::Error;
+  }
+  return LogLevel::Info;
+}
+
+namespace detail {
+
+// LogQueue is an unbounded multi-producer, single-consumer queue of log
+// messages (Vyukov's intrusive list). push() is one atomic exchange, so
+// worker threads never wait on each other or on a frame being written. The
+// consumer is whoever holds the output mutex: it drains the queue into the
+// output between frames.
+class LogQueue {
+public:
+  struct Message {
+    LogLevel level = LogLevel::Info;
+    std::string text;
+  };
+
+  LogQueue() = default;
+  ~LogQueue() {
+    drain([](const Message &) {});
+  }
+
+  LogQueue(const LogQueue &) = delete;
+  LogQueue &operator=(const LogQueue &) = delete;
+
+  void push(LogLevel level, std::string_view text) {
+    auto *node = new Node{{}, {level, std::string(text)}};
+    link(node);
+  }
+
+  // Calls fn(const Message &) for each message in push order. A message
+  // whose producer is still linking it is left for the next drain. Only one
+  // thread may drain at a time.
+  template <typename Fn> void drain(Fn &&fn) {
+    for (;;) {
+      Node *tail = tail_;
+      Node *next = tail->next.load(std::memory_order_acquire);
+      if (tail == &stub_) {
+        if (next == nullptr) {
+          return;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+      }
+      if (next == nullptr) {
+        if (tail != head_.load(std::memory_order_acquire)) {
+          return;
+        }
+        // Re-insert the stub so the last message can be taken off
+        link(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+          return;
+        }
+      }
+      tail_ = next;
+      fn(std::as_const(tail->message));
+      delete tail;
+    }
+  }
+
+private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    Message message;
+  };
+
+  void link(Node *node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+  }
+
+  Node stub_;
+  std::atomic<Node *> head_{&stub_};
+  Node *tail_ = &stub_;
+};
+
+// LogLimiter caps the log lines accepted per second and counts the ones it
+// turns away, so a runaway loop cannot flood the pipe.
+class LogLimiter {
+public:
+  static constexpr uint32_t kLinesPerSecond = 1000;
+
+  bool allow() {
+    auto second = static_cast<int64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+    int64_t window = window_.load(std::memory_order_relaxed);
+    if (second != window &&
+        window_.compare_exchange_strong(window, second,
+                                        std::memory_order_relaxed)) {
+      count_.store(0, std::memory_order_relaxed);
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < kLinesPerSecond) {
+      return true;
+    }
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // The number of lines turned away since the last call.
+  uint64_t take_dropped() {
+    return dropped_.exchange(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> window_{0};
+  std::atomic<uint32_t> count_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+struct LogChannel {
+  LogQueue queue;
+  LogLimiter limiter;
+  std::atomic<LogLevel> min_level{LogLevel::Debug};
+};
+
+inline LogChannel &log_channel() {
+  static LogChannel channel;
+  return channel;
+}
+
+} // namespace detail
+
+// Drops log messages below level from now on. The runtime applies the
+// "log_level" the host sends with its requests.
+inline void set_log_level(LogLevel level) {
+  detail::log_channel().min_level.store(level, std::memory_order_relaxed);
+}
+
+inline bool log_enabled(LogLevel level) {
+  return level >=
+         detail::log_channel().min_level.load(std::memory_order_relaxed);
+}
+
+} // namespace sdk
@@ -0,0 +1,463 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "layout.hpp"
+#include "platform.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace sdk {
+
+namespace detail {
+
+// A whole file mapped into memory, read-only or for writing.
+class MappedFile {
+public:
+  MappedFile() = default;
+
+  // Maps an existing file read-only. Check valid() afterwards.
+  static MappedFile open(const std::filesystem::path &path) {
+    MappedFile file;
+#ifdef _WIN32
+    file.file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                             nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+    LARGE_INTEGER size{};
+    if (file.file_ == INVALID_HANDLE_VALUE ||
+        !GetFileSizeEx(file.file_, &size) || size.QuadPart == 0) {
+      file.close();
+      return file;
+    }
+    file.map(static_cast<size_t>(size.QuadPart), false);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info{};
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+      file.map(fd, static_cast<size_t>(info.st_size), false);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+#endif
+    return file;
+  }
+
+  // Creates or truncates a file of `bytes` bytes, with its disk space
+  // allocated up front, and maps it for writing. Check valid() afterwards.
+  static MappedFile create(const std::filesystem::path &path, size_t bytes) {
+    MappedFile file;
+#ifdef _WIN32
+    file.file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                             nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+    LARGE_INTEGER size{};
+    size.QuadPart = static_cast<LONGLONG>(bytes);
+    if (file.file_ == INVALID_HANDLE_VALUE ||
+        !SetFilePointerEx(file.file_, size, nullptr, FILE_BEGIN) ||
+        !SetEndOfFile(file.file_)) {
+      file.close();
+      return file;
+    }
+    file.map(bytes, true);
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return file;
+    }
+    // A sparse file would fault with SIGBUS once the disk fills up
+#ifdef __linux__
+    bool sized = posix_fallocate(fd, 0, static_cast<off_t>(bytes)) == 0;
+#else
+    bool sized = ftruncate(fd, static_cast<off_t>(bytes)) == 0;
+#endif
+    if (sized) {
+      file.map(fd, bytes, true);
+    }
+    ::close(fd);
+#endif
+    return file;
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept { swap(other); }
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      swap(other);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { close(); }
+
+  bool valid() const { return data_ != nullptr; }
+  std::byte *data() const { return static_cast<std::byte *>(data_); }
+  size_t size() const { return size_; }
+
+  // Writes dirty pages back to the disk, waiting until they are there.
+  bool flush() {
+    if (data_ == nullptr) {
+      return false;
+    }
+#ifdef _WIN32
+    return FlushViewOfFile(data_, 0) && FlushFileBuffers(file_);
+#else
+    return msync(data_, size_, MS_SYNC) == 0;
+#endif
+  }
+
+  void close() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+      UnmapViewOfFile(data_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+      file_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data_ != nullptr) {
+      munmap(data_, size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+private:
+#ifdef _WIN32
+  void map(size_t bytes, bool writable) {
+    HANDLE mapping = CreateFileMappingW(
+        file_, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0,
+        nullptr);
+    if (mapping != nullptr) {
+      data_ = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                            0, 0, bytes);
+      // The view keeps the mapping alive
+      CloseHandle(mapping);
+    }
+    if (data_ == nullptr) {
+      close();
+      return;
+    }
+    size_ = bytes;
+  }
+#else
+  void map(int fd, size_t bytes, bool writable) {
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *data = mmap(nullptr, bytes, protection, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      data_ = data;
+      size_ = bytes;
+    }
+  }
+#endif
+
+  void swap(MappedFile &other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+#ifdef _WIN32
+    std::swap(file_, other.file_);
+#endif
+  }
+
+  void *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+#endif
+};
+
+// The index at the start of a store file. The x column follows at
+// kStoreDataOffset and the y column right after it, `points` doubles each.
+struct StoreHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t data_offset;
+  uint64_t key;      // Identifies what was generated, see MappedSeriesStore
+  uint64_t points;
+  uint64_t complete; // Written last, once both columns are filled
+};
+
+inline constexpr char kStoreMagic[8] = {'O', 'L', 'C', 'P', 'S', 'E', 'R', 'S'};
+inline constexpr uint32_t kStoreVersion = 1;
+// A page, so both columns start page-aligned
+inline constexpr size_t kStoreDataOffset = 4096;
+
+static_assert(sizeof(StoreHeader) <= kStoreDataOffset);
+
+} // namespace detail
+
+// MappedSeries is a complete series read back from a MappedSeriesStore. Its
+// columns are views of the mapped file, so only the pages a request touches
+// are read from disk and the page cache holds the working set.
+class MappedSeries {
+public:
+  explicit MappedSeries(detail::MappedFile file) : file_(std::move(file)) {
+    detail::StoreHeader header;
+    std::memcpy(&header, file_.data(), sizeof(header));
+    points_ = header.points;
+  }
+
+  std::span<const double> x() const {
+    return {reinterpret_cast<const double *>(file_.data() +
+                                             detail::kStoreDataOffset),
+            points_};
+  }
+  std::span<const double> y() const { return {x().data() + points_, points_}; }
+  size_t size() const { return points_; }
+
+private:
+  detail::MappedFile file_;
+  size_t points_ = 0;
+};
+
+// MappedSeriesWriter fills a new store file. Points are appended in order
+// and the file only becomes visible to MappedSeriesStore::open() once
+// commit() has written all of them; a writer destroyed first deletes it.
+class MappedSeriesWriter {
+public:
+  MappedSeriesWriter(detail::MappedFile file, std::filesystem::path temp_path,
+                     std::filesystem::path path, size_t points)
+      : file_(std::move(file)), temp_path_(std::move(temp_path)),
+        path_(std::move(path)), points_(points) {}
+
+  MappedSeriesWriter(MappedSeriesWriter &&other) noexcept
+      : file_(std::move(other.file_)),
+        temp_path_(std::exchange(other.temp_path_, {})),
+        path_(std::move(other.path_)), points_(other.points_),
+        written_(other.written_) {}
+  MappedSeriesWriter &operator=(MappedSeriesWriter &&other) noexcept {
+    if (this != &other) {
+      discard();
+      file_ = std::move(other.file_);
+      temp_path_ = std::exchange(other.temp_path_, {});
+      path_ = std::move(other.path_);
+      points_ = other.points_;
+      written_ = other.written_;
+    }
+    return *this;
+  }
+
+  ~MappedSeriesWriter() { discard(); }
+
+  size_t size() const { return written_; }
+
+  // Appends points given as x and y columns of equal length. Points past
+  // the size the file was created with are dropped.
+  void append(std::span<const double> x, std::span<const double> y) {
+    size_t n = std::min({x.size(), y.size(), points_ - written_});
+    std::ranges::copy(x.first(n), xs() + written_);
+    std::ranges::copy(y.first(n), ys() + written_);
+    written_ += n;
+  }
+
+  template <Layout L> void append(const Samples<L, const double> &points) {
+    if constexpr (L == Layout::Arrays) {
+      append(points.x_column(), points.y_column());
+    } else {
+      size_t n = std::min(points.size(), points_ - written_);
+      double *x = xs() + written_;
+      double *y = ys() + written_;
+      for (size_t i = 0; i < n; ++i) {
+        x[i] = points.x(i);
+        y[i] = points.y(i);
+      }
+      written_ += n;
+    }
+  }
+
+  // Marks the file complete, flushes it to disk and moves it into place.
+  // Returns the series mapped read-only, or nothing if not every point was
+  // written or the disk failed.
+  std::optional<MappedSeries> commit() {
+    if (!file_.valid() || written_ != points_) {
+      discard();
+      return std::nullopt;
+    }
+    uint64_t complete = 1;
+    std::memcpy(file_.data() + offsetof(detail::StoreHeader, complete),
+                &complete, sizeof(complete));
+    bool flushed = file_.flush();
+    file_.close();
+
+    std::error_code error;
+    if (flushed) {
+      std::filesystem::rename(temp_path_, path_, error);
+    }
+    if (!flushed || error) {
+      discard();
+      return std::nullopt;
+    }
+    temp_path_.clear();
+    detail::MappedFile mapped = detail::MappedFile::open(path_);
+    if (!mapped.valid()) {
+      return std::nullopt;
+    }
+    return MappedSeries(std::move(mapped));
+  }
+
+  // Abandons the file.
+  void discard() {
+    file_.close();
+    if (!temp_path_.empty()) {
+      std::error_code ignored;
+      std::filesystem::remove(temp_path_, ignored);
+      temp_path_.clear();
+    }
+  }
+
+private:
+  double *xs() const {
+    return reinterpret_cast<double *>(file_.data() + detail::kStoreDataOffset);
+  }
+  double *ys() const { return xs() + points_; }
+
+  detail::MappedFile file_;
+  std::filesystem::path temp_path_;
+  std::filesystem::path path_;
+  size_t points_ = 0;
+  size_t written_ = 0;
+};
+
+// MappedSeriesStore keeps generated series on disk as memory-mapped
+// columnar files, so series larger than memory can be served again, even
+// by a later process, by mapping them instead of regenerating them. Each
+// series is stored under a name with a 64-bit key that the caller derives
+// from everything the contents depend on (seed, length, ...); open() only
+// returns a file whose key and length match. Files are written under a
+// temporary name and renamed once complete, so a crash never leaves a
+// partial series behind under its real name.
+class MappedSeriesStore {
+public:
+  // Free disk space make_room() leaves for everything else
+  static constexpr size_t kKeepFreeBytes = size_t{1} << 30;
+
+  explicit MappedSeriesStore(std::filesystem::path directory)
+      : directory_(std::move(directory)) {}
+
+  // Creates the store's directory if needed. Returns false if it cannot.
+  bool prepare() const {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    return std::filesystem::is_directory(directory_, error);
+  }
+
+  const std::filesystem::path &directory() const { return directory_; }
+
+  static size_t file_bytes(size_t points) {
+    return detail::kStoreDataOffset + points * 2 * sizeof(double);
+  }
+
+  // Maps the complete series stored as `name` if its key and length match.
+  std::optional<MappedSeries> open(std::string_view name, uint64_t key,
+                                   size_t points) const {
+    detail::MappedFile file = detail::MappedFile::open(path_of(name));
+    if (!file.valid() || file.size() != file_bytes(points)) {
+      return std::nullopt;
+    }
+    detail::StoreHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    bool matches =
+        std::memcmp(header.magic, detail::kStoreMagic, sizeof(header.magic)) ==
+            0 &&
+        header.version == detail::kStoreVersion &&
+        header.data_offset == detail::kStoreDataOffset && header.key == key &&
+        header.points == points && header.complete == 1;
+    if (!matches) {
+      return std::nullopt;
+    }
+    return MappedSeries(std::move(file));
+  }
+
+  // Starts writing a series of `points` points as `name`, replacing any
+  // stored before once committed. Returns nothing if the file cannot be
+  // created, for example because the disk is full.
+  std::optional<MappedSeriesWriter> create(std::string_view name, uint64_t key,
+                                           size_t points) const {
+    std::filesystem::path path = path_of(name);
+    std::filesystem::path temp_path = path;
+    temp_path += std::format(".{}.tmp", detail::process_id());
+
+    detail::MappedFile file =
+        detail::MappedFile::create(temp_path, file_bytes(points));
+    if (!file.valid()) {
+      std::error_code ignored;
+      std::filesystem::remove(temp_path, ignored);
+      return std::nullopt;
+    }
+    detail::StoreHeader header{};
+    std::memcpy(header.magic, detail::kStoreMagic, sizeof(header.magic));
+    header.version = detail::kStoreVersion;
+    header.data_offset = detail::kStoreDataOffset;
+    header.key = key;
+    header.points = points;
+    std::memcpy(file.data(), &header, sizeof(header));
+    return MappedSeriesWriter(std::move(file), std::move(temp_path),
+                              std::move(path), points);
+  }
+
+  // Deletes the least recently written series until `bytes` more fit on
+  // the disk with kKeepFreeBytes to spare. Returns false if they still do
+  // not.
+  bool make_room(size_t bytes) const {
+    std::error_code error;
+    auto fits = [&] {
+      std::filesystem::space_info space =
+          std::filesystem::space(directory_, error);
+      return !error && space.available >= bytes + kKeepFreeBytes;
+    };
+    if (fits()) {
+      return true;
+    }
+
+    std::vector<std::pair<std::filesystem::file_time_type,
+                          std::filesystem::path>>
+        stored;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(directory_, error)) {
+      if (entry.is_regular_file(error) &&
+          entry.path().extension() == kExtension) {
+        stored.emplace_back(entry.last_write_time(error), entry.path());
+      }
+    }
+    std::ranges::sort(stored);
+    for (const auto &[time, path] : stored) {
+      std::filesystem::remove(path, error);
+      if (fits()) {
+        return true;
+      }
+    }
+    return fits();
+  }
+
+private:
+  static constexpr std::string_view kExtension = ".series";
+
+  std::filesystem::path path_of(std::string_view name) const {
+    return directory_ / std::format("{}{}", name, kExtension);
+  }
+
+  std::filesystem::path directory_;
+};
+
+} // namespace sdk
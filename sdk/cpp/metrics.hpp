@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "json.hpp"
+
+namespace sdk {
+
+// Stats accumulates the timings of one named span, or of the requests for one
+// method along with the bytes they wrote to stdout and the points they sent
+// (by any transport). Updates are atomic so any thread may record without
+// locking.
+struct Stats {
+  explicit Stats(std::string_view name) : name(name) {}
+
+  void record(uint64_t ns, uint64_t sent_bytes = 0, uint64_t sent_points = 0) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+    bytes.fetch_add(sent_bytes, std::memory_order_relaxed);
+    points.fetch_add(sent_points, std::memory_order_relaxed);
+    uint64_t longest = max_ns.load(std::memory_order_relaxed);
+    while (ns > longest && !max_ns.compare_exchange_weak(
+                               longest, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  std::string name;
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> total_ns{0};
+  std::atomic<uint64_t> max_ns{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> points{0};
+};
+
+namespace detail {
+
+inline uint64_t now_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Output sent by the current thread, so the runtime can attribute it to the
+// request that thread is handling.
+struct ThreadOutput {
+  uint64_t bytes = 0;
+  uint64_t points = 0;
+  uint32_t trace_id = 0;
+};
+
+inline ThreadOutput &thread_output() {
+  thread_local ThreadOutput output;
+  return output;
+}
+
+// Appends one entry of the get_metrics result. Only requests carry output.
+inline void append_stats(std::string &out, const Stats &stats, bool request) {
+  out += request ? R"({"method":")" : R"({"name":")";
+  append_json_escaped(out, stats.name);
+  std::format_to(std::back_inserter(out),
+                 R"(","count":{},"total_ms":{:.3f},"max_ms":{:.3f})",
+                 stats.count.load(), static_cast<double>(stats.total_ns) / 1e6,
+                 static_cast<double>(stats.max_ns) / 1e6);
+  if (request) {
+    std::format_to(std::back_inserter(out), R"(,"bytes":{},"points":{})",
+                   stats.bytes.load(), stats.points.load());
+  }
+  out += '}';
+}
+
+} // namespace detail
+
+// Metrics is the process-wide registry of span and request stats, and the
+// optional Chrome trace (chrome://tracing, Perfetto) of every span recorded.
+class Metrics {
+public:
+  // Most trace events kept; later spans are still counted but not traced.
+  static constexpr size_t kMaxTraceEvents = 1 << 20;
+
+  Metrics() : epoch_ns_(detail::now_ns()) {}
+
+  ~Metrics() { write_trace(); }
+
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+
+  // The stats of the span or request method with this name, created on first
+  // use. They are never removed, so call sites may keep the reference.
+  Stats &span(std::string_view name) { return find(spans_, name); }
+  Stats &request(std::string_view method) { return find(requests_, method); }
+
+  // Records every span from now on into a Chrome trace written to path at
+  // exit.
+  void start_trace(std::string path) {
+    std::lock_guard lock(mutex_);
+    trace_path_ = std::move(path);
+    tracing_.store(true, std::memory_order_relaxed);
+  }
+
+  bool tracing() const { return tracing_.load(std::memory_order_relaxed); }
+
+  void trace(const Stats &stats, uint64_t start_ns, uint64_t ns) {
+    std::lock_guard lock(mutex_);
+    if (events_.size() >= kMaxTraceEvents) {
+      return;
+    }
+    detail::ThreadOutput &thread = detail::thread_output();
+    if (thread.trace_id == 0) {
+      thread.trace_id = ++threads_;
+    }
+    events_.push_back({&stats, start_ns - epoch_ns_, ns, thread.trace_id});
+  }
+
+  // The get_metrics result: every request method and span recorded so far.
+  std::string json() {
+    std::lock_guard lock(mutex_);
+    std::string out = R"({"requests":[)";
+    for (const Stats &stats : requests_) {
+      if (&stats != &requests_.front()) {
+        out += ',';
+      }
+      detail::append_stats(out, stats, true);
+    }
+    out += R"(],"spans":[)";
+    for (const Stats &stats : spans_) {
+      if (&stats != &spans_.front()) {
+        out += ',';
+      }
+      detail::append_stats(out, stats, false);
+    }
+    out += "]}";
+    return out;
+  }
+
+  // Writes the trace, if one was started. Called at exit.
+  void write_trace() {
+    std::lock_guard lock(mutex_);
+    if (trace_path_.empty()) {
+      return;
+    }
+    std::string out = R"({"displayTimeUnit":"ms","traceEvents":[)";
+    for (const Event &event : events_) {
+      if (&event != &events_.front()) {
+        out += ",\n";
+      }
+      out += R"({"name":")";
+      detail::append_json_escaped(out, event.stats->name);
+      std::format_to(std::back_inserter(out),
+                     R"(","ph":"X","pid":1,"tid":{},"ts":{:.3f},)"
+                     R"("dur":{:.3f}}})",
+                     event.thread, static_cast<double>(event.start_ns) / 1e3,
+                     static_cast<double>(event.ns) / 1e3);
+    }
+    out += "]}\n";
+    std::ofstream(trace_path_, std::ios::binary) << out;
+    trace_path_.clear();
+  }
+
+private:
+  struct Event {
+    const Stats *stats;
+    uint64_t start_ns;
+    uint64_t ns;
+    uint32_t thread;
+  };
+
+  Stats &find(std::deque<Stats> &all, std::string_view name) {
+    std::lock_guard lock(mutex_);
+    auto it = std::ranges::find(all, name, &Stats::name);
+    return it != all.end() ? *it : all.emplace_back(name);
+  }
+
+  std::mutex mutex_;
+  std::deque<Stats> spans_;
+  std::deque<Stats> requests_;
+  uint64_t epoch_ns_;
+  std::atomic<bool> tracing_{false};
+  std::string trace_path_;
+  std::vector<Event> events_;
+  uint32_t threads_ = 0;
+};
+
+inline Metrics &metrics() {
+  static Metrics registry;
+  return registry;
+}
+
+// Span times the scope it lives in, adding to its Stats when it ends. Use it
+// through SDK_SPAN, which looks the Stats up once per call site.
+class Span {
+public:
+  explicit Span(Stats &stats) : stats_(stats), start_ns_(detail::now_ns()) {}
+  ~Span() {
+    uint64_t ns = detail::now_ns() - start_ns_;
+    stats_.record(ns);
+    if (metrics().tracing()) {
+      metrics().trace(stats_, start_ns_, ns);
+    }
+  }
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+private:
+  Stats &stats_;
+  uint64_t start_ns_;
+};
+
+// RequestTimer records the wall time of one request, and the bytes and points
+// its thread sent meanwhile, under the request's method.
+class RequestTimer {
+public:
+  explicit RequestTimer(std::string_view method)
+      : stats_(metrics().request(method)), start_ns_(detail::now_ns()),
+        bytes_(detail::thread_output().bytes),
+        points_(detail::thread_output().points) {}
+  ~RequestTimer() {
+    uint64_t ns = detail::now_ns() - start_ns_;
+    const detail::ThreadOutput &output = detail::thread_output();
+    stats_.record(ns, output.bytes - bytes_, output.points - points_);
+    if (metrics().tracing()) {
+      metrics().trace(stats_, start_ns_, ns);
+    }
+  }
+
+  RequestTimer(const RequestTimer &) = delete;
+  RequestTimer &operator=(const RequestTimer &) = delete;
+
+private:
+  Stats &stats_;
+  uint64_t start_ns_;
+  uint64_t bytes_;
+  uint64_t points_;
+};
+
+namespace detail {
+
+// Counts points sent by the current thread, for its request's stats.
+inline void count_points(size_t points) { thread_output().points += points; }
+
+} // namespace detail
+
+} // namespace sdk
+
+#define SDK_CONCAT_(a, b) a##b
+#define SDK_CONCAT(a, b) SDK_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope as the span `name`, a string literal:
+//   SDK_SPAN("generate");
+#define SDK_SPAN(name)                                                         \
+  static ::sdk::Stats &SDK_CONCAT(sdk_span_stats_, __LINE__) =                 \
+      ::sdk::metrics().span(name);                                             \
+  ::sdk::Span SDK_CONCAT(sdk_span_, __LINE__)(                                 \
+      SDK_CONCAT(sdk_span_stats_, __LINE__))
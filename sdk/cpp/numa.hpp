@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "platform.hpp"
+
+#ifdef __linux__
+#include <sched.h>
+
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#endif
+
+namespace sdk {
+
+// NumaTopology lists the NUMA nodes the process may run on, so work can be
+// kept on one node together with the memory it writes. Memory is placed on
+// the node of the thread that first touches it, so a thread bound to a node
+// and filling fresh pages gets local memory. Machines without NUMA, and
+// systems where it cannot be queried, report a single node that threads are
+// never bound to.
+class NumaTopology {
+public:
+  NumaTopology() {
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      return;
+    }
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(
+             "/sys/devices/system/node", error)) {
+      std::string name = entry.path().filename().string();
+      if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+          name.find_first_not_of("0123456789", 4) != std::string::npos) {
+        continue;
+      }
+      std::ifstream list(entry.path() / "cpulist");
+      std::string text;
+      std::getline(list, text);
+      Node node{};
+      CPU_ZERO(&node.cpus);
+      for (unsigned cpu : parse_cpu_list(text)) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+          CPU_SET(cpu, &node.cpus);
+        }
+      }
+      // Memory-only nodes have no CPUs to run on
+      if (CPU_COUNT(&node.cpus) > 0) {
+        nodes_.push_back(node);
+      }
+    }
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest)) {
+      return;
+    }
+    for (ULONG n = 0; n <= highest; ++n) {
+      Node node{};
+      if (GetNumaNodeProcessorMaskEx(static_cast<USHORT>(n), &node.cpus) &&
+          node.cpus.Mask != 0) {
+        nodes_.push_back(node);
+      }
+    }
+#endif
+  }
+
+  // At least one.
+  size_t nodes() const { return nodes_.empty() ? 1 : nodes_.size(); }
+
+  // Restricts the calling thread to the CPUs of node `node` (modulo the
+  // node count). Returns false, leaving the thread as it was, on machines
+  // with a single node or if the system refuses.
+  bool bind_thread(size_t node) const {
+    if (nodes_.size() < 2) {
+      return false;
+    }
+    const Node &target = nodes_[node % nodes_.size()];
+#ifdef __linux__
+    bool bound = sched_setaffinity(0, sizeof(target.cpus), &target.cpus) == 0;
+#elif defined(_WIN32)
+    bool bound =
+        SetThreadGroupAffinity(GetCurrentThread(), &target.cpus, nullptr);
+#else
+    bool bound = false;
+#endif
+    if (bound) {
+      bound_node() = node % nodes_.size();
+    }
+    return bound;
+  }
+
+  // The node the calling thread was bound to by bind_thread(), if any.
+  static std::optional<size_t> thread_node() { return bound_node(); }
+
+private:
+  struct Node {
+#ifdef __linux__
+    cpu_set_t cpus;
+#elif defined(_WIN32)
+    GROUP_AFFINITY cpus;
+#endif
+  };
+
+  static std::optional<size_t> &bound_node() {
+    thread_local std::optional<size_t> node;
+    return node;
+  }
+
+#ifdef __linux__
+  // Parses the kernel's CPU list format, e.g. "0-3,8-11".
+  static std::vector<unsigned> parse_cpu_list(std::string_view text) {
+    std::vector<unsigned> cpus;
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end) {
+      unsigned first = 0;
+      auto parsed = std::from_chars(p, end, first);
+      if (parsed.ec != std::errc{}) {
+        break;
+      }
+      unsigned last = first;
+      p = parsed.ptr;
+      if (p < end && *p == '-') {
+        parsed = std::from_chars(p + 1, end, last);
+        if (parsed.ec != std::errc{}) {
+          break;
+        }
+        p = parsed.ptr;
+      }
+      for (unsigned cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+      if (p == end || *p != ',') {
+        break;
+      }
+      ++p;
+    }
+    return cpus;
+  }
+#endif
+
+  std::vector<Node> nodes_;
+};
+
+// The NUMA nodes of this machine, detected on first use.
+inline const NumaTopology &numa_topology() {
+  static const NumaTopology topology;
+  return topology;
+}
+
+} // namespace sdk
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "metrics.hpp"
+
+namespace sdk {
+
+// WritePipeline overlaps producing a stream with sending it. The producer
+// fills a block from next() and hands it over with submit(); a writer thread
+// passes submitted blocks to the consumer in order while the producer fills
+// the next one. Blocks come from a fixed ring, so once `depth` blocks are
+// queued or being written next() waits for the writer: memory stays bounded
+// and a stream takes about max(produce, write) rather than their sum.
+//
+// The consumer runs on the writer thread; the bytes and points it sends are
+// credited to the thread that calls finish(), so request metrics still see
+// them. Only one thread may produce.
+class WritePipeline {
+public:
+  using Consumer = std::function<void(std::span<const double> block)>;
+
+  explicit WritePipeline(Consumer consume, size_t depth = 2)
+      : consume_(std::move(consume)), blocks_(std::max<size_t>(depth, 1)) {
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      free_.push_back(i);
+    }
+    writer_ = std::jthread([this] { write_blocks(); });
+  }
+
+  ~WritePipeline() { finish(); }
+
+  WritePipeline(const WritePipeline &) = delete;
+  WritePipeline &operator=(const WritePipeline &) = delete;
+
+  // A block of `values` doubles to fill, waiting while every block is queued
+  // or being written. Its contents are unspecified.
+  std::span<double> next(size_t values) {
+    std::unique_lock lock(mutex_);
+    changed_.wait(lock, [&] { return !free_.empty(); });
+    filling_ = free_.front();
+    free_.pop_front();
+    lock.unlock();
+
+    ArenaVector<double> &block = blocks_[filling_];
+    block.resize_for_overwrite(values);
+    return {block.data(), values};
+  }
+
+  // Queues the block from the last next() call, or its first part, to be
+  // written.
+  void submit(std::span<const double> filled) {
+    {
+      std::lock_guard lock(mutex_);
+      blocks_[filling_].resize_for_overwrite(filled.size());
+      full_.push_back(filling_);
+    }
+    changed_.notify_all();
+  }
+
+  // Copies values into a block and queues it, for producers that fill their
+  // own buffers.
+  void write(std::span<const double> values) {
+    std::span<double> block = next(values.size());
+    std::ranges::copy(values, block.begin());
+    submit(block);
+  }
+
+  // Drops the queued blocks that the writer has not started on.
+  void discard() {
+    {
+      std::lock_guard lock(mutex_);
+      free_.insert(free_.end(), full_.begin(), full_.end());
+      full_.clear();
+    }
+    changed_.notify_all();
+  }
+
+  // Waits until every queued block is written and stops the writer.
+  void finish() {
+    if (!writer_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard lock(mutex_);
+      closing_ = true;
+    }
+    changed_.notify_all();
+    writer_.join();
+
+    detail::ThreadOutput &output = detail::thread_output();
+    output.bytes += sent_.bytes;
+    output.points += sent_.points;
+  }
+
+private:
+  void write_blocks() {
+    for (;;) {
+      std::unique_lock lock(mutex_);
+      changed_.wait(lock, [&] { return closing_ || !full_.empty(); });
+      if (full_.empty()) {
+        break;
+      }
+      size_t index = full_.front();
+      full_.pop_front();
+      lock.unlock();
+
+      const ArenaVector<double> &block = blocks_[index];
+      consume_({block.data(), block.size()});
+
+      lock.lock();
+      free_.push_back(index);
+      lock.unlock();
+      changed_.notify_all();
+    }
+    sent_ = detail::thread_output();
+  }
+
+  Consumer consume_;
+  std::vector<ArenaVector<double>> blocks_;
+  size_t filling_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable changed_; // A block was queued or freed
+  std::deque<size_t> free_;
+  std::deque<size_t> full_; // In submission order
+  bool closing_ = false;
+  detail::ThreadOutput sent_;
+  std::jthread writer_;
+};
+
+} // namespace sdk
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// The few operating system calls the SDK needs, with their Win32 and POSIX
+// spellings side by side. Windows builds get <windows.h> through here;
+// everything else sticks to POSIX.
+namespace sdk::detail {
+
+inline unsigned long process_id() {
+#ifdef _WIN32
+  return GetCurrentProcessId();
+#else
+  return static_cast<unsigned long>(getpid());
+#endif
+}
+
+// Stops the CRT from turning \n into \r\n on a stream. POSIX streams are
+// always binary.
+inline void set_binary_mode([[maybe_unused]] FILE *stream) {
+#ifdef _WIN32
+  _setmode(_fileno(stream), _O_BINARY);
+#endif
+}
+
+} // namespace sdk::detail
@@ -1,31 +1,364 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
-#include <fcntl.h>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <format>
-#include <io.h>
+#include <initializer_list>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include "arena.hpp"
+#include "compress.hpp"
+#include "json.hpp"
+#include "layout.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "platform.hpp"
+
 namespace sdk {
 
+namespace detail {
+
+// Held for every write to stdout so that messages from different threads are
+// never interleaved within a line or a binary frame.
+inline std::mutex &output_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Writes prefix and then parts to the stdout handle in order, bypassing the
+// CRT buffer so large payloads are not copied. Pending stdio/iostream output
+// is flushed first to keep the stream ordered.
+inline void
+write_stdout_handle(std::span<const std::byte> prefix,
+                    std::span<const std::span<const std::byte>> parts) {
+  SDK_SPAN("write");
+  std::cout.flush();
+  fflush(stdout);
+  uint64_t &sent = thread_output().bytes;
+  sent += prefix.size();
+  for (std::span<const std::byte> part : parts) {
+    sent += part.size();
+  }
+
+#ifdef _WIN32
+  // Pipes do not support WriteFileGather, so issue one WriteFile per part
+  // straight from the caller's buffer.
+  HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+  auto write_all = [&](std::span<const std::byte> part) {
+    while (!part.empty()) {
+      DWORD to_write = static_cast<DWORD>(
+          std::min<size_t>(part.size(), size_t{1} << 30));
+      DWORD written = 0;
+      if (!WriteFile(handle, part.data(), to_write, &written, nullptr) ||
+          written == 0) {
+        return false;
+      }
+      part = part.subspan(written);
+    }
+    return true;
+  };
+  if (!write_all(prefix)) {
+    return;
+  }
+  for (std::span<const std::byte> part : parts) {
+    if (!write_all(part)) {
+      return;
+    }
+  }
+#else
+  std::vector<iovec> iov;
+  iov.reserve(parts.size() + 1);
+  if (!prefix.empty()) {
+    iov.push_back({const_cast<std::byte *>(prefix.data()), prefix.size()});
+  }
+  for (std::span<const std::byte> part : parts) {
+    if (!part.empty()) {
+      iov.push_back({const_cast<std::byte *>(part.data()), part.size()});
+    }
+  }
+
+  size_t first = 0;
+  while (first < iov.size()) {
+    int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    ssize_t written = ::writev(STDOUT_FILENO, iov.data() + first, count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    // Skip fully written buffers and advance into a partially written one
+    auto remaining = static_cast<size_t>(written);
+    while (first < iov.size() && remaining >= iov[first].iov_len) {
+      remaining -= iov[first].iov_len;
+      ++first;
+    }
+    if (first < iov.size()) {
+      iov[first].iov_base =
+          static_cast<char *>(iov[first].iov_base) + remaining;
+      iov[first].iov_len -= remaining;
+    }
+  }
+#endif
+}
+
+// OutputBuffer collects the text lines bound for stdout, formatted straight
+// into one reusable buffer. Queued log messages are moved into it ahead of
+// anything else written, so they go out between frames together with the
+// next response or binary frame, or at an explicit flush. Callers hold
+// output_mutex().
+class OutputBuffer {
+public:
+  // Pending text past this size is written out without waiting for a flush
+  static constexpr size_t kFlushBytes = 64 * 1024;
+
+  OutputBuffer() {
+    // Stdio users such as --metadata output must not get \r\n line ends
+    set_binary_mode(stdout);
+    text_.reserve(kFlushBytes);
+    // Constructed first so it outlives the final flush at exit
+    log_channel();
+  }
+
+  ~OutputBuffer() { flush(); }
+
+  OutputBuffer(const OutputBuffer &) = delete;
+  OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+  // The pending text, to append a line to.
+  std::string &text() {
+    drain_logs();
+    return text_;
+  }
+
+  // Ends the line being built, writing out everything pending if asked to or
+  // if enough has piled up.
+  void end_line(bool flush_now) {
+    text_ += '\n';
+    if (flush_now || text_.size() >= kFlushBytes) {
+      flush();
+    }
+  }
+
+  // Writes pending text followed by parts in as few writes as possible.
+  void write(std::span<const std::span<const std::byte>> parts) {
+    drain_logs();
+    write_stdout_handle(std::as_bytes(std::span(text_)), parts);
+    text_.clear();
+  }
+
+  void flush() {
+    drain_logs();
+    if (!text_.empty()) {
+      write({});
+    }
+  }
+
+private:
+  void drain_logs() {
+    LogChannel &channel = log_channel();
+    channel.queue.drain([&](const LogQueue::Message &message) {
+      append_log_line(message.level, message.text);
+    });
+    if (uint64_t dropped = channel.limiter.take_dropped()) {
+      append_log_line(LogLevel::Warn,
+                      std::format("Dropped {} log messages over the limit of "
+                                  "{} per second",
+                                  dropped, LogLimiter::kLinesPerSecond));
+    }
+  }
+
+  void append_log_line(LogLevel level, std::string_view message) {
+    text_ += R"({"method":"log","level":")";
+    text_ += log_level_name(level);
+    text_ += R"(","message":")";
+    append_json_escaped(text_, message);
+    text_ += "\"}\n";
+  }
+
+  std::string text_;
+};
+
+inline OutputBuffer &output_buffer() {
+  static OutputBuffer buffer;
+  return buffer;
+}
+
+template <typename... Args>
+void append_format(std::string &out, std::format_string<Args...> fmt,
+                   Args &&...args) {
+  std::format_to(std::back_inserter(out), fmt, std::forward<Args>(args)...);
+}
+
+// The request the current thread is answering: its raw "id", empty if the
+// host sent none, and whether the host has other requests in flight beside
+// it. Replies sent meanwhile are tagged with the id, so such a host can tell
+// them apart however they interleave.
+struct CurrentRequest {
+  std::string id;
+  bool multiplexed = false;
+};
+
+inline CurrentRequest &current_request() {
+  thread_local CurrentRequest request;
+  return request;
+}
+
+// Makes a request the current thread's for as long as it lives.
+class RequestScope {
+public:
+  RequestScope(std::string_view id, bool multiplexed)
+      : previous_(std::exchange(current_request(),
+                                {std::string(id), multiplexed})) {}
+  ~RequestScope() { current_request() = std::move(previous_); }
+
+  RequestScope(const RequestScope &) = delete;
+  RequestScope &operator=(const RequestScope &) = delete;
+
+private:
+  CurrentRequest previous_;
+};
+
+// Returns the ,"id":... member that tags a frame header with the current
+// request, or nothing.
+inline std::string request_tag() {
+  const std::string &id = current_request().id;
+  if (id.empty()) {
+    return {};
+  }
+  return std::format(",\"id\":{}", id);
+}
+
+// Tags the JSON object that starts at text[start] with the current request.
+inline void tag_line(std::string &text, size_t start) {
+  const std::string &id = current_request().id;
+  if (id.empty() || start >= text.size() || text[start] != '{') {
+    return;
+  }
+  std::string member = "\"id\":" + id;
+  if (start + 1 < text.size() && text[start + 1] != '}') {
+    member += ',';
+  }
+  text.insert(start + 1, member);
+}
+
+} // namespace detail
+
+// Writes out any buffered log lines. The runtime calls it whenever it has
+// finished handling a message.
+inline void flush_output() {
+  std::lock_guard lock(detail::output_mutex());
+  detail::output_buffer().flush();
+}
+
+// Sends one JSON message line, together with any log lines before it. The
+// line is tagged with the id of the request being answered, if any.
 inline void send_response(std::string_view json) {
-  std::cout << json << std::endl;
+  std::lock_guard lock(detail::output_mutex());
+  detail::OutputBuffer &out = detail::output_buffer();
+  std::string &text = out.text();
+  size_t start = text.size();
+  text += json;
+  detail::tag_line(text, start);
+  out.end_line(true);
+}
+
+// Formats a JSON message line straight into the output buffer and sends it.
+template <typename... Args>
+  requires(sizeof...(Args) > 0)
+void send_response(std::format_string<Args...> fmt, Args &&...args) {
+  std::lock_guard lock(detail::output_mutex());
+  detail::OutputBuffer &out = detail::output_buffer();
+  std::string &text = out.text();
+  size_t start = text.size();
+  detail::append_format(text, fmt, std::forward<Args>(args)...);
+  detail::tag_line(text, start);
+  out.end_line(true);
+}
+
+// Queues a log message for the host without waiting on the output, so it is
+// safe from any thread, even while a frame is being written. Queued messages
+// go out between frames, with the next response or flush. Messages below the
+// host's log level are dropped, as are lines over the rate limit.
+inline void log_message(LogLevel level, std::string_view message) {
+  detail::LogChannel &channel = detail::log_channel();
+  if (log_enabled(level) && channel.limiter.allow()) {
+    channel.queue.push(level, message);
+  }
 }
 
 inline void log_message(std::string_view level, std::string_view message) {
-  std::cout << std::format(
-                   "{{\"method\":\"log\",\"level\":\"{}\",\"message\":\"{}\"}}",
-                   level, message)
-            << std::endl;
+  log_message(parse_log_level(level), message);
+}
+
+namespace detail {
+
+template <typename... Args>
+void log_format(LogLevel level, std::format_string<Args...> fmt,
+                Args &&...args) {
+  if (!log_enabled(level)) {
+    return;
+  }
+  thread_local std::string message;
+  message.clear();
+  append_format(message, fmt, std::forward<Args>(args)...);
+  log_message(level, message);
+}
+
+} // namespace detail
+
+inline void log_debug(std::string_view msg) {
+  log_message(LogLevel::Debug, msg);
+}
+inline void log_info(std::string_view msg) {
+  log_message(LogLevel::Info, msg);
+}
+inline void log_warn(std::string_view msg) {
+  log_message(LogLevel::Warn, msg);
+}
+inline void log_error(std::string_view msg) {
+  log_message(LogLevel::Error, msg);
 }
 
-inline void log_info(std::string_view msg) { log_message("info", msg); }
-inline void log_error(std::string_view msg) { log_message("error", msg); }
-inline void log_debug(std::string_view msg) { log_message("debug", msg); }
+// Formatting variants, e.g. log_info("Loaded {} rows", rows), which reuse a
+// per-thread buffer and skip formatting messages below the log level.
+template <typename... Args>
+  requires(sizeof...(Args) > 0)
+void log_debug(std::format_string<Args...> fmt, Args &&...args) {
+  detail::log_format(LogLevel::Debug, fmt, std::forward<Args>(args)...);
+}
+template <typename... Args>
+  requires(sizeof...(Args) > 0)
+void log_info(std::format_string<Args...> fmt, Args &&...args) {
+  detail::log_format(LogLevel::Info, fmt, std::forward<Args>(args)...);
+}
+template <typename... Args>
+  requires(sizeof...(Args) > 0)
+void log_warn(std::format_string<Args...> fmt, Args &&...args) {
+  detail::log_format(LogLevel::Warn, fmt, std::forward<Args>(args)...);
+}
+template <typename... Args>
+  requires(sizeof...(Args) > 0)
+void log_error(std::format_string<Args...> fmt, Args &&...args) {
+  detail::log_format(LogLevel::Error, fmt, std::forward<Args>(args)...);
+}
 
+// Returns the first value for key anywhere in json. Superseded by parsing the
+// message once with JsonObject, which also handles whitespace and escapes.
+[[deprecated("parse the message once with sdk::JsonObject")]]
 inline std::string_view find_json_value(std::string_view json,
                                         std::string_view key) {
   std::string search_key = "\"";
@@ -59,30 +392,727 @@ inline std::string_view find_json_value(std::string_view json,
       return json.substr(val_start, val_end - val_start);
     }
   } else {
-    // Numeric value
+    // Numeric value (including exponent notation such as 1.5e+06)
     size_t val_end = val_start;
     while (val_end < json.length() &&
            (isdigit(json[val_end]) || json[val_end] == '.' ||
-            json[val_end] == '-'))
+            json[val_end] == '-' || json[val_end] == '+' ||
+            json[val_end] == 'e' || json[val_end] == 'E'))
       val_end++;
     return json.substr(val_start, val_end - val_start);
   }
 }
 
-inline void send_binary_data(const std::vector<double> &result,
-                             std::string_view storage = "interleaved") {
-  size_t byte_len = result.size() * sizeof(double);
-  std::cout << std::format("{{\"type\":\"binary\",\"length\":{},\"storage\":"
-                           "\"{}\"}}",
-                           byte_len, storage)
-            << std::endl;
-  std::cout.flush();
+namespace detail {
 
-  // Send binary data (stdout must be in binary mode)
-  _setmode(_fileno(stdout), _O_BINARY);
-  fwrite(result.data(), 1, byte_len, stdout);
-  fflush(stdout);
-  _setmode(_fileno(stdout), _O_TEXT);
+// Writes the given byte buffers to stdout in order, after any buffered text,
+// straight from the caller's memory.
+inline void
+write_stdout_gather(std::span<const std::span<const std::byte>> parts) {
+  std::lock_guard lock(output_mutex());
+  output_buffer().write(parts);
+}
+
+// Returns the ,"series_id":"..." member that tags a data header with the
+// series it belongs to, or nothing for untagged responses.
+inline std::string series_tag(std::string_view series_id) {
+  if (series_id.empty()) {
+    return {};
+  }
+  return ",\"series_id\":" + json_quoted(series_id);
+}
+
+} // namespace detail
+
+// Returns the string elements of an array value, e.g. "series_ids":["a","b"].
+[[deprecated("use sdk::JsonValue::strings")]]
+inline std::vector<std::string_view>
+find_json_string_array(std::string_view json, std::string_view key) {
+  std::vector<std::string_view> values;
+  std::string search_key = "\"";
+  search_key += key;
+  search_key += "\":";
+
+  size_t pos = json.find(search_key);
+  if (pos == std::string_view::npos) {
+    return values;
+  }
+  pos = json.find_first_not_of(' ', pos + search_key.length());
+  if (pos == std::string_view::npos || json[pos] != '[') {
+    return values;
+  }
+
+  size_t end = json.find(']', pos);
+  if (end == std::string_view::npos) {
+    return values;
+  }
+  while ((pos = json.find('"', pos + 1)) < end) {
+    size_t close = json.find('"', pos + 1);
+    if (close == std::string_view::npos || close > end) {
+      break;
+    }
+    values.push_back(json.substr(pos + 1, close - pos - 1));
+    pos = close;
+  }
+  return values;
+}
+
+// MethodTable maps a plugin's method names to its own ids through a perfect
+// hash found at compile time, so dispatching a request costs one hash and one
+// string comparison however many methods there are. Build it with
+// method_table<Id>({{"info", Id::Info}, ...}).
+template <typename Id, size_t N> class MethodTable {
+public:
+  consteval explicit MethodTable(
+      const std::pair<std::string_view, Id> (&methods)[N]) {
+    while (!place(methods)) {
+      if (++seed_ == kMaxSeed) {
+        throw "method names have no perfect hash";
+      }
+    }
+  }
+
+  std::optional<Id> find(std::string_view name) const {
+    const Slot &slot = slots_[hash(name, seed_) & (kSlots - 1)];
+    if (slot.used && slot.name == name) {
+      return slot.id;
+    }
+    return std::nullopt;
+  }
+
+private:
+  static constexpr size_t kSlots = std::bit_ceil(N * 2);
+  static constexpr uint64_t kMaxSeed = 1 << 16;
+
+  struct Slot {
+    std::string_view name;
+    Id id{};
+    bool used = false;
+  };
+
+  static constexpr uint64_t hash(std::string_view name, uint64_t seed) {
+    uint64_t h = 0xCBF29CE484222325ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (char c : name) {
+      h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3ULL;
+    }
+    return h ^ (h >> 32);
+  }
+
+  constexpr bool place(const std::pair<std::string_view, Id> (&methods)[N]) {
+    slots_ = {};
+    for (const auto &[name, id] : methods) {
+      Slot &slot = slots_[hash(name, seed_) & (kSlots - 1)];
+      if (slot.used) {
+        return false;
+      }
+      slot = {name, id, true};
+    }
+    return true;
+  }
+
+  std::array<Slot, kSlots> slots_{};
+  uint64_t seed_ = 0;
+};
+
+template <typename Id, size_t N>
+consteval MethodTable<Id, N>
+method_table(const std::pair<std::string_view, Id> (&methods)[N]) {
+  return MethodTable<Id, N>(methods);
+}
+
+// StaticJson is JSON text built at compile time, for responses that never
+// change: send_response(minified_json<kSchema>) copies it out as it is.
+template <size_t N> struct StaticJson {
+  std::array<char, N> chars{};
+
+  constexpr std::string_view view() const { return {chars.data(), N}; }
+  constexpr operator std::string_view() const { return view(); }
+};
+
+namespace detail {
+
+// Hands out(c) each character of JSON text but the whitespace between
+// tokens.
+template <typename Out>
+constexpr void write_minified(std::string_view json, Out &&out) {
+  bool in_string = false;
+  bool escaped = false;
+  for (char c : json) {
+    if (in_string) {
+      in_string = escaped || c != '"';
+      escaped = !escaped && c == '\\';
+    } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      continue;
+    } else {
+      in_string = c == '"';
+    }
+    out(c);
+  }
+}
+
+// Hands out(c) the characters of a JSON string holding text. Compile-time
+// text with control characters is rejected.
+template <typename Out>
+constexpr void write_json_string(std::string_view text, Out &&out) {
+  out('"');
+  for (char c : text) {
+    if (static_cast<unsigned char>(c) < 0x20) {
+      throw "control characters in constant JSON text";
+    }
+    if (c == '"' || c == '\\') {
+      out('\\');
+    }
+    out(c);
+  }
+  out('"');
+}
+
+template <typename Out>
+constexpr void write_decimal(uint64_t value, Out &&out) {
+  char digits[20];
+  size_t n = 0;
+  do {
+    digits[n++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (n > 0) {
+    out(digits[--n]);
+  }
+}
+
+template <const std::string_view &Json> struct MinifiedSource {
+  template <typename Out> static constexpr void write(Out &&out) {
+    write_minified(Json, out);
+  }
+};
+
+template <const std::string_view &Name, unsigned Version> struct InfoSource {
+  template <typename Out> static constexpr void write(Out &&out) {
+    for (char c : std::string_view("{\"name\":")) {
+      out(c);
+    }
+    write_json_string(Name, out);
+    for (char c : std::string_view(",\"version\":")) {
+      out(c);
+    }
+    write_decimal(Version, out);
+    out('}');
+  }
+};
+
+// Runs Source::write twice: once to size the text, once to store it.
+template <typename Source> consteval auto static_json() {
+  constexpr size_t size = [] {
+    size_t n = 0;
+    Source::write([&](char) { ++n; });
+    return n;
+  }();
+  StaticJson<size> json;
+  size_t i = 0;
+  Source::write([&](char c) { json.chars[i++] = c; });
+  return json;
+}
+
+} // namespace detail
+
+// A constexpr std::string_view of JSON, such as a readable multi-line form
+// schema, minified at compile time into the single line the protocol needs.
+template <const std::string_view &Json>
+inline constexpr auto minified_json =
+    detail::static_json<detail::MinifiedSource<Json>>();
+
+// The response to info, {"name":...,"version":...}, built at compile time.
+template <const std::string_view &Name, unsigned Version>
+inline constexpr auto info_response =
+    detail::static_json<detail::InfoSource<Name, Version>>();
+
+// Wire formats for series values. f64 is the default. f32 halves the size.
+// i32-delta also uses four bytes per value but quantises each column against
+// its own range, keeping about 30 bits of precision relative to the data's
+// extent, so it suits large monotonic or slowly varying series.
+enum class DType { F64, F32, I32Delta };
+
+inline std::string_view dtype_name(DType dtype) {
+  switch (dtype) {
+  case DType::F32:
+    return "f32";
+  case DType::I32Delta:
+    return "i32-delta";
+  default:
+    return "f64";
+  }
+}
+
+// Picks the smallest format listed in a request's "dtypes" member. i32-delta
+// needs each column's range up front, so streams that cannot know it pass
+// ranged = false.
+inline DType choose_dtype(std::span<const std::string_view> accepted,
+                          bool ranged = true) {
+  auto has = [&](std::string_view name) {
+    return std::ranges::find(accepted, name) != accepted.end();
+  };
+  if (ranged && has("i32-delta")) {
+    return DType::I32Delta;
+  }
+  if (has("f32")) {
+    return DType::F32;
+  }
+  return DType::F64;
+}
+
+// Maps a column's values to integers as (value - offset) / scale.
+struct Quantization {
+  double scale = 1;
+  double offset = 0;
+
+  // Quantised steps across a column's range. Any two quantised values then
+  // differ by less than 2^31, so every delta fits in an int32.
+  static constexpr double kSteps = 1 << 30;
+
+  // Fits every stride-th value of a column.
+  static Quantization fit(std::span<const double> values, size_t stride = 1) {
+    if (values.empty()) {
+      return {};
+    }
+    double lo = values[0];
+    double hi = values[0];
+    for (size_t i = stride; i < values.size(); i += stride) {
+      lo = std::min(lo, values[i]);
+      hi = std::max(hi, values[i]);
+    }
+    return {hi > lo ? (hi - lo) / kSteps : 1.0, lo};
+  }
+
+  int64_t level(double value) const {
+    return static_cast<int64_t>(std::llround((value - offset) / scale));
+  }
+};
+
+// How a response encodes its values: the format, for i32-delta each
+// column's quantisation, and whether payloads are compressed.
+struct Encoding {
+  DType dtype = DType::F64;
+  Quantization x{};
+  Quantization y{};
+  Compression compression = Compression::None;
+
+  // Fits the quantisation to the data. x and y are read every `stride`
+  // values, so interleaved data can be passed as (data, data.subspan(1), 2).
+  static Encoding fit(DType dtype, std::span<const double> x,
+                      std::span<const double> y, size_t stride = 1) {
+    Encoding encoding{dtype};
+    if (dtype == DType::I32Delta) {
+      encoding.x = Quantization::fit(x, stride);
+      encoding.y = Quantization::fit(y, stride);
+    }
+    return encoding;
+  }
+
+  size_t value_bytes() const {
+    return dtype == DType::F64 ? sizeof(double) : sizeof(int32_t);
+  }
+
+  // Whether payloads are the caller's float64 values as they are, so they
+  // can be sent without copying.
+  bool plain() const {
+    return dtype == DType::F64 && compression == Compression::None;
+  }
+
+  // Header members describing the encoding. Empty for uncompressed f64, the
+  // default.
+  std::string header_fields() const {
+    std::string fields;
+    if (dtype != DType::F64) {
+      fields = std::format(",\"dtype\":\"{}\"", dtype_name(dtype));
+    }
+    if (dtype == DType::I32Delta) {
+      fields += std::format(
+          ",\"x_scale\":{},\"x_offset\":{},\"y_scale\":{},\"y_offset\":{}",
+          x.scale, x.offset, y.scale, y.offset);
+    }
+    if (compression != Compression::None) {
+      fields += std::format(",\"compression\":\"{}\"",
+                            compression_name(compression));
+    }
+    return fields;
+  }
+
+  // Appends n encoded points to out, reading x[i * stride] and y[i * stride]
+  // and writing them in arrays or interleaved order. For i32-delta each
+  // column's deltas start from zero in every call, so each payload or chunk
+  // decodes on its own.
+  void encode(const double *xs, const double *ys, size_t stride, size_t n,
+              bool arrays, ArenaVector<std::byte> &out) const {
+    SDK_SPAN("encode");
+    size_t start = out.size();
+    out.resize_for_overwrite(start + n * 2 * value_bytes());
+    std::byte *dst = out.data() + start;
+    // Pick the layout and type once, outside the per-point loops
+    with_layout(arrays ? Layout::Arrays : Layout::Interleaved, [&](auto tag) {
+      constexpr Layout L = decltype(tag)::value;
+      if (dtype == DType::F64) {
+        convert(xs, ys, stride,
+                Samples<L, double>::of(reinterpret_cast<double *>(dst), n));
+      } else if (dtype == DType::F32) {
+        convert(xs, ys, stride,
+                Samples<L, float>::of(reinterpret_cast<float *>(dst), n));
+      } else {
+        quantize(xs, ys, stride,
+                 Samples<L, int32_t>::of(reinterpret_cast<int32_t *>(dst), n));
+      }
+    });
+  }
+
+private:
+  template <Layout L, typename T>
+  static void convert(const double *xs, const double *ys, size_t stride,
+                      Samples<L, T> out) {
+    for (size_t i = 0; i < out.size(); ++i) {
+      out.set(i, xs[i * stride], ys[i * stride]);
+    }
+  }
+
+  template <Layout L>
+  void quantize(const double *xs, const double *ys, size_t stride,
+                Samples<L, int32_t> out) const {
+    int64_t previous_x = 0;
+    int64_t previous_y = 0;
+    for (size_t i = 0; i < out.size(); ++i) {
+      int64_t level_x = x.level(xs[i * stride]);
+      int64_t level_y = y.level(ys[i * stride]);
+      out.set(i, level_x - previous_x, level_y - previous_y);
+      previous_x = level_x;
+      previous_y = level_y;
+    }
+  }
+};
+
+// Sends a series as a single binary response. The payload is written straight
+// from the caller's buffer, so any contiguous storage (vector, memory-mapped
+// column, ...) can be sent without copying. A series_id tags the response
+// as one frame of a batch.
+inline void send_binary_data(std::span<const double> result,
+                             std::string_view storage = "interleaved",
+                             std::string_view series_id = {}) {
+  size_t byte_len = result.size_bytes();
+  std::string header = std::format(
+      "{{\"type\":\"binary\",\"length\":{},\"storage\":\"{}\"{}{}}}\n",
+      byte_len, storage, detail::request_tag(), detail::series_tag(series_id));
+
+  const std::span<const std::byte> parts[] = {
+      std::as_bytes(std::span(header)), std::as_bytes(result)};
+  detail::write_stdout_gather(parts);
+  detail::count_points(result.size() / 2);
+}
+
+// Sends separate x and y buffers as an "arrays" binary response using a single
+// gathered write, without concatenating them first.
+inline void send_binary_data(std::span<const double> x,
+                             std::span<const double> y,
+                             std::string_view series_id = {}) {
+  if (x.size() != y.size()) {
+    send_response("{{\"error\":\"x and y lengths differ ({} vs {})\"{}}}",
+                  x.size(), y.size(), detail::series_tag(series_id));
+    return;
+  }
+
+  size_t byte_len = x.size_bytes() + y.size_bytes();
+  std::string header = std::format(
+      "{{\"type\":\"binary\",\"length\":{},\"storage\":\"arrays\"{}{}}}\n",
+      byte_len, detail::request_tag(), detail::series_tag(series_id));
+
+  const std::span<const std::byte> parts[] = {
+      std::as_bytes(std::span(header)), std::as_bytes(x), std::as_bytes(y)};
+  detail::write_stdout_gather(parts);
+  detail::count_points(x.size());
+}
+
+namespace detail {
+
+// Sends x and y as one binary response in the given encoding, with `fields`
+// appended to the header. Plain f64 arrays are sent without copying.
+inline void send_encoded(std::span<const double> x, std::span<const double> y,
+                         std::string_view storage, const Encoding &encoding,
+                         std::string_view fields) {
+  bool arrays = storage == "arrays";
+  size_t points = std::min(x.size(), y.size());
+  ArenaVector<std::byte> payload;
+  if (!arrays || !encoding.plain()) {
+    encoding.encode(x.data(), y.data(), 1, points, arrays, payload);
+  }
+  std::string frame_fields;
+  if (encoding.compression != Compression::None) {
+    CompressedPayload compressed = compress_payload(
+        payload, encoding.value_bytes(), encoding.compression);
+    frame_fields = compressed.header_fields();
+    payload = std::move(compressed.bytes);
+  }
+  size_t byte_len = payload.empty() ? points * 2 * sizeof(double)
+                                    : payload.size();
+  std::string header = std::format(
+      "{{\"type\":\"binary\",\"length\":{},\"storage\":\"{}\"{}{}{}}}\n",
+      byte_len, arrays ? "arrays" : "interleaved", encoding.header_fields(),
+      frame_fields, fields);
+
+  std::span<const std::byte> parts[] = {std::as_bytes(std::span(header)),
+                                        payload, {}};
+  if (payload.empty()) {
+    parts[1] = std::as_bytes(x.first(points));
+    parts[2] = std::as_bytes(y.first(points));
+  }
+  write_stdout_gather(parts);
+  count_points(points);
+}
+
+} // namespace detail
+
+// Sends a series as a single binary response in the given encoding, laid
+// out as `storage`. Plain f64 arrays are sent without copying.
+inline void send_encoded_data(std::span<const double> x,
+                              std::span<const double> y,
+                              std::string_view storage,
+                              const Encoding &encoding,
+                              std::string_view series_id = {}) {
+  detail::send_encoded(x, y, storage, encoding,
+                       detail::request_tag() + detail::series_tag(series_id));
+}
+
+// Sends a coarse version of a series, marked "preview":true, ahead of its
+// full data. The host shows it until a finer preview or the data arrives.
+inline void send_preview(std::span<const double> x, std::span<const double> y,
+                         std::string_view storage, const Encoding &encoding,
+                         std::string_view series_id = {}) {
+  std::string fields = detail::request_tag() + detail::series_tag(series_id) +
+                       ",\"preview\":true";
+  detail::send_encoded(x, y, storage, encoding, fields);
+}
+
+// Default number of [x, y] points per chunk for ChunkedWriter (1 MiB of
+// float64 pairs).
+inline constexpr size_t kDefaultChunkPoints = 65536;
+
+// Starts the response to get_series_data_batch. It must be followed by exactly
+// `count` binary or chunked responses (or errors), each tagged with its
+// series_id, in any order.
+inline void send_batch_header(size_t count) {
+  std::string header =
+      std::format("{{\"type\":\"batch\",\"count\":{}{}}}\n", count,
+                  detail::request_tag());
+  const std::span<const std::byte> parts[] = {
+      std::as_bytes(std::span(header))};
+  detail::write_stdout_gather(parts);
+}
+
+// Answers a request, or one series of a batch, that the host cancelled.
+inline void send_cancelled(std::string_view series_id = {}) {
+  send_response("{{\"error\":\"cancelled\"{}}}",
+                detail::series_tag(series_id));
 }
 
+// ChunkedWriter streams a series to the host as a "chunked" binary response:
+// a header line, a sequence of chunks each preceded by its own
+// {"type":"chunk","length":N} line, and a final {"type":"end"} terminator.
+// Only one chunk is buffered at a time, so peak memory does not depend on the
+// length of the series. Every frame carries the id of the request being
+// answered when the writer was made, so responses to other requests may come
+// between them; without an id, no other response may be sent until finish()
+// returns (it is also called from the destructor). Log messages are queued
+// and go out between chunks. With an encoding other than f64, each chunk is
+// encoded on its own; for i32-delta the caller supplies the quantisation up
+// front.
+// Compressed chunks are compressed on worker threads while earlier ones are
+// sent, each marked with its inflated "raw_length" unless it did not shrink.
+class ChunkedWriter {
+public:
+  explicit ChunkedWriter(std::string_view storage = "interleaved",
+                         size_t total_points = 0,
+                         size_t chunk_points = kDefaultChunkPoints,
+                         std::string_view series_id = {},
+                         const Encoding &encoding = {})
+      : arrays_(storage == "arrays"),
+        chunk_points_(std::max<size_t>(chunk_points, 1)),
+        encoding_(encoding), tag_(detail::request_tag()),
+        buffer_(chunk_points_ * 2) {
+    if (encoding_.compression != Compression::None) {
+      compressor_.emplace(encoding_.compression);
+    }
+    std::string header = std::format(
+        "{{\"type\":\"chunked\",\"storage\":\"{}\"{}{}{}", storage,
+        encoding_.header_fields(), tag_, detail::series_tag(series_id));
+    if (total_points > 0) {
+      header += std::format(",\"points\":{}", total_points);
+    }
+    header += "}\n";
+    write_parts({std::as_bytes(std::span(header))});
+  }
+
+  ChunkedWriter(const ChunkedWriter &) = delete;
+  ChunkedWriter &operator=(const ChunkedWriter &) = delete;
+
+  ~ChunkedWriter() { finish(); }
+
+  // Appends a single point, sending the current chunk once it is full.
+  void push(double x, double y) {
+    if (arrays_) {
+      buffer_[count_] = x;
+      buffer_[chunk_points_ + count_] = y;
+    } else {
+      buffer_[count_ * 2] = x;
+      buffer_[count_ * 2 + 1] = y;
+    }
+    if (++count_ == chunk_points_) {
+      flush_chunk();
+    }
+  }
+
+  // Appends interleaved [x, y] pairs. With interleaved f64 storage, whole
+  // chunks are sent straight from the caller's buffer without being copied.
+  void write(std::span<const double> interleaved) {
+    size_t points = interleaved.size() / 2;
+    size_t i = 0;
+    if (!arrays_ && encoding_.plain()) {
+      for (; count_ != 0 && i < points; ++i) {
+        push(interleaved[i * 2], interleaved[i * 2 + 1]);
+      }
+      for (; points - i >= chunk_points_; i += chunk_points_) {
+        std::span<const double> chunk =
+            interleaved.subspan(i * 2, chunk_points_ * 2);
+        std::string header = chunk_header(chunk.size_bytes());
+        write_parts({std::as_bytes(std::span(header)), std::as_bytes(chunk)});
+        detail::count_points(chunk_points_);
+      }
+    }
+    for (; i < points; ++i) {
+      push(interleaved[i * 2], interleaved[i * 2 + 1]);
+    }
+  }
+
+  // Appends points given as separate x and y arrays of equal length. With
+  // arrays f64 storage, whole chunks are sent straight from the caller's
+  // buffers.
+  void write(std::span<const double> x, std::span<const double> y) {
+    size_t points = std::min(x.size(), y.size());
+    size_t i = 0;
+    if (arrays_ && encoding_.plain()) {
+      for (; count_ != 0 && i < points; ++i) {
+        push(x[i], y[i]);
+      }
+      for (; points - i >= chunk_points_; i += chunk_points_) {
+        std::string header = chunk_header(chunk_points_ * 2 * sizeof(double));
+        write_parts({std::as_bytes(std::span(header)),
+                     std::as_bytes(x.subspan(i, chunk_points_)),
+                     std::as_bytes(y.subspan(i, chunk_points_))});
+        detail::count_points(chunk_points_);
+      }
+    }
+    for (; i < points; ++i) {
+      push(x[i], y[i]);
+    }
+  }
+
+  // Appends points laid out as L, sending whole chunks straight from them
+  // when they already match the stream's layout.
+  template <Layout L> void write(const Samples<L, const double> &points) {
+    if constexpr (L == Layout::Interleaved) {
+      write(points.interleaved());
+    } else {
+      write(points.x_column(), points.y_column());
+    }
+  }
+
+  // Ends the stream with {"error":...} in place of the terminator, dropping
+  // any partially filled chunk and chunks still being compressed, for
+  // example when the request is cancelled.
+  void abort(std::string_view error) {
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    compressor_.reset();
+    std::string frame =
+        std::format("{{\"error\":{}{}}}\n", json_quoted(error), tag_);
+    write_parts({std::as_bytes(std::span(frame))});
+  }
+
+  // Sends any partially filled chunk followed by the terminator.
+  void finish() {
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    flush_chunk();
+    if (compressor_) {
+      compressor_->finish([this](CompressedPayload chunk) { send(chunk); });
+    }
+    std::string terminator = std::format("{{\"type\":\"end\"{}}}\n", tag_);
+    write_parts({std::as_bytes(std::span(terminator))});
+  }
+
+private:
+  std::string chunk_header(size_t bytes, std::string_view fields = {}) const {
+    return std::format("{{\"type\":\"chunk\",\"length\":{}{}{}}}\n", bytes,
+                       fields, tag_);
+  }
+
+  void send(const CompressedPayload &chunk) {
+    std::string header =
+        chunk_header(chunk.bytes.size(), chunk.header_fields());
+    write_parts({std::as_bytes(std::span(header)), chunk.bytes});
+  }
+
+  static void
+  write_parts(std::initializer_list<std::span<const std::byte>> parts) {
+    detail::write_stdout_gather(std::span(parts.begin(), parts.size()));
+  }
+
+  void flush_chunk() {
+    if (count_ == 0) {
+      return;
+    }
+    detail::count_points(count_);
+    std::span<const double> data(buffer_);
+    if (!encoding_.plain()) {
+      encoded_.clear();
+      if (arrays_) {
+        encoding_.encode(data.data(), data.data() + chunk_points_, 1, count_,
+                         true, encoded_);
+      } else {
+        encoding_.encode(data.data(), data.data() + 1, 2, count_, false,
+                         encoded_);
+      }
+      count_ = 0;
+      if (compressor_) {
+        compressor_->submit(encoded_, encoding_.value_bytes(),
+                            [this](CompressedPayload chunk) { send(chunk); });
+        return;
+      }
+      std::string header = chunk_header(encoded_.size());
+      write_parts({std::as_bytes(std::span(header)), encoded_});
+      return;
+    }
+
+    std::string header = chunk_header(count_ * 2 * sizeof(double));
+    if (arrays_) {
+      // Each chunk carries its own x block followed by its own y block.
+      write_parts({std::as_bytes(std::span(header)),
+                   std::as_bytes(data.first(count_)),
+                   std::as_bytes(data.subspan(chunk_points_, count_))});
+    } else {
+      write_parts({std::as_bytes(std::span(header)),
+                   std::as_bytes(data.first(count_ * 2))});
+    }
+    count_ = 0;
+  }
+
+  bool arrays_;
+  bool finished_ = false;
+  size_t chunk_points_;
+  size_t count_ = 0;
+  Encoding encoding_;
+  std::string tag_; // The request id every frame is tagged with
+  ArenaVector<double> buffer_;
+  ArenaVector<std::byte> encoded_;
+  std::optional<ChunkCompressor> compressor_;
+};
+
 } // namespace sdk
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "arena.hpp"
+#include "decimate.hpp"
+#include "layout.hpp"
+#include "summary.hpp"
+
+namespace sdk {
+
+// SeriesPyramid keeps a series together with min/max summaries of its points
+// at power-of-two bucket sizes. Any view of the series is answered from the
+// coarsest buckets that each fall within one pixel column, so zooming and
+// panning cost O(visible buckets) instead of a rescan of the whole series.
+// It also keeps the series' SeriesSummary, folding in each run of points as
+// it is added.
+//
+// Points must arrive in non-decreasing x order.
+class SeriesPyramid {
+public:
+  // The finest level summarises buckets of 2^kMinLevel points; shorter runs
+  // are read from the points themselves.
+  static constexpr size_t kMinLevel = 3;
+
+  void reserve(size_t points) {
+    xs_.reserve(points);
+    ys_.reserve(points);
+  }
+
+  void push(double x, double y) {
+    xs_.push_back(x);
+    ys_.push_back(y);
+  }
+
+  // Adds interleaved [x, y] pairs.
+  void push(std::span<const double> interleaved) {
+    for (size_t i = 0; i + 1 < interleaved.size(); i += 2) {
+      push(interleaved[i], interleaved[i + 1]);
+    }
+    summarize_pending();
+  }
+
+  // Adds points in either layout.
+  template <Layout L> void push(const Samples<L, const double> &points) {
+    for (size_t i = 0; i < points.size(); ++i) {
+      push(points.x(i), points.y(i));
+    }
+    summarize_pending();
+  }
+
+  // Appends `points` points for the caller to fill, as views of the x and y
+  // columns, so a generator can write a series straight into place. They
+  // are summarised on the next extend() or finish().
+  Samples<Layout::Arrays> extend(size_t points) {
+    summarize_pending();
+    size_t size = xs_.size();
+    xs_.resize_for_overwrite(size + points);
+    ys_.resize_for_overwrite(size + points);
+    return {xs_.data() + size, ys_.data() + size, points};
+  }
+
+  // Builds the summary levels. Call once after the final point.
+  void finish() {
+    summarize_pending();
+    levels_.clear();
+    size_t buckets = xs_.size() >> kMinLevel;
+    if (buckets == 0) {
+      return;
+    }
+
+    std::vector<Bucket> &base = levels_.emplace_back(buckets);
+    for (size_t b = 0; b < buckets; ++b) {
+      size_t begin = b << kMinLevel;
+      Bucket bucket{begin, begin};
+      for (size_t i = begin + 1; i < begin + (size_t{1} << kMinLevel); ++i) {
+        bucket = merge(bucket, {i, i});
+      }
+      base[b] = bucket;
+    }
+
+    while (levels_.back().size() >= 2) {
+      const std::vector<Bucket> &finer = levels_.back();
+      std::vector<Bucket> coarser(finer.size() / 2);
+      for (size_t b = 0; b < coarser.size(); ++b) {
+        coarser[b] = merge(finer[b * 2], finer[b * 2 + 1]);
+      }
+      levels_.push_back(std::move(coarser));
+    }
+  }
+
+  size_t size() const { return xs_.size(); }
+  size_t levels() const { return levels_.size(); }
+  bool empty() const { return xs_.empty(); }
+
+  std::span<const double> x() const { return xs_; }
+  std::span<const double> y() const { return ys_; }
+  const SeriesSummary &summary() const { return summary_; }
+
+  // Approximate footprint of a finished pyramid over `points` points, for
+  // deciding whether a series is worth building one for.
+  static size_t bytes_for(size_t points) {
+    size_t bytes = points * 2 * sizeof(double);
+    for (size_t buckets = points >> kMinLevel; buckets > 0; buckets /= 2) {
+      bytes += buckets * sizeof(Bucket);
+    }
+    return bytes;
+  }
+
+  size_t memory_bytes() const {
+    size_t bytes = (xs_.capacity() + ys_.capacity()) * sizeof(double);
+    for (const std::vector<Bucket> &level : levels_) {
+      bytes += level.capacity() * sizeof(Bucket);
+    }
+    return bytes;
+  }
+
+  // Reduces the points in [x_min, x_max], plus the nearest point outside the
+  // range on each side, to at most four per pixel column.
+  M4Decimator query(double x_min, double x_max, size_t pixel_width) const {
+    M4Decimator out(pixel_width, x_min, x_max);
+    if (xs_.empty()) {
+      out.finish();
+      return out;
+    }
+
+    size_t first = static_cast<size_t>(
+        std::lower_bound(xs_.begin(), xs_.end(), x_min) - xs_.begin());
+    size_t last = static_cast<size_t>(
+        std::upper_bound(xs_.begin(), xs_.end(), x_max) - xs_.begin());
+    first = first > 0 ? first - 1 : 0;
+    last = std::min(last, xs_.size() - 1);
+
+    // Use levels whose buckets hold no more points than a column
+    size_t per_column = (last - first + 1) / std::max<size_t>(pixel_width, 1);
+    size_t usable = 0;
+    while (usable < levels_.size() && bucket_points(usable) <= per_column) {
+      ++usable;
+    }
+
+    // A bucket stands in for its points only if they all land in one pixel
+    // column inside the view; one straddling a column boundary would hand
+    // its extremes to the wrong column, so its span is read from finer
+    // levels instead
+    auto one_column = [&](size_t level, size_t i) {
+      double lo = xs_[i];
+      double hi = xs_[i + bucket_points(level) - 1];
+      return lo >= x_min && hi <= x_max &&
+             out.column_of(lo) == out.column_of(hi);
+    };
+
+    size_t i = first;
+    while (i <= last) {
+      // Largest aligned bucket that starts at i, ends inside the range and
+      // covers a single column
+      size_t level = usable;
+      while (level > 0 &&
+             !(fits(level - 1, i, last) && one_column(level - 1, i))) {
+        --level;
+      }
+      if (level == 0) {
+        out.push(xs_[i], ys_[i]);
+        ++i;
+        continue;
+      }
+
+      size_t shift = kMinLevel + level - 1;
+      const Bucket &bucket = levels_[level - 1][i >> shift];
+      size_t end = i + bucket_points(level - 1);
+      size_t picks[4] = {i, bucket.min, bucket.max, end - 1};
+      std::sort(std::begin(picks), std::end(picks));
+      for (size_t k = 0; k < 4; ++k) {
+        if (k == 0 || picks[k] != picks[k - 1]) {
+          out.push(xs_[picks[k]], ys_[picks[k]]);
+        }
+      }
+      i = end;
+    }
+
+    out.finish();
+    return out;
+  }
+
+  // Reduces the whole series to at most four points per pixel column.
+  M4Decimator query(size_t pixel_width) const {
+    if (xs_.empty()) {
+      return query(0, 0, pixel_width);
+    }
+    return query(xs_.front(), xs_.back(), pixel_width);
+  }
+
+private:
+  // Indices of the lowest and highest point in a bucket
+  struct Bucket {
+    size_t min;
+    size_t max;
+  };
+
+  Bucket merge(const Bucket &a, const Bucket &b) const {
+    return {ys_[b.min] < ys_[a.min] ? b.min : a.min,
+            ys_[b.max] > ys_[a.max] ? b.max : a.max};
+  }
+
+  // Folds the points added since the last call into the summary
+  void summarize_pending() {
+    size_t size = xs_.size();
+    summary_.add(Samples<Layout::Arrays, const double>{
+        xs_.data() + summarized_, ys_.data() + summarized_,
+        size - summarized_});
+    summarized_ = size;
+  }
+
+  static size_t bucket_points(size_t level) {
+    return size_t{1} << (kMinLevel + level);
+  }
+
+  static bool fits(size_t level, size_t i, size_t last) {
+    size_t points = bucket_points(level);
+    return i % points == 0 && i + points - 1 <= last;
+  }
+
+  // Points live in arena memory, so a pyramid rebuilt after an eviction
+  // reuses the pages of the one it replaces
+  ArenaVector<double> xs_;
+  ArenaVector<double> ys_;
+  std::vector<std::vector<Bucket>> levels_;
+  SeriesSummary summary_;
+  size_t summarized_ = 0; // Points folded into summary_
+};
+
+} // namespace sdk
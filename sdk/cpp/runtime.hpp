@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "json.hpp"
+#include "metrics.hpp"
+#include "protocol.hpp"
+#include "shared_memory.hpp"
+
+namespace sdk {
+
+// Where a request handler runs.
+enum class Run {
+  Inline,    // On the reader thread, alongside running jobs
+  Exclusive, // On the reader thread once every job has finished
+  Worker,    // On the worker pool, leaving the reader free for other messages
+};
+
+// PluginRuntime owns a plugin's request loop. A reader thread parses each
+// request once, answers cheap methods straight away and queues heavy ones for
+// a pool of workers, so info and cancel are serviced while a long generation
+// runs. {"method":"cancel","id":...} triggers the stop token of the request
+// with that id, or of every request if it has no id, and the runtime itself
+// answers requests cancelled before they started. Handlers poll their stop
+// token and answer with send_cancelled() or ChunkedWriter::abort() once it
+// fires. Queued log lines are flushed once each message is handled, and a
+// "log_level" member on any request sets the level below which logs are
+// dropped. get_metrics is answered with the time each method has taken
+// and what it sent, see metrics.hpp.
+//
+// {"method":"reset"} returns the plugin to its state at startup, so a host
+// can keep a pool of warm plugin processes and reuse them across documents:
+// every job is cancelled and waited for, the on_reset() hook drops the
+// plugin's own state, and idle arena memory goes back to the system.
+//
+// A request's "id", if it has one, tags every line and frame header of its
+// reply. Jobs with ids may then run at once on several workers, their
+// replies interleaved frame by frame in whatever order they finish; a job
+// without one runs on its own, so hosts that do not tag their requests still
+// get replies in order. Shared memory sent to a request that also has
+// "multiplex":true is kept until {"method":"release","id":...}, since the
+// host may not have mapped it by the time the next request arrives.
+//
+// Methods come from a MethodTable whose ids run from 0 to N - 1, such as an
+// enum listed in table order. Handlers on more than one worker must guard
+// any state they share; with the default single worker, jobs run one at a
+// time in arrival order.
+template <typename Id, size_t N> class PluginRuntime {
+public:
+  using Handler =
+      std::function<void(const JsonObject &request, std::stop_token stop)>;
+
+  explicit PluginRuntime(const MethodTable<Id, N> &methods,
+                         unsigned workers = 1)
+      : methods_(methods), workers_(std::max(workers, 1u)) {}
+
+  ~PluginRuntime() { stop_workers(); }
+
+  PluginRuntime(const PluginRuntime &) = delete;
+  PluginRuntime &operator=(const PluginRuntime &) = delete;
+
+  void on(Id method, Run run, Handler handler) {
+    auto index = static_cast<size_t>(method);
+    if (index < N) {
+      handlers_[index] = {run, std::move(handler)};
+    }
+  }
+
+  // Runs on reset once no job is left, so the plugin can restore its
+  // configuration and drop caches and feeds.
+  void on_reset(std::function<void()> reset) { reset_ = std::move(reset); }
+
+  // Serves requests until the input closes, then cancels any jobs left and
+  // waits for them to finish.
+  int run(std::istream &in = std::cin) {
+    start_workers();
+    std::string line;
+    while (std::getline(in, line)) {
+      if (!line.empty()) {
+        dispatch(std::move(line));
+        flush_output();
+      }
+    }
+    cancel({});
+    stop_workers();
+    return 0;
+  }
+
+private:
+  struct Entry {
+    Run run = Run::Inline;
+    Handler handler;
+  };
+
+  struct Job {
+    std::string line;
+    std::string id;
+    bool multiplexed = false;
+    size_t handler = 0;
+    std::stop_source stop;
+  };
+
+  void dispatch(std::string line) {
+    JsonObject request = JsonObject::parse(line);
+    if (JsonValue level = request["log_level"]; level.is_string()) {
+      set_log_level(parse_log_level(level.str()));
+    }
+    std::string_view name = request["method"].str();
+    if (name == "cancel") {
+      cancel(id_json(request["id"]));
+      return;
+    }
+    if (name == "release") {
+      release_shared_memory(id_json(request["id"]));
+      return;
+    }
+    if (name == "get_metrics") {
+      send_response("{{\"result\":{}}}", metrics().json());
+      return;
+    }
+    if (name == "reset") {
+      reset();
+      return;
+    }
+    std::optional<Id> method = methods_.find(name);
+    if (!method) {
+      return;
+    }
+    auto index = static_cast<size_t>(*method);
+    const Entry &entry = handlers_[index];
+    if (!entry.handler) {
+      return;
+    }
+
+    bool multiplexed = request["multiplex"].boolean().value_or(false);
+    std::unique_lock lock(mutex_);
+    if (queue_.empty() && running_.empty()) {
+      // The host has read every earlier response, shared memory included
+      release_shared_memory();
+    }
+
+    switch (entry.run) {
+    case Run::Inline: {
+      lock.unlock();
+      detail::RequestScope scope(id_json(request["id"]), multiplexed);
+      RequestTimer timer(name);
+      entry.handler(request, {});
+      break;
+    }
+    case Run::Exclusive: {
+      idle_.wait(lock, [&] { return queue_.empty() && running_.empty(); });
+      lock.unlock();
+      detail::RequestScope scope(id_json(request["id"]), multiplexed);
+      RequestTimer timer(name);
+      entry.handler(request, {});
+      break;
+    }
+    case Run::Worker: {
+      auto job = std::make_shared<Job>();
+      job->id = id_json(request["id"]);
+      job->multiplexed = multiplexed;
+      job->handler = index;
+      job->line = std::move(line);
+      queue_.push_back(std::move(job));
+      lock.unlock();
+      ready_.notify_one();
+      break;
+    }
+    }
+  }
+
+  // A request's id as JSON text, quoted if it is a string, or empty if it
+  // has none.
+  static std::string id_json(JsonValue id) {
+    if (id.is_string()) {
+      return std::format("\"{}\"", id.raw());
+    }
+    return id.is_number() ? std::string(id.raw()) : std::string();
+  }
+
+  // Stops the jobs with this id, or every job for an empty id.
+  void cancel(std::string_view id) {
+    std::lock_guard lock(mutex_);
+    for (auto *jobs : {&queue_, &running_}) {
+      for (const std::shared_ptr<Job> &job : *jobs) {
+        if (id.empty() || job->id == id) {
+          job->stop.request_stop();
+        }
+      }
+    }
+  }
+
+  void reset() {
+    cancel({});
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [&] { return queue_.empty() && running_.empty(); });
+    release_all_shared_memory();
+    lock.unlock();
+
+    RequestTimer timer("reset");
+    if (reset_) {
+      reset_();
+    }
+    output_arena().trim();
+    send_response(R"({"result":"reset"})");
+  }
+
+  void work() {
+    for (;;) {
+      std::unique_lock lock(mutex_);
+      ready_.wait(lock,
+                  [&] { return startable() || (closing_ && queue_.empty()); });
+      if (!startable()) {
+        return;
+      }
+      std::shared_ptr<Job> job = std::move(queue_.front());
+      queue_.pop_front();
+      running_.push_back(job);
+      lock.unlock();
+
+      detail::RequestScope scope(job->id, job->multiplexed);
+      if (job->stop.stop_requested()) {
+        send_cancelled();
+      } else {
+        JsonObject request = JsonObject::parse(job->line);
+        RequestTimer timer(request["method"].str());
+        handlers_[job->handler].handler(request, job->stop.get_token());
+      }
+      flush_output();
+
+      lock.lock();
+      std::erase(running_, job);
+      if (queue_.empty() && running_.empty()) {
+        idle_.notify_all();
+      }
+      // A job held back behind this one may start now
+      ready_.notify_all();
+    }
+  }
+
+  // True if the next queued job may start: one that has an id runs beside
+  // others that have one, and a job without runs alone. Call with mutex_
+  // held.
+  bool startable() const {
+    if (queue_.empty()) {
+      return false;
+    }
+    if (running_.empty()) {
+      return true;
+    }
+    // A job without an id only ever runs alone, so it is the front one
+    return !queue_.front()->id.empty() && !running_.front()->id.empty();
+  }
+
+  void start_workers() {
+    closing_ = false;
+    for (unsigned i = 0; i < workers_; ++i) {
+      pool_.emplace_back([this] { work(); });
+    }
+  }
+
+  void stop_workers() {
+    {
+      std::lock_guard lock(mutex_);
+      closing_ = true;
+    }
+    ready_.notify_all();
+    pool_.clear();
+  }
+
+  MethodTable<Id, N> methods_;
+  std::array<Entry, N> handlers_{};
+  std::function<void()> reset_;
+  unsigned workers_;
+
+  std::mutex mutex_;
+  std::condition_variable ready_; // A job was queued or the runtime closes
+  std::condition_variable idle_;  // No job is queued or running
+  std::deque<std::shared_ptr<Job>> queue_;
+  std::deque<std::shared_ptr<Job>> running_;
+  bool closing_ = false;
+  std::vector<std::jthread> pool_;
+};
+
+} // namespace sdk
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <format>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "platform.hpp"
+#include "protocol.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sdk {
+
+// SharedRegion is a named block of shared memory that the host maps by name,
+// so a series can be handed over without streaming it through the pipe. It is
+// a pagefile-backed file mapping on Windows and a shm_open object elsewhere.
+// Check valid() after construction; callers fall back to the pipe if the
+// system cannot provide the memory.
+class SharedRegion {
+public:
+  explicit SharedRegion(size_t bytes) : size_(bytes) {
+    static std::atomic<unsigned> counter{0};
+    unsigned id = ++counter;
+#ifdef _WIN32
+    name_ = std::format("Local\\olicanaplot-{}-{}", detail::process_id(),
+                        id);
+    auto size = static_cast<unsigned long long>(std::max<size_t>(bytes, 1));
+    handle_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                 static_cast<DWORD>(size >> 32),
+                                 static_cast<DWORD>(size), name_.c_str());
+    if (handle_ == nullptr) {
+      return;
+    }
+    if (bytes > 0) {
+      data_ = MapViewOfFile(handle_, FILE_MAP_WRITE, 0, 0, bytes);
+      if (data_ == nullptr) {
+        CloseHandle(handle_);
+        handle_ = nullptr;
+      }
+    }
+#else
+    name_ = std::format("/olicanaplot-{}-{}", detail::process_id(), id);
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      return;
+    }
+    linked_ = true;
+    // tmpfs hands out pages on first touch, so an unreserved region larger
+    // than the free space in /dev/shm would fault with SIGBUS mid-write
+#ifdef __linux__
+    bool sized = bytes == 0 ||
+                 posix_fallocate(fd, 0, static_cast<off_t>(bytes)) == 0;
+#else
+    bool sized = ftruncate(fd, static_cast<off_t>(bytes)) == 0;
+#endif
+    if (!sized) {
+      close(fd);
+      release();
+      return;
+    }
+    if (bytes > 0) {
+      void *data =
+          mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      data_ = data == MAP_FAILED ? nullptr : data;
+    }
+    close(fd);
+    if (bytes > 0 && data_ == nullptr) {
+      release();
+    }
+#endif
+  }
+
+  SharedRegion(const SharedRegion &) = delete;
+  SharedRegion &operator=(const SharedRegion &) = delete;
+
+  SharedRegion(SharedRegion &&other) noexcept { swap(other); }
+  SharedRegion &operator=(SharedRegion &&other) noexcept {
+    if (this != &other) {
+      release();
+      swap(other);
+    }
+    return *this;
+  }
+
+  ~SharedRegion() { release(); }
+
+  bool valid() const {
+#ifdef _WIN32
+    return handle_ != nullptr;
+#else
+    return linked_;
+#endif
+  }
+
+  const std::string &name() const { return name_; }
+  size_t size() const { return size_; }
+
+  std::span<std::byte> bytes() {
+    return {static_cast<std::byte *>(data_), data_ ? size_ : 0};
+  }
+  std::span<double> doubles() {
+    return {static_cast<double *>(data_), data_ ? size_ / sizeof(double) : 0};
+  }
+
+  // Drops this process's view of the memory. The named object stays alive
+  // for the host until the region is destroyed.
+  void unmap() {
+    if (data_ == nullptr) {
+      return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(data_, size_);
+#endif
+    data_ = nullptr;
+  }
+
+private:
+  void release() {
+    unmap();
+#ifdef _WIN32
+    if (handle_ != nullptr) {
+      CloseHandle(handle_);
+      handle_ = nullptr;
+    }
+#else
+    if (linked_) {
+      // The host unlinks the name once it has mapped the region, so this
+      // only cleans up regions it never picked up
+      shm_unlink(name_.c_str());
+      linked_ = false;
+    }
+#endif
+  }
+
+  void swap(SharedRegion &other) noexcept {
+    std::swap(name_, other.name_);
+    std::swap(size_, other.size_);
+    std::swap(data_, other.data_);
+#ifdef _WIN32
+    std::swap(handle_, other.handle_);
+#else
+    std::swap(linked_, other.linked_);
+#endif
+  }
+
+  std::string name_;
+  size_t size_ = 0;
+  void *data_ = nullptr;
+#ifdef _WIN32
+  HANDLE handle_ = nullptr;
+#else
+  bool linked_ = false;
+#endif
+};
+
+namespace detail {
+
+// A region sent to the host that must outlive the response it belongs to,
+// with the id of the multiplexed request it answered, if it did
+struct SentRegion {
+  SharedRegion region;
+  std::string request;
+};
+
+struct SentRegions {
+  std::mutex mutex;
+  std::vector<SentRegion> regions;
+};
+
+inline SentRegions &sent_regions() {
+  static SentRegions sent;
+  return sent;
+}
+
+} // namespace detail
+
+// Frees the regions sent with earlier responses. Call when a new request
+// arrives with nothing else running: by then a host that waits for each
+// reply has mapped everything it was sent before. Regions sent to
+// multiplexed requests are kept until the host releases them.
+inline void release_shared_memory() {
+  detail::SentRegions &sent = detail::sent_regions();
+  std::lock_guard lock(sent.mutex);
+  std::erase_if(sent.regions, [](const detail::SentRegion &entry) {
+    return entry.request.empty();
+  });
+}
+
+// Frees the regions sent to a multiplexed request, once the host has mapped
+// them, given its raw "id".
+inline void release_shared_memory(std::string_view request) {
+  detail::SentRegions &sent = detail::sent_regions();
+  std::lock_guard lock(sent.mutex);
+  std::erase_if(sent.regions, [&](const detail::SentRegion &entry) {
+    return !entry.request.empty() && entry.request == request;
+  });
+}
+
+// Frees every region sent, multiplexed or not.
+inline void release_all_shared_memory() {
+  detail::SentRegions &sent = detail::sent_regions();
+  std::lock_guard lock(sent.mutex);
+  sent.regions.clear();
+}
+
+// Sends a filled region as a "shm" response with only its handle name and
+// size in the header. The region is kept alive until release_shared_memory().
+inline void send_shared_data(SharedRegion region, std::string_view storage,
+                             std::string_view series_id = {}) {
+  send_response(
+      "{{\"type\":\"shm\",\"handle\":\"{}\",\"offset\":0,\"length\":{},"
+      "\"storage\":\"{}\"{}}}",
+      region.name(), region.size(), storage, detail::series_tag(series_id));
+  region.unmap();
+  detail::count_points(region.size() / (2 * sizeof(double)));
+
+  const detail::CurrentRequest &current = detail::current_request();
+  detail::SentRegions &sent = detail::sent_regions();
+  std::lock_guard lock(sent.mutex);
+  sent.regions.push_back(
+      {std::move(region), current.multiplexed ? current.id : std::string()});
+}
+
+// Copies interleaved points into a new region and sends it. Returns false,
+// having sent nothing, if no shared memory was available.
+inline bool send_shared_data(std::span<const double> result,
+                             std::string_view storage = "interleaved",
+                             std::string_view series_id = {}) {
+  SharedRegion region(result.size_bytes());
+  if (!region.valid()) {
+    return false;
+  }
+  std::ranges::copy(result, region.doubles().begin());
+  send_shared_data(std::move(region), storage, series_id);
+  return true;
+}
+
+// Copies separate x and y buffers into a new region laid out as `storage`
+// ("arrays" or "interleaved") and sends it. Returns false, having sent
+// nothing, if no shared memory was available.
+inline bool send_shared_data(std::span<const double> x,
+                             std::span<const double> y,
+                             std::string_view storage = "arrays",
+                             std::string_view series_id = {}) {
+  if (x.size() != y.size()) {
+    return false;
+  }
+  SharedRegion region(x.size_bytes() + y.size_bytes());
+  if (!region.valid()) {
+    return false;
+  }
+
+  std::span<double> out = region.doubles();
+  bool arrays = storage == "arrays";
+  if (arrays) {
+    std::ranges::copy(x, out.begin());
+    std::ranges::copy(y, out.begin() + static_cast<std::ptrdiff_t>(x.size()));
+  } else {
+    for (size_t i = 0; i < x.size(); ++i) {
+      out[i * 2] = x[i];
+      out[i * 2 + 1] = y[i];
+    }
+  }
+  send_shared_data(std::move(region), arrays ? "arrays" : "interleaved",
+                   series_id);
+  return true;
+}
+
+} // namespace sdk
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <limits>
+#include <span>
+#include <string>
+
+#include "layout.hpp"
+
+namespace sdk {
+
+// SeriesSummary keeps the extents and moments of a series in one pass over
+// its points: the count, the x and y ranges, and the mean and population
+// variance of y. Points are folded in as they are generated or streamed, and
+// summaries of separate runs merge into the summary of the runs combined, so
+// a host can size its axes before any of the data itself is sent.
+class SeriesSummary {
+public:
+  void add(double x, double y) {
+    SeriesSummary point;
+    point.count_ = 1;
+    point.x_min_ = point.x_max_ = x;
+    point.y_min_ = point.y_max_ = y;
+    point.mean_ = y;
+    merge(point);
+  }
+
+  // Adds interleaved [x, y] pairs.
+  void add(std::span<const double> interleaved) {
+    add(Samples<Layout::Interleaved, const double>::of(
+        interleaved.data(), interleaved.size() / 2));
+  }
+
+  // Adds points in either layout, kBlockPoints at a time.
+  template <Layout L> void add(const Samples<L, const double> &points) {
+    for (size_t first = 0; first < points.size(); first += kBlockPoints) {
+      size_t n = std::min(kBlockPoints, points.size() - first);
+      merge(summarize(points.subspan(first, n)));
+    }
+  }
+
+  // Folds in the summary of other points, as if they had been added here.
+  // Moments combine as in Chan et al.'s parallel variance.
+  void merge(const SeriesSummary &other) {
+    if (other.count_ == 0) {
+      return;
+    }
+    if (count_ == 0) {
+      *this = other;
+      return;
+    }
+    size_t count = count_ + other.count_;
+    double delta = other.mean_ - mean_;
+    double weight = static_cast<double>(other.count_) / count;
+    mean_ += delta * weight;
+    m2_ += other.m2_ + delta * delta * static_cast<double>(count_) * weight;
+    count_ = count;
+    x_min_ = std::min(x_min_, other.x_min_);
+    x_max_ = std::max(x_max_, other.x_max_);
+    y_min_ = std::min(y_min_, other.y_min_);
+    y_max_ = std::max(y_max_, other.y_max_);
+  }
+
+  size_t count() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  double x_min() const { return x_min_; }
+  double x_max() const { return x_max_; }
+  double y_min() const { return y_min_; }
+  double y_max() const { return y_max_; }
+  double mean() const { return mean_; }
+  double variance() const { return count_ > 0 ? m2_ / count_ : 0; }
+
+  // The summary as a JSON object. An empty series has only a count.
+  std::string json() const {
+    if (count_ == 0) {
+      return "{\"count\":0}";
+    }
+    return std::format(
+        "{{\"count\":{},\"x_min\":{},\"x_max\":{},\"y_min\":{},\"y_max\":{},"
+        "\"mean\":{},\"variance\":{}}}",
+        count_, x_min_, x_max_, y_min_, y_max_, mean_, variance());
+  }
+
+private:
+  // Points summarised in one pass before merging, few enough that their
+  // shifted sums of squares keep full precision
+  static constexpr size_t kBlockPoints = 4096;
+  // Independent accumulators per pass, so the compiler keeps them in vector
+  // registers instead of one serial dependency chain
+  static constexpr size_t kLanes = 8;
+
+  template <Layout L>
+  static SeriesSummary summarize(const Samples<L, const double> &points) {
+    constexpr double kInf = std::numeric_limits<double>::infinity();
+    size_t n = points.size();
+    // Sums are taken about the first value so that they stay small
+    double shift = points.y(0);
+
+    double x_lo[kLanes], x_hi[kLanes], y_lo[kLanes], y_hi[kLanes];
+    double sum[kLanes], squares[kLanes];
+    for (size_t k = 0; k < kLanes; ++k) {
+      x_lo[k] = y_lo[k] = kInf;
+      x_hi[k] = y_hi[k] = -kInf;
+      sum[k] = squares[k] = 0;
+    }
+
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+      for (size_t k = 0; k < kLanes; ++k) {
+        double x = points.x(i + k);
+        double y = points.y(i + k);
+        x_lo[k] = x < x_lo[k] ? x : x_lo[k];
+        x_hi[k] = x > x_hi[k] ? x : x_hi[k];
+        y_lo[k] = y < y_lo[k] ? y : y_lo[k];
+        y_hi[k] = y > y_hi[k] ? y : y_hi[k];
+        double d = y - shift;
+        sum[k] += d;
+        squares[k] += d * d;
+      }
+    }
+    for (size_t k = 0; i < n; ++i, ++k) {
+      double x = points.x(i);
+      double y = points.y(i);
+      x_lo[k] = std::min(x_lo[k], x);
+      x_hi[k] = std::max(x_hi[k], x);
+      y_lo[k] = std::min(y_lo[k], y);
+      y_hi[k] = std::max(y_hi[k], y);
+      double d = y - shift;
+      sum[k] += d;
+      squares[k] += d * d;
+    }
+
+    SeriesSummary out;
+    out.count_ = n;
+    double total = 0;
+    double total_squares = 0;
+    for (size_t k = 0; k < kLanes; ++k) {
+      out.x_min_ = std::min(out.x_min_, x_lo[k]);
+      out.x_max_ = std::max(out.x_max_, x_hi[k]);
+      out.y_min_ = std::min(out.y_min_, y_lo[k]);
+      out.y_max_ = std::max(out.y_max_, y_hi[k]);
+      total += sum[k];
+      total_squares += squares[k];
+    }
+    out.mean_ = shift + total / n;
+    out.m2_ = std::max(0.0, total_squares - total * total / n);
+    return out;
+  }
+
+  size_t count_ = 0;
+  double x_min_ = std::numeric_limits<double>::infinity();
+  double x_max_ = -std::numeric_limits<double>::infinity();
+  double y_min_ = std::numeric_limits<double>::infinity();
+  double y_max_ = -std::numeric_limits<double>::infinity();
+  double mean_ = 0;
+  double m2_ = 0; // Sum of squared deviations of y from the mean
+};
+
+} // namespace sdk